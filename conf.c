@@ -45,6 +45,8 @@
 #include "lineread.h"
 #include "isolation.h"
 #include "log.h"
+#include "pcap.h"
+#include "sockmap.h"
 
 #define NETNS_RUN_DIR	"/run/netns"
 
@@ -777,6 +779,20 @@ static void usage(const char *name, FILE *f, int status)
 	FPRINTF(f,
 		"  -F, --fd FD		Use FD as pre-opened connected socket\n"
 		"  -p, --pcap FILE	Log tap-facing traffic to pcap file\n"
+		"  --pcap-snaplen BYTES	Capture up to BYTES of each frame\n"
+		"  --pcap-filter EXPR	Capture only frames matching EXPR\n"
+		"    for example: 'syn fin rst or udp port 53'\n"
+		"  --pcapng		Use pcapng format, with flows and drops\n"
+		"  --pcap-size BYTES	Rotate capture files at BYTES\n"
+		"  --pcap-interval SEC	Rotate capture files every SEC seconds\n"
+		"  --pcap-files N	Rotate across N files: FILE.0 to FILE.N-1\n"
+		"    default: %u, maximum: %u\n",
+		PCAP_FILES_DEFAULT, PCAP_FILES_MAX);
+	FPRINTF(f,
+		"  --stats-socket PATH	Expose runtime counters on socket\n"
+		"  --stats-file FILE	Write runtime counters on SIGUSR2\n"
+		"  --trace-ring FILE	Record debug messages in binary form,\n"
+		"    write them to FILE on SIGUSR1\n"
 		"  -P, --pid FILE	Write own PID to the given file\n"
 		"  -m, --mtu MTU	Assign MTU via DHCP/NDP\n"
 		"    a zero value disables assignment\n"
@@ -848,6 +864,13 @@ static void usage(const char *name, FILE *f, int status)
 		"  --no-ra		Disable router advertisements\n"
 		"  --freebind		Bind to any address for forwarding\n"
 		"  --no-map-gw		Don't map gateway address to host\n"
+		"  --rate-flow RATE	Limit each flow to RATE bytes/s\n"
+		"  --rate-pif RATE	Limit traffic to each interface, bytes/s\n"
+		"  --tcp-frames COUNT	Queue up to COUNT TCP frames to tap\n"
+		"    default: 128, maximum: 256\n"
+		"  --zerocopy		Send large payloads to sockets without copy\n"
+		"  --busy-poll [USEC]	Poll for USEC us after events, no sleep\n"
+		"    default: 50, maximum: 1000000\n"
 		"  -4, --ipv4-only	Enable IPv4 operation only\n"
 		"  -6, --ipv6-only	Enable IPv6 operation only\n");
 
@@ -929,6 +952,7 @@ pasta_opts:
 		"  --no-netns-quit	Don't quit if filesystem-bound target\n"
 		"  			network namespace is deleted\n"
 		"  --config-net		Configure tap interface in namespace\n"
+		"  --splice-offload	Forward spliced TCP data in kernel\n"
 		"  --no-copy-routes	DEPRECATED:\n"
 		"			Don't copy all routes to namespace\n"
 		"  --no-copy-addrs	DEPRECATED:\n"
@@ -1274,6 +1298,8 @@ void conf(struct ctx *c, int argc, char **argv)
 		{"no-ndp",	no_argument,		&c->no_ndp,	1 },
 		{"no-ra",	no_argument,		&c->no_ra,	1 },
 		{"freebind",	no_argument,		&c->freebind,	1 },
+		{"zerocopy",	no_argument,		&c->zerocopy,	1 },
+		{"pcapng",	no_argument,		&c->pcapng,	1 },
 		{"no-map-gw",	no_argument,		&no_map_gw,	1 },
 		{"ipv4-only",	no_argument,		NULL,		'4' },
 		{"ipv6-only",	no_argument,		NULL,		'6' },
@@ -1305,6 +1331,19 @@ void conf(struct ctx *c, int argc, char **argv)
 		{"map-guest-addr", required_argument,	NULL,		22 },
 		{"host-lo-to-ns-lo", no_argument, 	NULL,		23 },
 		{"dns-host",	required_argument,	NULL,		24 },
+		{"rate-flow",	required_argument,	NULL,		25 },
+		{"rate-pif",	required_argument,	NULL,		26 },
+		{"tcp-frames",	required_argument,	NULL,		27 },
+		{"splice-offload", no_argument,		NULL,		28 },
+		{"busy-poll",	optional_argument,	NULL,		29 },
+		{"stats-socket", required_argument,	NULL,		30 },
+		{"stats-file",	required_argument,	NULL,		31 },
+		{"pcap-snaplen", required_argument,	NULL,		32 },
+		{"pcap-filter",	required_argument,	NULL,		33 },
+		{"pcap-size",	required_argument,	NULL,		34 },
+		{"pcap-interval", required_argument,	NULL,		35 },
+		{"pcap-files",	required_argument,	NULL,		36 },
+		{"trace-ring",	required_argument,	NULL,		37 },
 		{ 0 },
 	};
 	const char *logname = (c->mode == MODE_PASTA) ? "pasta" : "passt";
@@ -1498,6 +1537,112 @@ void conf(struct ctx *c, int argc, char **argv)
 				break;
 
 			die("Invalid host nameserver address: %s", optarg);
+			break;
+		case 25:
+			errno = 0;
+			c->rate_flow = strtoul(optarg, NULL, 0);
+
+			if (!c->rate_flow || errno)
+				die("Invalid --rate-flow: %s", optarg);
+
+			break;
+		case 26:
+			errno = 0;
+			c->rate_pif = strtoul(optarg, NULL, 0);
+
+			if (!c->rate_pif || errno)
+				die("Invalid --rate-pif: %s", optarg);
+
+			break;
+		case 27:
+			errno = 0;
+			c->tcp.frames = strtoul(optarg, NULL, 0);
+
+			if (c->tcp.frames < 2 || c->tcp.frames > TCP_FRAMES_MAX ||
+			    errno)
+				die("Invalid --tcp-frames: %s", optarg);
+
+			break;
+		case 28:
+			if (c->mode != MODE_PASTA)
+				die("--splice-offload is for pasta mode only");
+
+			c->tcp.splice_offload = 1;
+			break;
+		case 29:
+			if (!optarg) {
+				c->busy_poll = BUSY_POLL_DEFAULT;
+				break;
+			}
+
+			errno = 0;
+			c->busy_poll = strtoul(optarg, NULL, 0);
+
+			if (!c->busy_poll || c->busy_poll > BUSY_POLL_MAX ||
+			    errno)
+				die("Invalid --busy-poll: %s", optarg);
+
+			break;
+		case 30:
+			ret = snprintf(c->stats_path, sizeof(c->stats_path),
+				       "%s", optarg);
+			if (ret <= 0 || ret >= (int)sizeof(c->stats_path))
+				die("Invalid statistics socket path: %s",
+				    optarg);
+
+			break;
+		case 31:
+			ret = snprintf(c->stats_file, sizeof(c->stats_file),
+				       "%s", optarg);
+			if (ret <= 0 || ret >= (int)sizeof(c->stats_file))
+				die("Invalid statistics file: %s", optarg);
+
+			break;
+		case 32:
+			errno = 0;
+			c->pcap_snaplen = strtoul(optarg, NULL, 0);
+
+			if (!c->pcap_snaplen || c->pcap_snaplen > ETH_MAX_MTU ||
+			    errno)
+				die("Invalid --pcap-snaplen: %s", optarg);
+
+			break;
+		case 33:
+			if (pcap_filter_compile(&c->pcap_filter, optarg))
+				die("Invalid --pcap-filter: %s", optarg);
+
+			break;
+		case 34:
+			errno = 0;
+			c->pcap_size = strtoul(optarg, NULL, 0);
+
+			if (c->pcap_size < PCAP_SIZE_MIN || errno)
+				die("Invalid --pcap-size: %s", optarg);
+
+			break;
+		case 35:
+			errno = 0;
+			c->pcap_interval = strtoul(optarg, NULL, 0);
+
+			if (!c->pcap_interval || errno)
+				die("Invalid --pcap-interval: %s", optarg);
+
+			break;
+		case 36:
+			errno = 0;
+			c->pcap_files = strtoul(optarg, NULL, 0);
+
+			if (!c->pcap_files || c->pcap_files > PCAP_FILES_MAX ||
+			    errno)
+				die("Invalid --pcap-files: %s", optarg);
+
+			break;
+		case 37:
+			ret = snprintf(c->trace_ring, sizeof(c->trace_ring),
+				       "%s", optarg);
+			if (ret <= 0 || ret >= (int)sizeof(c->trace_ring))
+				die("Invalid trace ring file: %s", optarg);
+
 			break;
 		case 'd':
 			c->debug = 1;
@@ -1806,6 +1951,10 @@ void conf(struct ctx *c, int argc, char **argv)
 
 	conf_open_files(c);	/* Before any possible setuid() / setgid() */
 
+	/* Needs capabilities in the initial user namespace, see sockmap.c */
+	if (c->tcp.splice_offload && sockmap_init())
+		c->tcp.splice_offload = 0;
+
 	isolate_user(uid, gid, !netns_only, userns, c->mode);
 
 	if (c->pasta_conf_ns)
@@ -36,6 +36,10 @@ enum epoll_type {
 	EPOLL_TYPE_TAP_PASST,
 	/* socket listening for qemu socket connections */
 	EPOLL_TYPE_TAP_LISTEN,
+	/* UNIX domain socket for clients reading runtime counters */
+	EPOLL_TYPE_STATS,
+	/* Connected client we're still sending counters to */
+	EPOLL_TYPE_STATS_CLIENT,
 
 	EPOLL_NUM_TYPES,
 };
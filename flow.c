@@ -19,6 +19,10 @@
 #include "inany.h"
 #include "flow.h"
 #include "flow_table.h"
+#include "rate.h"
+#include "stats.h"
+#include "usdt.h"
+#include "trace_ring.h"
 
 const char *flow_state_str[] = {
 	[FLOW_STATE_FREE]	= "FREE",
@@ -122,6 +126,12 @@ static_assert(ARRAY_SIZE(flow_hashtab) >= 2 * FLOW_MAX,
 /* Last time the flow timers ran */
 static struct timespec flow_timer_run;
 
+/* Flows which used up their budget with work left, for next iteration */
+static unsigned flow_ready_idx[FLOW_MAX];
+static unsigned flow_ready_n;
+static uint8_t flow_ready_map[DIV_ROUND_UP(FLOW_MAX, 8)]
+	__attribute__((aligned(sizeof(long))));
+
 /** flowside_from_af() - Initialise flowside from addresses
  * @side:	flowside to initialise
  * @af:		Address family (AF_INET or AF_INET6)
@@ -269,16 +279,23 @@ void flow_log_(const struct flow_common *f, int pri, const char *fmt, ...)
 	char msg[BUFSIZ];
 	va_list args;
 
-	va_start(args, fmt);
-	(void)vsnprintf(msg, sizeof(msg), fmt, args);
-	va_end(args);
-
 	/* Show type if it's set, otherwise the state */
 	if (f->state < FLOW_STATE_TYPED)
 		type_or_state = FLOW_STATE(f);
 	else
 		type_or_state = FLOW_TYPE(f);
 
+	va_start(args, fmt);
+	if (trace_ring_on && pri == LOG_DEBUG) {
+		trace_ring_vadd(type_or_state, flow_idx(f), TRACE_RING_NEWLINE,
+				fmt, args);
+		va_end(args);
+		return;
+	}
+
+	(void)vsnprintf(msg, sizeof(msg), fmt, args);
+	va_end(args);
+
 	logmsg(true, false, pri,
 	       "Flow %u (%s): %s", flow_idx(f), type_or_state, msg);
 }
@@ -487,6 +504,7 @@ void flow_activate(struct flow_common *f)
 	ASSERT(f->pif[INISIDE] != PIF_NONE && f->pif[TGTSIDE] != PIF_NONE);
 
 	flow_set_state(f, FLOW_STATE_ACTIVE);
+	USDT3(flow_new, FLOW_IDX(flow_new_entry), f->type, f->pif[TGTSIDE]);
 	flow_new_entry = NULL;
 }
 
@@ -616,13 +634,16 @@ static uint64_t flow_sidx_hash(const struct ctx *c, flow_sidx_t sidx)
  */
 static inline unsigned flow_hash_probe_(uint64_t hash, flow_sidx_t sidx)
 {
-	unsigned b = hash % FLOW_HASH_SIZE;
+	unsigned b = hash % FLOW_HASH_SIZE, probes = 1;
 
 	/* Linear probing */
 	while (flow_sidx_valid(flow_hashtab[b]) &&
-	       !flow_sidx_eq(flow_hashtab[b], sidx))
+	       !flow_sidx_eq(flow_hashtab[b], sidx)) {
 		b = mod_sub(b, 1, FLOW_HASH_SIZE);
+		probes++;
+	}
 
+	stats_hist_add(&stats.probe, probes);
 	return b;
 }
 
@@ -702,17 +723,20 @@ void flow_hash_remove(const struct ctx *c, flow_sidx_t sidx)
 static flow_sidx_t flowside_lookup(const struct ctx *c, uint8_t proto,
 				   uint8_t pif, const struct flowside *side)
 {
+	unsigned b, probes = 1;
 	flow_sidx_t sidx;
 	union flow *flow;
-	unsigned b;
 
 	b = flow_hash(c, proto, pif, side) % FLOW_HASH_SIZE;
 	while ((sidx = flow_hashtab[b], flow = flow_at_sidx(sidx)) &&
 	       !(FLOW_PROTO(&flow->f) == proto &&
 		 flow->f.pif[sidx.sidei] == pif &&
-		 flowside_eq(&flow->f.side[sidx.sidei], side)))
+		 flowside_eq(&flow->f.side[sidx.sidei], side))) {
 		b = mod_sub(b, 1, FLOW_HASH_SIZE);
+		probes++;
+	}
 
+	stats_hist_add(&stats.probe, probes);
 	return flow_hashtab[b];
 }
 
@@ -856,6 +880,8 @@ void flow_defer_handler(const struct ctx *c, const struct timespec *now)
 		}
 
 		if (closed) {
+			USDT2(flow_free, idx, flow->f.type);
+			rate_flow_reset(c, idx);
 			flow_set_state(&flow->f, FLOW_STATE_FREE);
 			memset(flow, 0, sizeof(*flow));
 
@@ -879,6 +905,64 @@ void flow_defer_handler(const struct ctx *c, const struct timespec *now)
 	*last_next = FLOW_MAX;
 }
 
+/**
+ * flow_ready() - Queue flow with work left after using up its budget
+ * @flowi:	Flow index
+ */
+void flow_ready(unsigned flowi)
+{
+	if (bitmap_isset(flow_ready_map, flowi))
+		return;
+
+	bitmap_set(flow_ready_map, flowi);
+	flow_ready_idx[flow_ready_n++] = flowi;
+}
+
+/**
+ * flow_ready_pending() - Check if any flow has work left from past wakeups
+ *
+ * Return: true if at least one flow is queued, false otherwise
+ */
+bool flow_ready_pending(void)
+{
+	return flow_ready_n;
+}
+
+/**
+ * flow_ready_handler() - Resume flows queued in previous main loop iterations
+ * @c:		Execution context
+ * @now:	Current timestamp
+ */
+void flow_ready_handler(const struct ctx *c, const struct timespec *now)
+{
+	unsigned i, n;
+
+	/* Flows running out of budget again are queued back at positions we
+	 * already went through, and resumed on the next call.
+	 */
+	for (n = flow_ready_n, flow_ready_n = i = 0; i < n; i++) {
+		unsigned flowi = flow_ready_idx[i];
+		union flow *flow = FLOW(flowi);
+
+		bitmap_clear(flow_ready_map, flowi);
+
+		if (flow->f.state != FLOW_STATE_ACTIVE)
+			continue;
+
+		switch (flow->f.type) {
+		case FLOW_TCP:
+			tcp_data_resume(c, &flow->tcp);
+			break;
+		case FLOW_UDP:
+			udp_flow_resume(c, &flow->udp, now);
+			break;
+		default:
+			/* Other flow types don't queue themselves */
+			;
+		}
+	}
+}
+
 /**
  * flow_init() - Initialise flow related data structures
  */
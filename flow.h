@@ -8,6 +8,7 @@
 #define FLOW_H
 
 #define FLOW_TIMER_INTERVAL		1000	/* ms */
+#define FLOW_BUDGET			4	/* Rounds of work per wakeup */
 
 /**
  * enum flow_state - States of a flow table entry
@@ -249,6 +250,9 @@ union flow;
 
 void flow_init(void);
 void flow_defer_handler(const struct ctx *c, const struct timespec *now);
+void flow_ready(unsigned flowi);
+bool flow_ready_pending(void);
+void flow_ready_handler(const struct ctx *c, const struct timespec *now);
 
 void flow_log_(const struct flow_common *f, int pri, const char *fmt, ...)
 	__attribute__((format(printf, 3, 4)));
@@ -264,6 +268,26 @@ void flow_log_(const struct flow_common *f, int pri, const char *fmt, ...)
 			flow_dbg((f), __VA_ARGS__);			\
 	} while (0)
 
+/* See logmsg_ratelimit() */
+#define flow_log_ratelimit(f_, pri, ...)				\
+	do {								\
+		static struct log_rate rate_;				\
+									\
+		if (log_ratelimit(&rate_, (pri), __func__))		\
+			flow_log((f_), (pri), __VA_ARGS__);		\
+	} while (0)
+
+#define flow_dbg_ratelimit(f, ...)					\
+	flow_log_ratelimit((f), LOG_DEBUG, __VA_ARGS__)
+#define flow_err_ratelimit(f, ...)					\
+	flow_log_ratelimit((f), LOG_ERR, __VA_ARGS__)
+
+#define flow_trace_ratelimit(f, ...)					\
+	do {								\
+		if (log_trace)						\
+			flow_dbg_ratelimit((f), __VA_ARGS__);		\
+	} while (0)
+
 void flow_log_details_(const struct flow_common *f, int pri,
 		       enum flow_state state);
 #define flow_log_details(f_, pri) \
@@ -41,6 +41,7 @@
 #include "inany.h"
 #include "icmp.h"
 #include "flow_table.h"
+#include "stats.h"
 
 #define ICMP_ECHO_TIMEOUT	60 /* s, timeout for ICMP socket activity */
 #define ICMP_NUM_IDS		(1U << 16)
@@ -89,6 +90,8 @@ void icmp_sock_handler(const struct ctx *c, union epoll_ref ref)
 		return;
 	}
 
+	stats_in(pingf->f.pif[TGTSIDE], STATS_ICMP, 1, n);
+
 	if (pingf->f.type == FLOW_PING4) {
 		struct icmphdr *ih4 = (struct icmphdr *)buf;
 
@@ -130,16 +133,18 @@ void icmp_sock_handler(const struct ctx *c, union epoll_ref ref)
 
 		ASSERT(saddr && daddr); /* Must have IPv4 addresses */
 		tap_icmp4_send(c, *saddr, *daddr, buf, n);
+		stats_latency(STATS_TO_TAP, STATS_ICMP, 1);
 	} else if (pingf->f.type == FLOW_PING6) {
 		const struct in6_addr *saddr = &ini->oaddr.a6;
 		const struct in6_addr *daddr = &ini->eaddr.a6;
 
 		tap_icmp6_send(c, saddr, daddr, buf, n);
+		stats_latency(STATS_TO_TAP, STATS_ICMP, 1);
 	}
 	return;
 
 unexpected:
-	flow_err(pingf, "Unexpected packet on ping socket");
+	flow_err_ratelimit(pingf, "Unexpected packet on ping socket");
 }
 
 /**
@@ -184,10 +189,11 @@ static struct icmp_ping_flow *icmp_ping_new(const struct ctx *c,
 		goto cancel;
 
 	if (flow->f.pif[TGTSIDE] != PIF_HOST) {
-		flow_err(flow, "No support for forwarding %s from %s to %s",
-			 proto == IPPROTO_ICMP ? "ICMP" : "ICMPv6",
-			 pif_name(flow->f.pif[INISIDE]),
-			 pif_name(flow->f.pif[TGTSIDE]));
+		flow_err_ratelimit(flow,
+				   "No support for forwarding %s from %s to %s",
+				   proto == IPPROTO_ICMP ? "ICMP" : "ICMPv6",
+				   pif_name(flow->f.pif[INISIDE]),
+				   pif_name(flow->f.pif[TGTSIDE]));
 		goto cancel;
 	}
 
@@ -300,9 +306,10 @@ int icmp_tap_handler(const struct ctx *c, uint8_t pif, sa_family_t af,
 
 	pif_sockaddr(c, &sa, &sl, PIF_HOST, &tgt->eaddr, 0);
 	if (sendto(pingf->sock, pkt, l4len, MSG_NOSIGNAL, &sa.sa, sl) < 0) {
-		flow_dbg(pingf, "failed to relay request to socket: %s",
-			 strerror(errno));
+		flow_dbg_ratelimit(pingf, "failed to relay request to socket: %s",
+				   strerror(errno));
 	} else {
+		stats_latency(STATS_TO_SOCK, STATS_ICMP, 1);
 		flow_dbg(pingf,
 			 "echo request to socket, ID: %"PRIu16", seq: %"PRIu16,
 			 id, seq);
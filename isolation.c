@@ -375,17 +375,34 @@ int isolate_prefork(const struct ctx *c)
  */
 void isolate_postfork(const struct ctx *c)
 {
+	bool sockmap = c->mode == MODE_PASTA && c->tcp.splice_offload;
+	bool rotate = *c->pcap && (c->pcap_size || c->pcap_interval);
+	bool mmap = c->zerocopy || rotate;
 	struct sock_fprog prog;
 
 	prctl(PR_SET_DUMPABLE, 0);
 
-	if (c->mode == MODE_PASTA) {
-		prog.len = (unsigned short)ARRAY_SIZE(filter_pasta);
-		prog.filter = filter_pasta;
-	} else {
-		prog.len = (unsigned short)ARRAY_SIZE(filter_passt);
-		prog.filter = filter_passt;
-	}
+#define FILTER(profile)							\
+	do {								\
+		prog.len = (unsigned short)ARRAY_SIZE(filter_##profile);\
+		prog.filter = filter_##profile;				\
+	} while (0)
+
+	/* Opt-in features need profile variants allowing further syscalls */
+	if (c->mode == MODE_PASTA && sockmap && mmap)
+		FILTER(pasta_mmap_sockmap);
+	else if (c->mode == MODE_PASTA && sockmap)
+		FILTER(pasta_sockmap);
+	else if (c->mode == MODE_PASTA && mmap)
+		FILTER(pasta_mmap);
+	else if (c->mode == MODE_PASTA)
+		FILTER(pasta);
+	else if (mmap)
+		FILTER(passt_mmap);
+	else
+		FILTER(passt);
+
+#undef FILTER
 
 	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) ||
 	    prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog))
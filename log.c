@@ -30,6 +30,7 @@
 #include "log.h"
 #include "util.h"
 #include "passt.h"
+#include "trace_ring.h"
 
 static int	log_sock = -1;		/* Optional socket to system logger */
 static char	log_ident[BUFSIZ];	/* Identifier string for openlog() */
@@ -263,6 +264,13 @@ void vlogmsg(bool newline, bool cont, int pri, const char *format, va_list ap)
 	const struct timespec *now;
 	struct timespec ts;
 
+	if (trace_ring_on && LOG_PRI(pri) == LOG_DEBUG) {
+		trace_ring_vadd(NULL, 0,
+				(newline ? TRACE_RING_NEWLINE : 0) |
+				(cont ? TRACE_RING_CONT : 0), format, ap);
+		return;
+	}
+
 	now = logtime(&ts);
 
 	if (debug_print && !cont) {
@@ -325,6 +333,57 @@ void logmsg_perror(int pri, const char *format, ...)
 	logmsg(true, true, pri, ": %s", strerror(errno_copy));
 }
 
+/**
+ * log_ratelimit() - Check if message can be logged, report suppressed ones
+ * @r:		Token bucket for call site
+ * @pri:	Priority of message
+ * @func:	Function name of call site, for summary of suppressed messages
+ *
+ * Return: true if message should be logged, false if it's suppressed
+ */
+bool log_ratelimit(struct log_rate *r, int pri, const char *func)
+{
+	struct timespec now;
+	time_t elapsed;
+
+	/* Don't use up tokens for messages we would discard anyway */
+	if (log_conf_parsed && !trace_ring_on &&
+	    !(log_mask & LOG_MASK(LOG_PRI(pri))))
+		return false;
+
+	/* Debugging output is explicitly requested in full when tracing */
+	if (LOG_PRI(pri) == LOG_DEBUG && (log_trace || trace_ring_on))
+		return true;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &now))
+		return true;
+
+	elapsed = now.tv_sec - r->last;
+	if (elapsed) {
+		if (elapsed >= LOG_RATE_BURST / LOG_RATE_PER_SEC)
+			r->tokens = LOG_RATE_BURST;
+		else
+			r->tokens = MIN(LOG_RATE_BURST,
+					r->tokens + elapsed * LOG_RATE_PER_SEC);
+		r->last = now.tv_sec;
+	}
+
+	if (!r->tokens) {
+		r->suppressed++;
+		return false;
+	}
+
+	r->tokens--;
+
+	if (r->suppressed) {
+		logmsg(true, false, pri, "%s: %u messages suppressed",
+		       func, r->suppressed);
+		r->suppressed = 0;
+	}
+
+	return true;
+}
+
 /**
  * trace_init() - Set log_trace depending on trace (debug) mode
  * @enable:	Tracing debug mode enabled if non-zero
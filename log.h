@@ -8,11 +8,15 @@
 
 #include <stdbool.h>
 #include <syslog.h>
+#include <time.h>
 
 #define LOGFILE_SIZE_DEFAULT		(1024 * 1024UL)
 #define LOGFILE_CUT_RATIO		30	/* When full, cut ~30% size */
 #define LOGFILE_SIZE_MIN		(5UL * MAX(BUFSIZ, PAGE_SIZE))
 
+#define LOG_RATE_BURST			10	/* Messages per site at once */
+#define LOG_RATE_PER_SEC		1	/* Then, messages per second */
+
 void vlogmsg(bool newline, bool cont, int pri, const char *format, va_list ap);
 void logmsg(bool newline, bool cont, int pri, const char *format, ...)
 	__attribute__((format(printf, 4, 5)));
@@ -53,6 +57,39 @@ void trace_init(int enable);
 			debug(__VA_ARGS__);				\
 	} while (0)
 
+/**
+ * struct log_rate - Token bucket for messages from a single call site
+ * @last:	Time we last added tokens, seconds
+ * @tokens:	Messages we can still log right away
+ * @suppressed:	Messages suppressed since we last logged one
+ */
+struct log_rate {
+	time_t last;
+	unsigned tokens;
+	unsigned suppressed;
+};
+
+bool log_ratelimit(struct log_rate *r, int pri, const char *func);
+
+/* For messages that can be triggered by single packets, from guest or host */
+#define logmsg_ratelimit(pri, ...)					\
+	do {								\
+		static struct log_rate rate_;				\
+									\
+		if (log_ratelimit(&rate_, (pri), __func__))		\
+			logmsg(true, false, (pri), __VA_ARGS__);	\
+	} while (0)
+
+#define err_ratelimit(...)	logmsg_ratelimit(LOG_ERR,     __VA_ARGS__)
+#define warn_ratelimit(...)	logmsg_ratelimit(LOG_WARNING, __VA_ARGS__)
+#define debug_ratelimit(...)	logmsg_ratelimit(LOG_DEBUG,   __VA_ARGS__)
+
+#define trace_ratelimit(...)						\
+	do {								\
+		if (log_trace)						\
+			debug_ratelimit(__VA_ARGS__);			\
+	} while (0)
+
 void __openlog(const char *ident, int option, int facility);
 void logfile_init(const char *name, const char *path, size_t size);
 void passt_vsyslog(bool newline, int pri, const char *format, va_list ap);
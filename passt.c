@@ -43,6 +43,7 @@
 #include "dhcpv6.h"
 #include "isolation.h"
 #include "pcap.h"
+#include "stats.h"
 #include "tap.h"
 #include "conf.h"
 #include "pasta.h"
@@ -50,6 +51,9 @@
 #include "log.h"
 #include "tcp_splice.h"
 #include "ndp.h"
+#include "rate.h"
+#include "zerocopy.h"
+#include "trace_ring.h"
 
 #define EPOLL_EVENTS		8
 
@@ -72,6 +76,8 @@ char *epoll_type_str[] = {
 	[EPOLL_TYPE_TAP_PASTA]		= "/dev/net/tun device",
 	[EPOLL_TYPE_TAP_PASST]		= "connected qemu socket",
 	[EPOLL_TYPE_TAP_LISTEN]		= "listening qemu socket",
+	[EPOLL_TYPE_STATS]		= "statistics socket",
+	[EPOLL_TYPE_STATS_CLIENT]	= "statistics client socket",
 };
 static_assert(ARRAY_SIZE(epoll_type_str) == EPOLL_NUM_TYPES,
 	      "epoll_type_str[] doesn't match enum epoll_type");
@@ -83,6 +89,8 @@ static_assert(ARRAY_SIZE(epoll_type_str) == EPOLL_NUM_TYPES,
  */
 static void post_handler(struct ctx *c, const struct timespec *now)
 {
+	rate_refill(c, now);
+
 #define CALL_PROTO_HANDLER(lc, uc)					\
 	do {								\
 		extern void						\
@@ -149,6 +157,27 @@ void proto_update_l2_buf(const unsigned char *eth_d, const unsigned char *eth_s)
 	udp_update_l2_buf(eth_d, eth_s);
 }
 
+/* Set once signals are only taken while the main loop waits for events, which
+ * then exits on behalf of signal handlers
+ */
+static volatile sig_atomic_t exit_deferred;
+static volatile sig_atomic_t exit_pending;	/* Exit status plus one, or 0 */
+
+/**
+ * passt_exit() - Exit from signal handler, deferred to main loop if running
+ * @status:	Exit status
+ *
+ * Exit handlers, such as pcap_close(), aren't async-signal-safe, and would
+ * otherwise find packet captures with partially copied frames.
+ */
+void passt_exit(int status)
+{
+	if (!exit_deferred)
+		exit(status);
+
+	exit_pending = status + 1;
+}
+
 /**
  * exit_handler() - Signal handler for SIGQUIT and SIGTERM
  * @unused:	Unused, handler deals with SIGQUIT and SIGTERM only
@@ -162,7 +191,7 @@ void exit_handler(int signal)
 {
 	(void)signal;
 
-	exit(EXIT_SUCCESS);
+	passt_exit(EXIT_SUCCESS);
 }
 
 /**
@@ -182,11 +211,12 @@ void exit_handler(int signal)
 int main(int argc, char **argv)
 {
 	struct epoll_event events[EPOLL_EVENTS];
-	int nfds, i, devnull_fd = -1;
+	int nfds, i, timeout, devnull_fd = -1;
+	struct timespec now, last_event = { 0 };
 	char argv0[PATH_MAX], *name;
 	struct ctx c = { 0 };
+	sigset_t block, waitmask;
 	struct rlimit limit;
-	struct timespec now;
 	struct sigaction sa;
 
 	if (clock_gettime(CLOCK_MONOTONIC, &log_start))
@@ -241,6 +271,7 @@ int main(int argc, char **argv)
 
 	conf(&c, argc, argv);
 	trace_init(c.trace);
+	trace_ring_init(&c);
 
 	pasta_netns_quit_init(&c);
 
@@ -252,6 +283,7 @@ int main(int argc, char **argv)
 		die_perror("Failed to get CLOCK_MONOTONIC time");
 
 	flow_init();
+	zerocopy_init();
 
 	if ((!c.no_udp && udp_init(&c)) || (!c.no_tcp && tcp_init(&c)))
 		exit(EXIT_FAILURE);
@@ -265,6 +297,7 @@ int main(int argc, char **argv)
 		dhcpv6_init(&c);
 
 	pcap_init(&c);
+	stats_init(&c);
 
 	if (!c.foreground) {
 		if ((devnull_fd = open("/dev/null", O_RDWR | O_CLOEXEC)) < 0)
@@ -286,6 +319,17 @@ int main(int argc, char **argv)
 		log_stderr = false;
 	}
 
+	/* Only take termination signals and SIGCHLD while waiting for events,
+	 * so that passt_exit() can't miss the main loop, see epoll_pwait() below
+	 */
+	sigemptyset(&block);
+	sigaddset(&block, SIGTERM);
+	sigaddset(&block, SIGQUIT);
+	sigaddset(&block, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &block, &waitmask))
+		die_perror("Couldn't block signals outside main loop wait");
+	exit_deferred = 1;
+
 	isolate_postfork(&c);
 
 	timer_init(&c, &now);
@@ -293,14 +337,35 @@ int main(int argc, char **argv)
 loop:
 	/* NOLINTBEGIN(bugprone-branch-clone): intervals can be the same */
 	/* cppcheck-suppress [duplicateValueTernary, unmatchedSuppression] */
-	nfds = epoll_wait(c.epollfd, events, EPOLL_EVENTS, TIMER_INTERVAL);
+	timeout = rate_pending() ? RATE_INTERVAL : TIMER_INTERVAL;
 	/* NOLINTEND(bugprone-branch-clone) */
+
+	/* With --busy-poll, spin for a while after events, instead of sleeping,
+	 * to avoid wakeup latency if more follow shortly
+	 */
+	if (flow_ready_pending() ||
+	    (c.busy_poll &&
+	     timespec_diff_us(&now, &last_event) < c.busy_poll))
+		timeout = 0;
+
+	nfds = epoll_pwait(c.epollfd, events, EPOLL_EVENTS, timeout, &waitmask);
 	if (nfds == -1 && errno != EINTR)
-		die_perror("epoll_wait() failed in main loop");
+		die_perror("epoll_pwait() failed in main loop");
+
+	if (exit_pending)
+		exit(exit_pending - 1);
 
 	if (clock_gettime(CLOCK_MONOTONIC, &now))
 		err_perror("Failed to get CLOCK_MONOTONIC time");
 
+	if (nfds > 0)
+		last_event = now;
+
+	stats_loop_start(&now);
+	stats_file_handler();
+	trace_ring_handler();
+	flow_ready_handler(&c, &now);
+
 	for (i = 0; i < nfds; i++) {
 		union epoll_ref ref = *((union epoll_ref *)&events[i].data.u64);
 		uint32_t eventmask = events[i].events;
@@ -332,7 +397,9 @@ loop:
 			tcp_splice_sock_handler(&c, ref, eventmask);
 			break;
 		case EPOLL_TYPE_TCP_LISTEN:
+			stats_conn_start();
 			tcp_listen_handler(&c, ref, &now);
+			stats_conn_done(ref.tcp_listen.pif);
 			break;
 		case EPOLL_TYPE_TCP_TIMER:
 			tcp_timer_handler(&c, ref);
@@ -346,6 +413,12 @@ loop:
 		case EPOLL_TYPE_PING:
 			icmp_sock_handler(&c, ref);
 			break;
+		case EPOLL_TYPE_STATS:
+			stats_handler(&c, eventmask);
+			break;
+		case EPOLL_TYPE_STATS_CLIENT:
+			stats_client_handler(&c, eventmask);
+			break;
 		default:
 			/* Can't happen */
 			ASSERT(0);
@@ -353,6 +426,10 @@ loop:
 	}
 
 	post_handler(&c, &now);
+	pcap_flush();
+
+	if (nfds > 0)
+		stats_loop_done();
 
 	goto loop;
 }
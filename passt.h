@@ -25,6 +25,7 @@ union epoll_ref;
 #include "fwd.h"
 #include "tcp.h"
 #include "udp.h"
+#include "pcap_filter.h"
 
 /* Default address for our end on the tap interface.  Bit 0 of byte 0 must be 0
  * (unicast) and bit 1 of byte 1 must be 1 (locally administered).  Otherwise
@@ -78,6 +79,9 @@ extern char *epoll_type_str[];
 	(((uint8_t)(n) < EPOLL_NUM_TYPES && epoll_type_str[(n)]) ?	\
 	                                    epoll_type_str[(n)] : "?")
 
+#define BUSY_POLL_DEFAULT	50		/* us, for --busy-poll */
+#define BUSY_POLL_MAX		1000000		/* us, 1s */
+
 #include <resolv.h>	/* For MAXNS below */
 
 /**
@@ -190,6 +194,15 @@ struct ip6_ctx {
  * @nofile:		Maximum number of open files (ulimit -n)
  * @sock_path:		Path for UNIX domain socket
  * @pcap:		Path for packet capture file
+ * @pcap_snaplen:	Bytes captured for each frame, 0 for whole frames
+ * @pcap_filter:	Compiled capture filter, no rules to capture everything
+ * @pcapng:		Write capture in pcapng format, with per-frame metadata
+ * @pcap_size:		Rotate capture files at this size, 0 for no limit
+ * @pcap_interval:	Rotate capture files at this interval, seconds, or 0
+ * @pcap_files:		Number of capture files to rotate through, 0: default
+ * @stats_path:	Path for UNIX domain socket exposing runtime counters
+ * @stats_file:	Path for file we write runtime counters to on SIGUSR2
+ * @trace_ring:	Path for file we write recorded debug messages to on SIGUSR1
  * @pidfile:		Path to PID file, empty string if not configured
  * @pidfile_fd:		File descriptor for PID file, -1 if none
  * @pasta_netns_fd:	File descriptor for network namespace in pasta mode
@@ -227,6 +240,10 @@ struct ip6_ctx {
  * @no_ra:		Disable router advertisements
  * @host_lo_to_ns_lo:	Map host loopback addresses to ns loopback addresses
  * @freebind:		Allow binding of non-local addresses for forwarding
+ * @rate_flow:		Rate limit per flow, bytes per second, 0 if unlimited
+ * @rate_pif:		Rate limit per pif, bytes per second, 0 if unlimited
+ * @zerocopy:		Use MSG_ZEROCOPY for large sends to host sockets
+ * @busy_poll:		Poll without sleeping for this long after events, us
  * @low_wmem:		Low probed net.core.wmem_max
  * @low_rmem:		Low probed net.core.rmem_max
  */
@@ -239,6 +256,15 @@ struct ctx {
 	int nofile;
 	char sock_path[UNIX_PATH_MAX];
 	char pcap[PATH_MAX];
+	unsigned int pcap_snaplen;
+	struct pcap_filter pcap_filter;
+	int pcapng;
+	size_t pcap_size;
+	unsigned int pcap_interval;
+	unsigned int pcap_files;
+	char stats_path[UNIX_PATH_MAX];
+	char stats_file[PATH_MAX];
+	char trace_ring[PATH_MAX];
 
 	char pidfile[PATH_MAX];
 	int pidfile_fd;
@@ -289,10 +315,16 @@ struct ctx {
 	int host_lo_to_ns_lo;
 	int freebind;
 
+	size_t rate_flow;
+	size_t rate_pif;
+	int zerocopy;
+	unsigned int busy_poll;
+
 	int low_wmem;
 	int low_rmem;
 };
 
+void passt_exit(int status);
 void proto_update_l2_buf(const unsigned char *eth_d,
 			 const unsigned char *eth_s);
 
@@ -73,12 +73,12 @@ void pasta_child_handler(int signal)
 	    !waitid(P_PID, pasta_child_pid, &infop, WEXITED | WNOHANG)) {
 		if (infop.si_pid == pasta_child_pid) {
 			if (infop.si_code == CLD_EXITED)
-				exit(infop.si_status);
-
-			/* If killed by a signal, si_status is the number.
-			 * Follow common shell convention of returning it + 128.
-			 */
-			exit(infop.si_status + 128);
+				passt_exit(infop.si_status);
+			else	/* If killed by a signal, si_status is the number.
+				 * Follow common shell convention of returning
+				 * it + 128.
+				 */
+				passt_exit(infop.si_status + 128);
 
 			/* Nothing to do, detached PID namespace going away */
 		}
@@ -15,8 +15,11 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -33,13 +36,50 @@
 #include "log.h"
 #include "pcap.h"
 #include "iov.h"
+#include "stats.h"
+#include "flow.h"
+#include "flow_table.h"
 
 #define PCAP_VERSION_MINOR 4
 
 static int pcap_fd = -1;
 
+/* Captured frames are copied, with their pcap headers, into a ring, and written
+ * out in a single writev() once per main loop iteration, see pcap_flush(), or
+ * whenever the ring is full. The file is non-blocking, so that a slow reader of
+ * a FIFO can't stall the data path: if the ring is still full after a flush,
+ * frames are dropped, and counted.
+ */
+#define PCAP_RING_BYTES		(1UL << 23)
+
+static char pcap_ring[PCAP_RING_BYTES];
+static size_t pcap_head;	/* Free-running index of first byte to write */
+static size_t pcap_tail;	/* Free-running index of next byte to fill */
+static unsigned pcap_dropped;	/* Frames dropped since last flush */
+
+/* With rotation, we cycle through files opened before sandboxing, truncating
+ * the next one once the current one reaches the configured size, or after the
+ * configured interval. With a size limit, files are allocated upfront with
+ * fallocate(), and frames are copied straight into a shared mapping of the
+ * current file, instead of the ring, without any system call. If that's not
+ * possible, for example on a FIFO, we fall back to the ring.
+ */
+static int pcap_fds[PCAP_FILES_MAX];
+static unsigned pcap_files = 1;	/* Number of files we rotate through */
+static unsigned pcap_file;	/* Index of current file in pcap_fds */
+static size_t pcap_size;	/* Maximum size of each file, 0 for no limit */
+static time_t pcap_interval;	/* Rotation interval, seconds, 0 for none */
+static time_t pcap_start;	/* Time we started writing current file */
+static size_t pcap_written;	/* Bytes written or queued to current file */
+static char *pcap_map;		/* Mapping of current file, pcap_size bytes */
+static bool pcap_nomap;		/* Mapping failed, don't try again */
+
+static size_t pcap_snaplen = ETH_MAX_MTU;
+static const struct pcap_filter *pcap_filter;
+static const struct ctx *pcap_c;	/* For flow lookups, pcapng only */
+
 /* See pcap.h from libpcap, or pcap-savefile(5) */
-static const struct {
+static struct {
 	uint32_t magic;
 #define PCAP_MAGIC		0xa1b2c3d4
 
@@ -67,33 +107,529 @@ struct pcap_pkthdr {
 	uint32_t len;
 };
 
+/* See draft-ietf-opsawg-pcapng, "PCAP Now Generic (pcapng) Capture File
+ * Format". We write one Section Header Block, one Interface Description Block
+ * for each pif, with interface IDs matching pif numbers minus one, and an
+ * Enhanced Packet Block for each frame.
+ */
+#define PCAPNG_SHB		0x0a0d0d0a
+#define PCAPNG_BYTE_ORDER	0x1a2b3c4d
+#define PCAPNG_IDB		1
+#define PCAPNG_EPB		6
+
+#define PCAPNG_OPT_END		0
+#define PCAPNG_SHB_USERAPPL	4
+#define PCAPNG_IF_NAME		2
+#define PCAPNG_IF_TSRESOL	9
+#define PCAPNG_EPB_FLAGS	2
+#define PCAPNG_OPT_CUSTOM	2988	/* Copyable custom option, UTF-8 */
+
+#define PCAPNG_EPB_INBOUND	1
+#define PCAPNG_EPB_OUTBOUND	2
+
+#define PCAPNG_PEN		2312	/* IANA Private Enterprise Number */
+
+#define PCAPNG_IF(pif)		((pif) - 1)
+
+/**
+ * struct pcapng_block - Common header of pcapng blocks
+ * @type:	Block type
+ * @len:	Total block length, including header and trailing length
+ */
+struct pcapng_block {
+	uint32_t type;
+	uint32_t len;
+};
+
+/**
+ * struct pcapng_shb - Section Header Block, up to options
+ * @b:		Common block header
+ * @magic:	Byte-order magic
+ * @major:	Major version
+ * @minor:	Minor version
+ * @section_len:	Length of section, -1 if not known
+ */
+struct pcapng_shb {
+	struct pcapng_block b;
+	uint32_t magic;
+	uint16_t major;
+	uint16_t minor;
+	int64_t section_len;
+};
+
+/**
+ * struct pcapng_idb - Interface Description Block, up to options
+ * @b:		Common block header
+ * @linktype:	Link type, LINKTYPE_ETHERNET for all pifs
+ * @reserved:	Reserved, zero
+ * @snaplen:	Maximum captured length for frames
+ */
+struct pcapng_idb {
+	struct pcapng_block b;
+	uint16_t linktype;
+	uint16_t reserved;
+	uint32_t snaplen;
+};
+
+/**
+ * struct pcapng_epb - Enhanced Packet Block, up to packet data
+ * @b:		Common block header
+ * @ifid:	Interface ID
+ * @ts_high:	Upper 32 bits of timestamp, in units given by if_tsresol
+ * @ts_low:	Lower 32 bits of timestamp
+ * @caplen:	Captured length, without padding
+ * @len:	Original length of frame
+ */
+struct pcapng_epb {
+	struct pcapng_block b;
+	uint32_t ifid;
+	uint32_t ts_high;
+	uint32_t ts_low;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+/**
+ * struct pcapng_opt - Option header
+ * @code:	Option code
+ * @len:	Length of option value, without padding
+ */
+struct pcapng_opt {
+	uint16_t code;
+	uint16_t len;
+};
+
+static bool pcapng;
+
+/**
+ * pcap_put() - Copy data to mapped file, or ring, wrapping around if needed
+ * @buf:	Data to copy
+ * @len:	Length of data, must fit in free space, see pcap_room()
+ */
+static void pcap_put(const void *buf, size_t len)
+{
+	size_t tail = pcap_tail % PCAP_RING_BYTES;
+	size_t n = MIN(len, PCAP_RING_BYTES - tail);
+
+	pcap_written += len;
+
+	if (pcap_map) {
+		memcpy(pcap_map + pcap_written - len, buf, len);
+		return;
+	}
+
+	memcpy(pcap_ring + tail, buf, n);
+	memcpy(pcap_ring, (const char *)buf + n, len - n);
+	pcap_tail += len;
+}
+
+/**
+ * pcapng_pad() - Pad data in ring to 32 bits, as pcapng requires
+ * @len:	Length of data we just copied
+ */
+static void pcapng_pad(size_t len)
+{
+	static const uint8_t pad[sizeof(uint32_t)];
+
+	pcap_put(pad, ROUND_UP(len, sizeof(uint32_t)) - len);
+}
+
+/**
+ * pcapng_opt() - Copy pcapng option to ring, with padding
+ * @code:	Option code
+ * @val:	Option value, can be NULL if @len is zero
+ * @len:	Length of value
+ */
+static void pcapng_opt(uint16_t code, const void *val, size_t len)
+{
+	struct pcapng_opt opt = { code, len };
+
+	pcap_put(&opt, sizeof(opt));
+	if (len) {
+		pcap_put(val, len);
+		pcapng_pad(len);
+	}
+}
+
+/**
+ * pcapng_optlen() - Space needed for a pcapng option, with padding
+ * @len:	Length of option value
+ *
+ * Return: total length of option, including header
+ */
+static size_t pcapng_optlen(size_t len)
+{
+	return sizeof(struct pcapng_opt) + ROUND_UP(len, sizeof(uint32_t));
+}
+
+/**
+ * pcapng_flow() - Describe flow a frame belongs to, for custom option
+ * @h:		Header fields of frame
+ * @dir:	PCAPNG_EPB_INBOUND for frames from tap, PCAPNG_EPB_OUTBOUND
+ * @dropped:	Frame couldn't be sent to tap
+ * @buf:	Buffer for description, with Private Enterprise Number first
+ * @size:	Size of @buf
+ *
+ * Return: length of description, including PEN, 0 if there's none
+ */
+static size_t pcapng_flow(const struct pcap_hdrs *h, int dir, bool dropped,
+			  char *buf, size_t size)
+{
+	flow_sidx_t sidx = FLOW_SIDX_NONE;
+	const union flow *flow;
+	uint32_t pen = PCAPNG_PEN;
+	size_t n = sizeof(pen);
+
+	memcpy(buf, &pen, sizeof(pen));
+
+	/* inany_addr is an IPv6 address, possibly IPv4-mapped, as in flows */
+	if (h->sport && dir == PCAPNG_EPB_INBOUND) {
+		sidx = flow_lookup_af(pcap_c, h->proto, PIF_TAP, AF_INET6,
+				      &h->src.a6, &h->dst.a6,
+				      h->sport, h->dport);
+	} else if (h->sport && dir == PCAPNG_EPB_OUTBOUND) {
+		sidx = flow_lookup_af(pcap_c, h->proto, PIF_TAP, AF_INET6,
+				      &h->dst.a6, &h->src.a6,
+				      h->dport, h->sport);
+	}
+
+	if ((flow = flow_at_sidx(sidx))) {
+		n += snprintf(buf + n, size - n, "Flow %u (%s), %s %s%s",
+			      sidx.flowi, FLOW_TYPE(&flow->f),
+			      dir == PCAPNG_EPB_INBOUND ? "to" : "from",
+			      pif_name(flow->f.pif[!sidx.sidei]),
+			      dropped ? ", dropped" : "");
+	} else if (dropped) {
+		n += snprintf(buf + n, size - n, "Dropped");
+	} else {
+		return 0;
+	}
+
+	return MIN(n, size - 1);
+}
+
+/**
+ * pcapng_headers() - Copy pcapng section header and interface blocks
+ */
+static void pcapng_headers(void)
+{
+	static const char userappl[] = "passt " VERSION;
+	struct pcapng_shb shb = {
+		.b = {
+			PCAPNG_SHB,
+			sizeof(shb) + pcapng_optlen(strlen(userappl)) +
+			pcapng_optlen(0) + sizeof(uint32_t),
+		},
+		.magic = PCAPNG_BYTE_ORDER,
+		.major = 1,
+		.minor = 0,
+		.section_len = -1,
+	};
+	uint8_t tsresol = 9;	/* Nanoseconds */
+	unsigned pif;
+
+	pcap_put(&shb, sizeof(shb));
+	pcapng_opt(PCAPNG_SHB_USERAPPL, userappl, strlen(userappl));
+	pcapng_opt(PCAPNG_OPT_END, NULL, 0);
+	pcap_put(&shb.b.len, sizeof(shb.b.len));
+
+	for (pif = PIF_NONE + 1; pif < PIF_NUM_TYPES; pif++) {
+		const char *name = pif_name(pif);
+		struct pcapng_idb idb = {
+			.b = {
+				PCAPNG_IDB,
+				sizeof(idb) + pcapng_optlen(strlen(name)) +
+				pcapng_optlen(sizeof(tsresol)) +
+				pcapng_optlen(0) + sizeof(uint32_t),
+			},
+			.linktype = PCAP_LINKTYPE_ETHERNET,
+			.snaplen = pcap_snaplen,
+		};
+
+		pcap_put(&idb, sizeof(idb));
+		pcapng_opt(PCAPNG_IF_NAME, name, strlen(name));
+		pcapng_opt(PCAPNG_IF_TSRESOL, &tsresol, sizeof(tsresol));
+		pcapng_opt(PCAPNG_OPT_END, NULL, 0);
+		pcap_put(&idb.b.len, sizeof(idb.b.len));
+	}
+}
+
+/**
+ * pcap_headers() - Copy file headers, at the beginning of each file
+ */
+static void pcap_headers(void)
+{
+	if (pcapng)
+		pcapng_headers();
+	else
+		pcap_put(&pcap_hdr, sizeof(pcap_hdr));
+}
+
+/**
+ * pcap_flush() - Write out captured frames from ring, if any
+ *
+ * #syscalls writev
+ */
+void pcap_flush(void)
+{
+	size_t head = pcap_head % PCAP_RING_BYTES, used = pcap_tail - pcap_head;
+	size_t n = MIN(used, PCAP_RING_BYTES - head);
+	struct iovec iov[2] = {
+		{ pcap_ring + head,	n },
+		{ pcap_ring,		used - n },
+	};
+	ssize_t rc;
+
+	if (pcap_dropped) {
+		debug("Capture ring full, dropped %u frames", pcap_dropped);
+		pcap_dropped = 0;
+	}
+
+	if (!used)
+		return;
+
+	rc = writev(pcap_fd, iov, iov[1].iov_len ? 2 : 1);
+	if (rc < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return;
+
+		debug_perror("Cannot write packet capture, discarding %zu bytes",
+			     used);
+		rc = used;
+	}
+
+	pcap_head += rc;
+}
+
+/**
+ * pcap_close() - Write out ring, trim mapped file to the data we wrote, on exit
+ *
+ * #syscalls:passt_mmap ftruncate
+ * #syscalls:pasta_mmap ftruncate
+ */
+static void pcap_close(void)
+{
+	/* Keep going as long as writes make progress, they might be short */
+	while (pcap_tail != pcap_head) {
+		size_t used = pcap_tail - pcap_head;
+
+		pcap_flush();
+		if (pcap_tail - pcap_head == used) {
+			debug("Discarding %zu bytes of capture on exit", used);
+			break;
+		}
+	}
+
+	if (pcap_map && ftruncate(pcap_fd, pcap_written))
+		debug_perror("Can't trim packet capture file");
+}
+
+/**
+ * pcap_map_file() - Allocate and map current file, if we have a size limit
+ *
+ * #syscalls:passt_mmap fallocate mmap|mmap2
+ * #syscalls:pasta_mmap fallocate mmap|mmap2
+ */
+static void pcap_map_file(void)
+{
+	void *p;
+
+	if (!pcap_size || pcap_nomap || pcap_map)
+		return;
+
+	/* Data from the ring needs to be written first, at the current offset */
+	pcap_flush();
+	if (pcap_tail != pcap_head)
+		return;
+
+	if (fallocate(pcap_fd, 0, 0, pcap_size) ||
+	    (p = mmap(NULL, pcap_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		      pcap_fd, 0)) == MAP_FAILED) {
+		debug_perror("Can't map packet capture file, using writes");
+		pcap_nomap = true;
+		return;
+	}
+
+	pcap_map = p;
+}
+
 /**
- * pcap_frame() - Capture a single frame to pcap file with given timestamp
+ * pcap_rotate() - Switch to next file, truncating it, and write headers
+ * @now:	Current time, seconds
+ *
+ * Rotation and size limits select the mmap profile variants, see
+ * isolate_postfork()
+ *
+ * #syscalls:passt_mmap munmap ftruncate lseek i686:_llseek
+ * #syscalls:passt_mmap ppc64le:_llseek ppc64:_llseek arm:_llseek
+ * #syscalls:pasta_mmap munmap ftruncate lseek i686:_llseek
+ * #syscalls:pasta_mmap ppc64le:_llseek ppc64:_llseek arm:_llseek
+ */
+static void pcap_rotate(time_t now)
+{
+	if (pcap_map) {
+		munmap(pcap_map, pcap_size);
+		pcap_map = NULL;
+
+		if (ftruncate(pcap_fd, pcap_written))
+			debug_perror("Can't trim packet capture file");
+	} else {
+		pcap_flush();
+		if (pcap_tail != pcap_head) {
+			debug("Discarding %zu bytes of capture on rotation",
+			      pcap_tail - pcap_head);
+			pcap_head = pcap_tail;
+		}
+	}
+
+	pcap_file = (pcap_file + 1) % pcap_files;
+	pcap_fd = pcap_fds[pcap_file];
+
+	if (ftruncate(pcap_fd, 0) || lseek(pcap_fd, 0, SEEK_SET))
+		debug_perror("Can't truncate packet capture file");
+
+	debug("Packet capture rotated to file %u", pcap_file);
+
+	pcap_written = 0;
+	pcap_start = now;
+
+	pcap_map_file();
+	pcap_headers();
+}
+
+/**
+ * pcap_room() - Make sure there's enough free space, rotate or flush if needed
+ * @len:	Bytes we need
+ * @now:	Current time, seconds
+ *
+ * Return: true if there's enough space, false if frame needs to be dropped
+ */
+static bool pcap_room(size_t len, time_t now)
+{
+	static bool registered;
+
+	/* Not from pcap_init(): the parent would write out the ring, and trim
+	 * the file, on exit when daemonising, and we only get frames after that.
+	 */
+	if (!registered) {
+		atexit(pcap_close);
+		registered = true;
+	}
+
+	pcap_map_file();
+
+	if ((pcap_interval && now - pcap_start >= pcap_interval) ||
+	    (pcap_size && pcap_written + len > pcap_size)) {
+		pcap_rotate(now);
+
+		if (pcap_size && pcap_written + len > pcap_size)
+			goto drop;
+	}
+
+	if (pcap_map)
+		return true;
+
+	if (PCAP_RING_BYTES - (pcap_tail - pcap_head) >= len)
+		return true;
+
+	pcap_flush();
+
+	if (PCAP_RING_BYTES - (pcap_tail - pcap_head) >= len)
+		return true;
+
+drop:
+	stats.pcap_dropped++;
+	pcap_dropped++;
+	return false;
+}
+
+/**
+ * pcap_frame() - Capture a single frame to ring with given timestamp
  * @iov:	IO vector containing frame (with L2 headers and tap headers)
  * @iovcnt:	Number of buffers (@iov entries) in frame
  * @offset:	Byte offset of the L2 headers within @iov
  * @now:	Timestamp
- *
- * Returns: 0 on success, -errno on error writing to the file
+ * @dir:	PCAPNG_EPB_INBOUND or PCAPNG_EPB_OUTBOUND, 0 if unknown
+ * @dropped:	Frame couldn't be sent to tap, only captured with pcapng
  */
 static void pcap_frame(const struct iovec *iov, size_t iovcnt,
-		       size_t offset, const struct timespec *now)
+		       size_t offset, const struct timespec *now,
+		       int dir, bool dropped)
 {
 	size_t l2len = iov_size(iov, iovcnt) - offset;
-	struct pcap_pkthdr h = {
-		.tv_sec = now->tv_sec,
-		.tv_usec = DIV_ROUND_CLOSEST(now->tv_nsec, 1000),
-		.caplen = l2len,
-		.len = l2len
-	};
+	size_t caplen = MIN(l2len, pcap_snaplen);
+	char hdr[PCAP_FILTER_HDR], flow[128];
+	size_t i, flowlen = 0, padlen = caplen;
+	uint32_t blocklen = 0;
+	struct pcap_hdrs hdrs;
+
+	if (pcap_filter->n || pcapng) {
+		size_t n = iov_to_buf(iov, iovcnt, offset, hdr, sizeof(hdr));
+
+		pcap_filter_parse(&hdrs, hdr, n);
+		if (!pcap_filter_match(pcap_filter, &hdrs))
+			return;
+	}
+
+	if (pcapng) {
+		uint64_t ts = now->tv_sec * 1000000000ULL + now->tv_nsec;
+		struct pcapng_epb epb = {
+			.b.type = PCAPNG_EPB,
+			.ifid = PCAPNG_IF(PIF_TAP),
+			.ts_high = ts >> 32,
+			.ts_low = ts,
+			.caplen = caplen,
+			.len = l2len,
+		};
+
+		flowlen = pcapng_flow(&hdrs, dir, dropped, flow, sizeof(flow));
+
+		blocklen = epb.b.len = sizeof(epb) +
+				       ROUND_UP(caplen, sizeof(uint32_t)) +
+				       pcapng_optlen(sizeof(uint32_t)) +
+				       (flowlen ? pcapng_optlen(flowlen) : 0) +
+				       pcapng_optlen(0) + sizeof(blocklen);
+
+		if (!pcap_room(blocklen, now->tv_sec))
+			return;
 
-	if (write_all_buf(pcap_fd, &h, sizeof(h)) < 0 ||
-	    write_remainder(pcap_fd, iov, iovcnt, offset) < 0)
-		debug_perror("Cannot log packet, length %zu", l2len);
+		pcap_put(&epb, sizeof(epb));
+	} else {
+		struct pcap_pkthdr h = {
+			.tv_sec = now->tv_sec,
+			.tv_usec = DIV_ROUND_CLOSEST(now->tv_nsec, 1000),
+			.caplen = caplen,
+			.len = l2len
+		};
+
+		if (dropped || !pcap_room(sizeof(h) + caplen, now->tv_sec))
+			return;
+
+		pcap_put(&h, sizeof(h));
+	}
+
+	i = iov_skip_bytes(iov, iovcnt, offset, &offset);
+	for (; i < iovcnt && caplen; i++, offset = 0) {
+		size_t n = MIN(iov[i].iov_len - offset, caplen);
+
+		pcap_put((char *)iov[i].iov_base + offset, n);
+		caplen -= n;
+	}
+
+	if (pcapng) {
+		uint32_t flags = dir;
+
+		pcapng_pad(padlen);
+		pcapng_opt(PCAPNG_EPB_FLAGS, &flags, sizeof(flags));
+		if (flowlen)
+			pcapng_opt(PCAPNG_OPT_CUSTOM, flow, flowlen);
+		pcapng_opt(PCAPNG_OPT_END, NULL, 0);
+		pcap_put(&blocklen, sizeof(blocklen));
+	}
 }
 
 /**
- * pcap() - Capture a single frame to pcap file
+ * pcap() - Capture a single frame received from tap to pcap file
  * @pkt:	Pointer to data buffer, including L2 headers
  * @l2len:	L2 frame length
  */
@@ -108,18 +644,19 @@ void pcap(const char *pkt, size_t l2len)
 	if (clock_gettime(CLOCK_REALTIME, &now))
 		err_perror("Failed to get CLOCK_REALTIME time");
 
-	pcap_frame(&iov, 1, 0, &now);
+	pcap_frame(&iov, 1, 0, &now, PCAPNG_EPB_INBOUND, false);
 }
 
 /**
- * pcap_multiple() - Capture multiple frames
+ * pcap_multiple() - Capture multiple frames sent, or not, to tap
  * @iov:		IO vector with @frame_parts * @n entries
  * @frame_parts:	Number of IO vector items for each frame
  * @n:			Number of frames to capture
+ * @sent:		Number of frames actually sent, the rest was dropped
  * @offset:		Offset of the L2 frame within each iovec buffer
  */
 void pcap_multiple(const struct iovec *iov, size_t frame_parts, unsigned int n,
-		   size_t offset)
+		   unsigned int sent, size_t offset)
 {
 	struct timespec now = { 0 };
 	unsigned int i;
@@ -131,7 +668,8 @@ void pcap_multiple(const struct iovec *iov, size_t frame_parts, unsigned int n,
 		err_perror("Failed to get CLOCK_REALTIME time");
 
 	for (i = 0; i < n; i++)
-		pcap_frame(iov + i * frame_parts, frame_parts, offset, &now);
+		pcap_frame(iov + i * frame_parts, frame_parts, offset, &now,
+			   PCAPNG_EPB_OUTBOUND, i >= sent);
 }
 
 /*
@@ -154,7 +692,7 @@ void pcap_iov(const struct iovec *iov, size_t iovcnt, size_t offset)
 	if (clock_gettime(CLOCK_REALTIME, &now))
 		err_perror("Failed to get CLOCK_REALTIME time");
 
-	pcap_frame(iov, iovcnt, offset, &now);
+	pcap_frame(iov, iovcnt, offset, &now, 0, false);
 }
 
 /**
@@ -163,20 +701,66 @@ void pcap_iov(const struct iovec *iov, size_t iovcnt, size_t offset)
  */
 void pcap_init(struct ctx *c)
 {
+	/* Shared mappings need files open for reading too */
+	int flags = c->pcap_size ? O_RDWR : O_WRONLY;
+	bool rotate = c->pcap_size || c->pcap_interval;
+	struct timespec now = { 0 };
+	unsigned i;
+
 	if (pcap_fd != -1)
 		return;
 
 	if (!*c->pcap)
 		return;
 
-	pcap_fd = output_file_open(c->pcap, O_WRONLY);
-	if (pcap_fd == -1) {
-		err_perror("Couldn't open pcap file %s", c->pcap);
-		return;
+	if (rotate)
+		pcap_files = c->pcap_files ? c->pcap_files : PCAP_FILES_DEFAULT;
+
+	for (i = 0; i < pcap_files; i++) {
+		char path[PATH_MAX];
+
+		if (!rotate)
+			memcpy(path, c->pcap, sizeof(path));
+		else if (snprintf_check(path, sizeof(path), "%s.%u", c->pcap, i))
+			die("Invalid pcap path: %s", c->pcap);
+
+		pcap_fds[i] = output_file_open(path, flags);
+		if (pcap_fds[i] == -1) {
+			err_perror("Couldn't open pcap file %s", path);
+			while (i--)
+				close(pcap_fds[i]);
+			return;
+		}
+
+		if (fcntl(pcap_fds[i], F_SETFL, O_NONBLOCK))
+			warn_perror("Cannot set pcap file non-blocking");
+	}
+
+	pcap_fd = pcap_fds[0];
+
+	if (rotate) {
+		info("Saving packet capture to %s.0 to %s.%u, rotating",
+		     c->pcap, c->pcap, pcap_files - 1);
+	} else {
+		info("Saving packet capture to %s", c->pcap);
 	}
 
-	info("Saving packet capture to %s", c->pcap);
+	pcap_filter = &c->pcap_filter;
+	if (c->pcap_snaplen)
+		pcap_snaplen = pcap_hdr.snaplen = c->pcap_snaplen;
+
+	pcap_c = c;
+	pcapng = c->pcapng;
+	pcap_size = c->pcap_size;
+	pcap_interval = c->pcap_interval;
+
+	if (clock_gettime(CLOCK_REALTIME, &now))
+		err_perror("Failed to get CLOCK_REALTIME time");
+	pcap_start = now.tv_sec;
+
+	pcap_headers();
 
-	if (write(pcap_fd, &pcap_hdr, sizeof(pcap_hdr)) < 0)
-		warn_perror("Cannot write PCAP header");
+	pcap_flush();
+	if (pcap_tail != pcap_head)
+		warn("Cannot write packet capture headers");
 }
@@ -6,10 +6,15 @@
 #ifndef PCAP_H
 #define PCAP_H
 
+#define PCAP_FILES_DEFAULT	2	/* Files we rotate through, by default */
+#define PCAP_FILES_MAX		64
+#define PCAP_SIZE_MIN		(1024 * 1024UL)	/* Fits any frame, headers */
+
 void pcap(const char *pkt, size_t l2len);
 void pcap_multiple(const struct iovec *iov, size_t frame_parts, unsigned int n,
-		   size_t offset);
+		   unsigned int sent, size_t offset);
 void pcap_iov(const struct iovec *iov, size_t iovcnt, size_t offset);
+void pcap_flush(void);
 void pcap_init(struct ctx *c);
 
 #endif /* PCAP_H */
@@ -0,0 +1,288 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* PASST - Plug A Simple Socket Transport
+ *  for qemu/UNIX domain socket mode
+ *
+ * PASTA - Pack A Subtle Tap Abstraction
+ *  for network namespace/tap device mode
+ *
+ * pcap_filter.c - Capture filters for pcap
+ *
+ * Copyright Red Hat
+ *
+ * A filter is a list of words, with rules separated by "or": a frame is
+ * captured if it matches any rule, and it matches a rule if it matches all the
+ * words in it:
+ *
+ *   arp, ip, ip6		Ethertype
+ *   tcp, udp, icmp		Layer 4 protocol, icmp also matches ICMPv6
+ *   syn, fin, rst, ack		TCP segments with any of the given flags set
+ *   host ADDR			Source or destination address, IPv4 or IPv6
+ *   port PORT			Source or destination TCP or UDP port
+ *
+ * for example, "syn fin rst or udp port 53". Rules are compiled to a table of
+ * fields. Headers are parsed in a single pass, by pcap_filter_parse(), and
+ * matching is a comparison of the resulting fields against each rule.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+
+#include "util.h"
+#include "ip.h"
+#include "siphash.h"
+#include "inany.h"
+#include "pcap_filter.h"
+
+#define PCAP_FILTER_EXPR_MAX	1024
+
+/**
+ * pcap_rule_valid() - Check that rule has some fields set, and can match
+ * @r:		Rule to check
+ *
+ * Return: true if rule is valid, false otherwise
+ */
+static bool pcap_rule_valid(const struct pcap_rule *r)
+{
+	if (r->ethertype == ETH_P_ARP)
+		return !r->proto && !r->port && !r->has_addr;
+
+	return r->ethertype || r->proto || r->port || r->has_addr;
+}
+
+/**
+ * pcap_filter_word() - Apply a single word of a filter expression to a rule
+ * @r:		Rule being compiled
+ * @word:	Word of expression
+ * @arg:	Next word, used as argument for "host" and "port", can be NULL
+ *
+ * Return: number of words consumed, -EINVAL if @word isn't valid
+ */
+static int pcap_filter_word(struct pcap_rule *r, const char *word,
+			    const char *arg)
+{
+	static const struct {
+		const char *word;
+		uint16_t ethertype;
+		uint8_t proto;
+		uint8_t tcp_flags;
+	} words[] = {
+		{ "arp",	ETH_P_ARP,	0,		0 },
+		{ "ip",		ETH_P_IP,	0,		0 },
+		{ "ip6",	ETH_P_IPV6,	0,		0 },
+		{ "tcp",	0,		IPPROTO_TCP,	0 },
+		{ "udp",	0,		IPPROTO_UDP,	0 },
+		{ "icmp",	0,		IPPROTO_ICMP,	0 },
+		{ "syn",	0,		IPPROTO_TCP,	PCAP_FILTER_SYN },
+		{ "fin",	0,		IPPROTO_TCP,	PCAP_FILTER_FIN },
+		{ "rst",	0,		IPPROTO_TCP,	PCAP_FILTER_RST },
+		{ "ack",	0,		IPPROTO_TCP,	PCAP_FILTER_ACK },
+	};
+	unsigned long port;
+	char *end;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(words); i++) {
+		if (strcmp(word, words[i].word))
+			continue;
+
+		if ((words[i].ethertype && r->ethertype &&
+		     words[i].ethertype != r->ethertype) ||
+		    (words[i].proto && r->proto && words[i].proto != r->proto))
+			return -EINVAL;
+
+		if (words[i].ethertype)
+			r->ethertype = words[i].ethertype;
+		if (words[i].proto)
+			r->proto = words[i].proto;
+		r->tcp_flags |= words[i].tcp_flags;
+
+		return 1;
+	}
+
+	if (!arg)
+		return -EINVAL;
+
+	if (!strcmp(word, "host")) {
+		if (r->has_addr || inany_pton(arg, &r->addr) != 1)
+			return -EINVAL;
+
+		r->has_addr = true;
+		return 2;
+	}
+
+	if (!strcmp(word, "port")) {
+		errno = 0;
+		port = strtoul(arg, &end, 0);
+		if (r->port || *end || errno || !port || port > USHRT_MAX)
+			return -EINVAL;
+
+		r->port = port;
+		return 2;
+	}
+
+	return -EINVAL;
+}
+
+/**
+ * pcap_filter_compile() - Compile filter expression to table of rules
+ * @f:		Filter to fill
+ * @expr:	Filter expression, see top of file for syntax
+ *
+ * Return: 0 on success, -EINVAL if @expr is not valid, -E2BIG if too long
+ */
+int pcap_filter_compile(struct pcap_filter *f, const char *expr)
+{
+	/* Single-character words separated by single spaces, then NULL */
+	char buf[PCAP_FILTER_EXPR_MAX], *word[PCAP_FILTER_EXPR_MAX / 2 + 1];
+	unsigned i, n = 0;
+	char *saveptr;
+	int ret;
+
+	if (strlen(expr) >= sizeof(buf))
+		return -E2BIG;
+
+	strcpy(buf, expr);
+
+	for (word[n] = strtok_r(buf, " \t", &saveptr); word[n];
+	     word[n] = strtok_r(NULL, " \t", &saveptr))
+		n++;
+
+	memset(f, 0, sizeof(*f));
+	if (!n)
+		return -EINVAL;
+
+	f->n = 1;
+	for (i = 0; i < n; i += ret) {
+		struct pcap_rule *r = &f->rule[f->n - 1];
+
+		if (!strcmp(word[i], "or")) {
+			if (f->n == PCAP_FILTER_RULES)
+				return -E2BIG;
+
+			if (!pcap_rule_valid(r))
+				return -EINVAL;
+
+			f->n++;
+			ret = 1;
+			continue;
+		}
+
+		ret = pcap_filter_word(r, word[i], i + 1 < n ? word[i + 1]
+								: NULL);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (!pcap_rule_valid(&f->rule[f->n - 1]))
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * pcap_filter_parse() - Extract header fields used by filters from frame
+ * @h:		Header fields, filled on return
+ * @buf:	Start of frame, including Ethernet header
+ * @len:	Bytes available at @buf, up to PCAP_FILTER_HDR are used
+ */
+void pcap_filter_parse(struct pcap_hdrs *h, const char *buf, size_t len)
+{
+	const uint8_t *p = (const uint8_t *)buf, *l4 = NULL;
+
+	memset(h, 0, sizeof(*h));
+
+	len = MIN(len, PCAP_FILTER_HDR);
+
+	if (len >= ETH_HLEN)
+		h->ethertype = p[12] << 8 | p[13];
+
+	p += ETH_HLEN;
+	len -= MIN(len, ETH_HLEN);
+
+	if (h->ethertype == ETH_P_IP && len >= 20) {
+		size_t ihl = (p[0] & 0xf) * 4;
+		struct in_addr a;
+
+		memcpy(&a, p + 12, sizeof(a));
+		h->src = inany_from_v4(a);
+		memcpy(&a, p + 16, sizeof(a));
+		h->dst = inany_from_v4(a);
+
+		h->proto = p[9];
+		h->ip = true;
+
+		/* Not a fragment, or first one */
+		if (!((p[6] & 0x1f) << 8 | p[7]) && len >= ihl)
+			l4 = p + ihl;
+		len -= MIN(len, ihl);
+	} else if (h->ethertype == ETH_P_IPV6 && len >= 40) {
+		memcpy(&h->src.a6, p + 8, sizeof(h->src.a6));
+		memcpy(&h->dst.a6, p + 24, sizeof(h->dst.a6));
+
+		h->proto = p[6];
+		h->ip = true;
+
+		l4 = p + 40;
+		len -= 40;
+	}
+
+	if (l4 && (h->proto == IPPROTO_TCP || h->proto == IPPROTO_UDP) &&
+	    len >= 4) {
+		h->sport = l4[0] << 8 | l4[1];
+		h->dport = l4[2] << 8 | l4[3];
+
+		if (h->proto == IPPROTO_TCP && len >= 14)
+			h->tcp_flags = l4[13];
+	}
+}
+
+/**
+ * pcap_filter_match() - Check if a frame matches filter
+ * @f:		Compiled filter
+ * @h:		Header fields of frame, from pcap_filter_parse()
+ *
+ * Return: true if frame should be captured, false otherwise
+ */
+bool pcap_filter_match(const struct pcap_filter *f, const struct pcap_hdrs *h)
+{
+	unsigned i;
+
+	if (!f->n)
+		return true;
+
+	for (i = 0; i < f->n; i++) {
+		const struct pcap_rule *r = &f->rule[i];
+
+		if (r->ethertype && r->ethertype != h->ethertype)
+			continue;
+
+		if (r->proto && r->proto != h->proto &&
+		    !(r->proto == IPPROTO_ICMP && h->proto == IPPROTO_ICMPV6))
+			continue;
+
+		if (r->tcp_flags && !(h->tcp_flags & r->tcp_flags))
+			continue;
+
+		if (r->port && r->port != h->sport && r->port != h->dport)
+			continue;
+
+		if (r->has_addr &&
+		    (!h->ip || (!inany_equals(&r->addr, &h->src) &&
+				!inany_equals(&r->addr, &h->dst))))
+			continue;
+
+		return true;
+	}
+
+	return false;
+}
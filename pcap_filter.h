@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Capture filters for pcap: rules compiled to a table, matched on frame headers
+ */
+
+#ifndef PCAP_FILTER_H
+#define PCAP_FILTER_H
+
+#define PCAP_FILTER_RULES	8	/* Rules, any of them can match */
+
+/* Bytes of frame we need to evaluate a filter: Ethernet, IPv4 with maximum
+ * options length (longer than IPv6 header), TCP headers
+ */
+#define PCAP_FILTER_HDR		(14 + 60 + 20)
+
+/* TCP flags we can match on, as in byte 13 of the TCP header */
+#define PCAP_FILTER_FIN		0x01
+#define PCAP_FILTER_SYN		0x02
+#define PCAP_FILTER_RST		0x04
+#define PCAP_FILTER_ACK		0x10
+
+/**
+ * struct pcap_rule - Single rule: all the given fields need to match
+ * @ethertype:	Ethertype, host order, 0 for any
+ * @proto:	Layer 4 protocol, 0 for any, IPPROTO_ICMP also matches ICMPv6
+ * @tcp_flags:	TCP segments with any of these flags, 0 for any frame
+ * @port:	Source or destination port, host order, 0 for any
+ * @has_addr:	Match on @addr
+ * @addr:	Source or destination address
+ */
+struct pcap_rule {
+	uint16_t ethertype;
+	uint8_t proto;
+	uint8_t tcp_flags;
+	in_port_t port;
+	bool has_addr;
+	union inany_addr addr;
+};
+
+/**
+ * struct pcap_hdrs - Header fields of a frame, as used by filters
+ * @ethertype:	Ethertype, host order, 0 if frame is too short
+ * @proto:	Layer 4 protocol, 0 if not IP
+ * @tcp_flags:	Flags from TCP header, 0 if not TCP
+ * @ip:		Frame is an IPv4 or IPv6 packet, @src and @dst are set
+ * @sport:	Source port, host order, 0 if not TCP or UDP
+ * @dport:	Destination port, host order, 0 if not TCP or UDP
+ * @src:	Source address
+ * @dst:	Destination address
+ */
+struct pcap_hdrs {
+	uint16_t ethertype;
+	uint8_t proto;
+	uint8_t tcp_flags;
+	bool ip;
+	in_port_t sport;
+	in_port_t dport;
+	union inany_addr src;
+	union inany_addr dst;
+};
+
+/**
+ * struct pcap_filter - Compiled capture filter
+ * @n:		Number of rules, 0 to capture everything
+ * @rule:	Rules, a frame is captured if any of them matches
+ */
+struct pcap_filter {
+	unsigned n;
+	struct pcap_rule rule[PCAP_FILTER_RULES];
+};
+
+int pcap_filter_compile(struct pcap_filter *f, const char *expr);
+void pcap_filter_parse(struct pcap_hdrs *h, const char *buf, size_t len);
+bool pcap_filter_match(const struct pcap_filter *f, const struct pcap_hdrs *h);
+
+#endif /* PCAP_FILTER_H */
@@ -0,0 +1,204 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Token bucket rate limiting, per flow and per pif
+ *
+ * Buckets are refilled from post_handler(), that is, once per main loop
+ * iteration, without any additional timer: per-pif buckets directly, per-flow
+ * buckets lazily, on their next use, based on the time elapsed since their
+ * last refill.
+ *
+ * TCP connections are shaped: if there are no tokens left, we stop reading
+ * from the socket and queue the flow as pending, and we resume it from
+ * rate_refill() as tokens become available. UDP flows are policed instead:
+ * datagrams exceeding the allowance are dropped.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#include "util.h"
+#include "ip.h"
+#include "passt.h"
+#include "siphash.h"
+#include "inany.h"
+#include "flow.h"
+#include "flow_table.h"
+#include "log.h"
+#include "rate.h"
+
+static uint32_t rate_ms;		/* Time of last refill, wrapping */
+
+static struct rate_bucket rate_pif_bucket[PIF_NUM_TYPES];
+static struct rate_bucket rate_flow_bucket[FLOW_MAX];
+
+/* Throttled flows to be resumed once tokens are available */
+static unsigned rate_pending_idx[FLOW_MAX];
+static unsigned rate_pending_n;
+static uint8_t rate_pending_map[DIV_ROUND_UP(FLOW_MAX, 8)]
+	__attribute__((aligned(sizeof(long))));
+
+/**
+ * rate_burst() - Bucket depth for a given rate
+ * @rate:	Rate, bytes per second
+ *
+ * Return: maximum number of tokens in bucket
+ */
+static uint32_t rate_burst(size_t rate)
+{
+	uint64_t burst = (uint64_t)rate * RATE_BURST_MS / 1000;
+
+	return MIN(MAX(burst, RATE_BURST_MIN), RATE_BURST_MAX);
+}
+
+/**
+ * rate_fill() - Add tokens to bucket for time elapsed since last refill
+ * @b:		Bucket
+ * @rate:	Rate, bytes per second
+ */
+static void rate_fill(struct rate_bucket *b, size_t rate)
+{
+	uint32_t burst = rate_burst(rate), elapsed = rate_ms - b->stamp;
+	uint64_t add = (uint64_t)elapsed * rate / 1000;
+
+	if (b->tokens + add >= burst) {
+		b->tokens = burst;
+		b->stamp = rate_ms;
+		return;
+	}
+
+	/* Carry over the time we didn't account for, to keep low rates exact */
+	b->tokens += add;
+	b->stamp += add * 1000 / rate;
+}
+
+/**
+ * rate_avail() - Get number of bytes we can send now for a flow on a pif
+ * @c:		Execution context
+ * @pif:	pif we're sending to
+ * @flowi:	Flow index
+ *
+ * Return: number of bytes allowed by both buckets, SIZE_MAX if not limited
+ */
+size_t rate_avail(const struct ctx *c, uint8_t pif, unsigned flowi)
+{
+	size_t avail = SIZE_MAX;
+
+	if (c->rate_pif)
+		avail = rate_pif_bucket[pif].tokens;
+
+	if (c->rate_flow) {
+		struct rate_bucket *b = &rate_flow_bucket[flowi];
+
+		rate_fill(b, c->rate_flow);
+		avail = MIN(avail, b->tokens);
+	}
+
+	return avail;
+}
+
+/**
+ * rate_consume() - Take tokens from buckets for sent data
+ * @c:		Execution context
+ * @pif:	pif we sent to
+ * @flowi:	Flow index
+ * @len:	Number of bytes sent
+ */
+void rate_consume(const struct ctx *c, uint8_t pif, unsigned flowi, size_t len)
+{
+	if (c->rate_pif) {
+		struct rate_bucket *b = &rate_pif_bucket[pif];
+
+		b->tokens -= MIN(b->tokens, len);
+	}
+
+	if (c->rate_flow) {
+		struct rate_bucket *b = &rate_flow_bucket[flowi];
+
+		b->tokens -= MIN(b->tokens, len);
+	}
+}
+
+/**
+ * rate_flow_reset() - Reset per-flow bucket of freed flow, for its next user
+ * @c:		Execution context
+ * @flowi:	Flow index
+ */
+void rate_flow_reset(const struct ctx *c, unsigned flowi)
+{
+	struct rate_bucket *b = &rate_flow_bucket[flowi];
+
+	if (!c->rate_flow)
+		return;
+
+	b->tokens = rate_burst(c->rate_flow);
+	b->stamp = rate_ms;
+}
+
+/**
+ * rate_throttled() - Queue flow to be resumed once tokens are available
+ * @flowi:	Flow index
+ */
+void rate_throttled(unsigned flowi)
+{
+	if (bitmap_isset(rate_pending_map, flowi))
+		return;
+
+	bitmap_set(rate_pending_map, flowi);
+	rate_pending_idx[rate_pending_n++] = flowi;
+}
+
+/**
+ * rate_pending() - Check if any flow is waiting for tokens
+ *
+ * Return: true if at least one flow was throttled and not resumed yet
+ */
+bool rate_pending(void)
+{
+	return rate_pending_n;
+}
+
+/**
+ * rate_refill() - Refill per-pif buckets, resume throttled flows
+ * @c:		Execution context
+ * @now:	Current timestamp
+ */
+void rate_refill(const struct ctx *c, const struct timespec *now)
+{
+	unsigned i, n;
+
+	if (!c->rate_pif && !c->rate_flow)
+		return;
+
+	rate_ms = now->tv_sec * 1000 + now->tv_nsec / (1000 * 1000);
+
+	if (c->rate_pif) {
+		for (i = 0; i < PIF_NUM_TYPES; i++)
+			rate_fill(&rate_pif_bucket[i], c->rate_pif);
+	}
+
+	/* Flows throttled again while we resume them are queued back at
+	 * positions we already went through.
+	 */
+	for (n = rate_pending_n, rate_pending_n = i = 0; i < n; i++) {
+		unsigned flowi = rate_pending_idx[i];
+		union flow *flow = FLOW(flowi);
+
+		bitmap_clear(rate_pending_map, flowi);
+
+		if (flow->f.state != FLOW_STATE_ACTIVE)
+			continue;
+
+		switch (flow->f.type) {
+		case FLOW_TCP:
+			tcp_data_resume(c, &flow->tcp);
+			break;
+		default:
+			/* Only TCP flows are shaped */
+			;
+		}
+	}
+}
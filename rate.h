@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Token bucket rate limiting, per flow and per pif
+ */
+
+#ifndef RATE_H
+#define RATE_H
+
+#define RATE_INTERVAL		10	/* ms, main loop timeout if throttled */
+#define RATE_BURST_MS		100	/* Bucket depth, as time at full rate */
+#define RATE_BURST_MIN		(64 * 1024)	/* Always fits a full segment */
+#define RATE_BURST_MAX		(1U << 30)
+
+/**
+ * struct rate_bucket - Token bucket state
+ * @tokens:	Bytes we can currently send
+ * @stamp:	Time of last refill, in milliseconds, wrapping
+ */
+struct rate_bucket {
+	uint32_t tokens;
+	uint32_t stamp;
+};
+
+size_t rate_avail(const struct ctx *c, uint8_t pif, unsigned flowi);
+void rate_consume(const struct ctx *c, uint8_t pif, unsigned flowi,
+		  size_t len);
+void rate_flow_reset(const struct ctx *c, unsigned flowi);
+void rate_throttled(unsigned flowi);
+bool rate_pending(void);
+void rate_refill(const struct ctx *c, const struct timespec *now);
+
+#endif /* RATE_H */
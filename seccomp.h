@@ -0,0 +1,551 @@
+/* This file was automatically generated by seccomp.sh */
+
+#ifndef AUDIT_ARCH_PPC64LE
+#define AUDIT_ARCH_PPC64LE (AUDIT_ARCH_PPC64 | __AUDIT_ARCH_LE)
+#endif
+
+struct sock_filter filter_passt[] = {
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, arch))),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 80),
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, nr))),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 2, 1),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 50, 3, 2),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 4, 3),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 5, 4),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 41, 6, 5),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 233, 7, 6),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 10, 7),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 17, 13),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 24, 20),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 31, 27),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 8, 38, 34),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 46, 45, 41),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 77, 52, 48),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 286, 59, 55),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 64, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 63, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 62, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 61, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 60, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 59, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 58, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 57, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 56, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 55, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 54, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 53, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 52, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 51, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 50, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 49, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 48, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 47, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 46, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 45, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 44, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 43, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 42, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 41, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 40, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 39, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 38, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 37, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 36, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 35, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 34, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 33, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 32, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 31, 0), /* write */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 30, 0), /* close */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 8, 29, 0), /* lseek */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 15, 28, 0), /* rt_sigreturn */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 18, 27, 0), /* pwrite64 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 20, 26, 0), /* writev */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 41, 25, 0), /* socket */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 42, 24, 0), /* connect */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 44, 23, 0), /* sendto */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 45, 22, 0), /* recvfrom */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 46, 21, 0), /* sendmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 47, 20, 0), /* recvmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 48, 19, 0), /* shutdown */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 49, 18, 0), /* bind */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 50, 17, 0), /* listen */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 54, 16, 0), /* setsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 55, 15, 0), /* getsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 72, 14, 0), /* fcntl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 77, 13, 0), /* ftruncate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 228, 12, 0), /* clock_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 231, 11, 0), /* exit_group */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 232, 10, 0), /* epoll_wait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 233, 9, 0), /* epoll_ctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 281, 8, 0), /* epoll_pwait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 283, 7, 0), /* timerfd_create */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 285, 6, 0), /* fallocate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 286, 5, 0), /* timerfd_settime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 287, 4, 0), /* timerfd_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 288, 3, 0), /* accept4 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 299, 2, 0), /* recvmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 307, 1, 0), /* sendmmsg */
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+};
+
+struct sock_filter filter_passt_mmap[] = {
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, arch))),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 80),
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, nr))),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 3, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 2, 1),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 50, 3, 2),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 4, 3),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 5, 4),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 41, 6, 5),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 233, 7, 6),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 10, 7),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 17, 13),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 24, 20),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 31, 27),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 15, 38, 34),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 46, 45, 41),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 77, 52, 48),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 286, 59, 55),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 64, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 63, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 62, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 61, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 60, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 59, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 58, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 57, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 56, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 55, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 54, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 53, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 52, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 51, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 50, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 49, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 48, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 47, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 46, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 45, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 44, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 43, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 42, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 41, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 40, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 39, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 38, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 37, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 36, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 35, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 34, 0), /* write */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 33, 0), /* close */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 8, 32, 0), /* lseek */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 9, 31, 0), /* mmap */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 11, 30, 0), /* munmap */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 15, 29, 0), /* rt_sigreturn */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 18, 28, 0), /* pwrite64 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 20, 27, 0), /* writev */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 28, 26, 0), /* madvise */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 41, 25, 0), /* socket */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 42, 24, 0), /* connect */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 44, 23, 0), /* sendto */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 45, 22, 0), /* recvfrom */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 46, 21, 0), /* sendmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 47, 20, 0), /* recvmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 48, 19, 0), /* shutdown */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 49, 18, 0), /* bind */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 50, 17, 0), /* listen */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 54, 16, 0), /* setsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 55, 15, 0), /* getsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 72, 14, 0), /* fcntl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 77, 13, 0), /* ftruncate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 228, 12, 0), /* clock_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 231, 11, 0), /* exit_group */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 232, 10, 0), /* epoll_wait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 233, 9, 0), /* epoll_ctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 281, 8, 0), /* epoll_pwait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 283, 7, 0), /* timerfd_create */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 285, 6, 0), /* fallocate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 286, 5, 0), /* timerfd_settime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 287, 4, 0), /* timerfd_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 288, 3, 0), /* accept4 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 299, 2, 0), /* recvmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 307, 1, 0), /* sendmmsg */
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+};
+
+struct sock_filter filter_pasta[] = {
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, arch))),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 80),
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, nr))),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 20, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 2, 1),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 228, 3, 2),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 4, 3),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 5, 4),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 49, 6, 5),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 283, 7, 6),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 10, 7),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 17, 13),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 24, 20),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 14, 31, 27),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 45, 38, 34),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 56, 45, 41),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 247, 52, 48),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 288, 59, 55),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 64, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 63, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 62, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 61, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 60, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 59, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 58, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 57, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 56, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 55, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 54, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 53, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 52, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 51, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 50, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 49, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 48, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 47, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 46, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 45, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 44, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 43, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 42, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 41, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 40, 0), /* write */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 39, 0), /* close */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 8, 38, 0), /* lseek */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 14, 37, 0), /* rt_sigprocmask */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 15, 36, 0), /* rt_sigreturn */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 16, 35, 0), /* ioctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 18, 34, 0), /* pwrite64 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 20, 33, 0), /* writev */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 41, 32, 0), /* socket */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 42, 31, 0), /* connect */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 44, 30, 0), /* sendto */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 45, 29, 0), /* recvfrom */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 46, 28, 0), /* sendmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 47, 27, 0), /* recvmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 48, 26, 0), /* shutdown */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 49, 25, 0), /* bind */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 50, 24, 0), /* listen */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 54, 23, 0), /* setsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 55, 22, 0), /* getsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 56, 21, 0), /* clone */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 60, 20, 0), /* exit */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 72, 19, 0), /* fcntl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 77, 18, 0), /* ftruncate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 228, 17, 0), /* clock_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 231, 16, 0), /* exit_group */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 232, 15, 0), /* epoll_wait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 233, 14, 0), /* epoll_ctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 247, 13, 0), /* waitid */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 257, 12, 0), /* openat */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 275, 11, 0), /* splice */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 281, 10, 0), /* epoll_pwait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 283, 9, 0), /* timerfd_create */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 285, 8, 0), /* fallocate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 286, 7, 0), /* timerfd_settime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 287, 6, 0), /* timerfd_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 288, 5, 0), /* accept4 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 293, 4, 0), /* pipe2 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 299, 3, 0), /* recvmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 307, 2, 0), /* sendmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 308, 1, 0), /* setns */
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+};
+
+struct sock_filter filter_pasta_mmap[] = {
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, arch))),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 80),
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, nr))),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 28, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 2, 1),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 228, 3, 2),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 4, 3),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 8, 5, 4),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 49, 6, 5),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 283, 7, 6),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 10, 7),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 17, 13),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 24, 20),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 15, 31, 27),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 45, 38, 34),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 56, 45, 41),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 247, 52, 48),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 288, 59, 55),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 64, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 63, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 62, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 61, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 60, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 59, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 58, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 57, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 56, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 55, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 54, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 53, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 52, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 51, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 50, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 49, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 48, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 47, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 46, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 45, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 44, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 43, 0), /* write */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 42, 0), /* close */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 8, 41, 0), /* lseek */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 9, 40, 0), /* mmap */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 11, 39, 0), /* munmap */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 14, 38, 0), /* rt_sigprocmask */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 15, 37, 0), /* rt_sigreturn */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 16, 36, 0), /* ioctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 18, 35, 0), /* pwrite64 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 20, 34, 0), /* writev */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 28, 33, 0), /* madvise */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 41, 32, 0), /* socket */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 42, 31, 0), /* connect */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 44, 30, 0), /* sendto */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 45, 29, 0), /* recvfrom */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 46, 28, 0), /* sendmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 47, 27, 0), /* recvmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 48, 26, 0), /* shutdown */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 49, 25, 0), /* bind */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 50, 24, 0), /* listen */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 54, 23, 0), /* setsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 55, 22, 0), /* getsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 56, 21, 0), /* clone */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 60, 20, 0), /* exit */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 72, 19, 0), /* fcntl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 77, 18, 0), /* ftruncate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 228, 17, 0), /* clock_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 231, 16, 0), /* exit_group */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 232, 15, 0), /* epoll_wait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 233, 14, 0), /* epoll_ctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 247, 13, 0), /* waitid */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 257, 12, 0), /* openat */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 275, 11, 0), /* splice */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 281, 10, 0), /* epoll_pwait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 283, 9, 0), /* timerfd_create */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 285, 8, 0), /* fallocate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 286, 7, 0), /* timerfd_settime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 287, 6, 0), /* timerfd_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 288, 5, 0), /* accept4 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 293, 4, 0), /* pipe2 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 299, 3, 0), /* recvmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 307, 2, 0), /* sendmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 308, 1, 0), /* setns */
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+};
+
+struct sock_filter filter_pasta_sockmap[] = {
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, arch))),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 80),
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, nr))),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 41, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 2, 1),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 231, 3, 2),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 4, 3),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 1, 5, 4),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 50, 6, 5),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 285, 7, 6),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 10, 7),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 17, 13),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 24, 20),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 15, 31, 27),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 46, 38, 34),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 60, 45, 41),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 257, 52, 48),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 293, 59, 55),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 64, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 63, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 62, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 61, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 60, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 59, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 58, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 57, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 56, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 55, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 54, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 53, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 52, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 51, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 50, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 49, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 48, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 47, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 46, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 45, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 44, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 43, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 42, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 41, 0), /* write */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 40, 0), /* close */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 8, 39, 0), /* lseek */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 14, 38, 0), /* rt_sigprocmask */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 15, 37, 0), /* rt_sigreturn */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 16, 36, 0), /* ioctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 18, 35, 0), /* pwrite64 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 20, 34, 0), /* writev */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 41, 33, 0), /* socket */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 42, 32, 0), /* connect */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 44, 31, 0), /* sendto */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 45, 30, 0), /* recvfrom */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 46, 29, 0), /* sendmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 47, 28, 0), /* recvmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 48, 27, 0), /* shutdown */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 49, 26, 0), /* bind */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 50, 25, 0), /* listen */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 54, 24, 0), /* setsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 55, 23, 0), /* getsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 56, 22, 0), /* clone */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 60, 21, 0), /* exit */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 72, 20, 0), /* fcntl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 77, 19, 0), /* ftruncate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 228, 18, 0), /* clock_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 231, 17, 0), /* exit_group */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 232, 16, 0), /* epoll_wait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 233, 15, 0), /* epoll_ctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 247, 14, 0), /* waitid */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 257, 13, 0), /* openat */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 275, 12, 0), /* splice */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 281, 11, 0), /* epoll_pwait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 283, 10, 0), /* timerfd_create */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 285, 9, 0), /* fallocate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 286, 8, 0), /* timerfd_settime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 287, 7, 0), /* timerfd_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 288, 6, 0), /* accept4 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 293, 5, 0), /* pipe2 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 299, 4, 0), /* recvmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 307, 3, 0), /* sendmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 308, 2, 0), /* setns */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 321, 1, 0), /* bpf */
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+};
+
+struct sock_filter filter_pasta_mmap_sockmap[] = {
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, arch))),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 0, 80),
+	/* cppcheck-suppress [badBitmaskCheck, unmatchedSuppression] */
+	BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+		 (offsetof(struct seccomp_data, nr))),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 41, 1, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 2, 1),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 231, 3, 2),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 4, 3),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 9, 5, 4),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 50, 6, 5),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 285, 7, 6),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 10, 7),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 17, 13),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0, 24, 20),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 16, 31, 27),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 46, 38, 34),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 60, 45, 41),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 257, 52, 48),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 293, 59, 55),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 64, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 63, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 62, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 61, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 60, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 59, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 58, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 57, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 56, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 55, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 54, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 53, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 52, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 51, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 50, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 49, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 48, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 47, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 46, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 45, 0), /* read */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 1, 44, 0), /* write */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 3, 43, 0), /* close */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 8, 42, 0), /* lseek */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 9, 41, 0), /* mmap */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 11, 40, 0), /* munmap */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 14, 39, 0), /* rt_sigprocmask */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 15, 38, 0), /* rt_sigreturn */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 16, 37, 0), /* ioctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 18, 36, 0), /* pwrite64 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 20, 35, 0), /* writev */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 28, 34, 0), /* madvise */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 41, 33, 0), /* socket */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 42, 32, 0), /* connect */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 44, 31, 0), /* sendto */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 45, 30, 0), /* recvfrom */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 46, 29, 0), /* sendmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 47, 28, 0), /* recvmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 48, 27, 0), /* shutdown */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 49, 26, 0), /* bind */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 50, 25, 0), /* listen */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 54, 24, 0), /* setsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 55, 23, 0), /* getsockopt */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 56, 22, 0), /* clone */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 60, 21, 0), /* exit */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 72, 20, 0), /* fcntl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 77, 19, 0), /* ftruncate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 228, 18, 0), /* clock_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 231, 17, 0), /* exit_group */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 232, 16, 0), /* epoll_wait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 233, 15, 0), /* epoll_ctl */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 247, 14, 0), /* waitid */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 257, 13, 0), /* openat */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 275, 12, 0), /* splice */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 281, 11, 0), /* epoll_pwait */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 283, 10, 0), /* timerfd_create */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 285, 9, 0), /* fallocate */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 286, 8, 0), /* timerfd_settime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 287, 7, 0), /* timerfd_gettime */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 288, 6, 0), /* accept4 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 293, 5, 0), /* pipe2 */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 299, 4, 0), /* recvmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 307, 3, 0), /* sendmmsg */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 308, 2, 0), /* setns */
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 321, 1, 0), /* bpf */
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_KILL_PROCESS),
+	BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+};
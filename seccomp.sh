@@ -10,6 +10,10 @@
 #
 # seccomp.sh - Build seccomp profiles from "#syscalls[:PROFILE]" code comments
 #
+# A PROFILE named BASE_VARIANT also allows anything allowed for BASE. Profiles
+# for combinations of variants are generated too, as BASE_VARIANT1_VARIANT2...,
+# with variants in alphabetical order, allowing anything each of them allows.
+#
 # Copyright (c) 2021 Red Hat GmbH
 # Author: Stefano Brivio <sbrivio@redhat.com>
 
@@ -246,10 +250,44 @@ gen_profile() {
 	       "AUDIT_ARCH:${AUDIT_ARCH}"
 }
 
+# combine() - Print names of profiles for all combinations of variants
+# $@:	Profile names from "#syscalls:PROFILE" comments, sorted
+combine() {
+	for __b in $(for __t in "${@}"; do echo "${__t%%_*}"; done | sort -u); do
+		__variants=
+		__n=0
+		for __t in "${@}"; do
+			case ${__t} in
+			${__b}_*)
+				__variants="${__variants} ${__t#${__b}_}"
+				__n=$(( __n + 1 ))
+				;;
+			esac
+		done
+
+		for __mask in $(seq 0 $(( (1 << __n) - 1 )) ); do
+			__p="${__b}"
+			__i=0
+			for __v in ${__variants}; do
+				if [ $(( __mask & (1 << __i) )) -ne 0 ]; then
+					__p="${__p}_${__v}"
+				fi
+				__i=$(( __i + 1 ))
+			done
+			echo "${__p}"
+		done
+	done
+}
+
 printf '%s\n' "${HEADER}" > "${OUT}"
-__profiles="$(sed -n 's/[\t ]*\*[\t ]*#syscalls:\([^ ]*\).*/\1/p' ${IN} | sort -u)"
+__profiles="$(combine $(sed -n 's/[\t ]*\*[\t ]*#syscalls:\([^ ]*\).*/\1/p' ${IN} | sort -u))"
 for __p in ${__profiles}; do
-	__calls="$(sed -n 's/[\t ]*\*[\t ]*#syscalls\(:'"${__p}"'\|\)[\t ]\{1,\}\(.*\)/\2/p' ${IN})"
+	__base="${__p%%_*}"
+	__match=":${__base}"
+	for __v in $(echo "${__p#${__base}}" | tr '_' ' '); do
+		__match="${__match}\\|:${__base}_${__v}"
+	done
+	__calls="$(sed -n 's/[\t ]*\*[\t ]*#syscalls\('"${__match}"'\|\)[\t ]\{1,\}\(.*\)/\2/p' ${IN})"
 	__calls="${__calls} ${EXTRA_SYSCALLS:-}"
 	__calls="$(filter ${__calls})"
 
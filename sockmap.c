@@ -0,0 +1,253 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* PASTA - Pack A Subtle Tap Abstraction
+ *  for network namespace/tap device mode
+ *
+ * sockmap.c - Kernel forwarding of spliced connections with BPF sockmap
+ *
+ * Copyright Red Hat
+ *
+ * Instead of moving data between the two sockets of a spliced connection with
+ * a pair of splice() calls per direction, we can insert both sockets into BPF
+ * socket maps, with a stream verdict program redirecting anything received
+ * on one socket to the output queue of the other one.
+ *
+ * We use two maps: the peer map, with no program attached, maps the cookie
+ * of each socket to its peer socket, and the redirect map, with the verdict
+ * program attached, holds the sockets we forward data from. Sockets are added
+ * to the redirect map only once the peer map is complete, so that the program
+ * never runs for a socket without a known peer.
+ *
+ * Map and program are created at start-up, which needs CAP_BPF (or
+ * CAP_SYS_ADMIN) and CAP_NET_ADMIN in the initial user namespace. Updating
+ * maps later only needs their file descriptors, on Linux 6.5 and later.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+
+#include "util.h"
+#include "ip.h"
+#include "passt.h"
+#include "siphash.h"
+#include "inany.h"
+#include "flow.h"
+#include "log.h"
+#include "sockmap.h"
+
+#define SOCKMAP_INSN(code_, dst_, src_, off_, imm_)			\
+	((struct bpf_insn){ .code = (code_), .dst_reg = (dst_),		\
+			    .src_reg = (src_), .off = (off_), .imm = (imm_) })
+
+static int sockmap_peer = -1;		/* Socket cookie to peer socket */
+static int sockmap_redir = -1;		/* Sockets we redirect data from */
+
+/**
+ * sockmap_bpf() - Wrapper for bpf() syscall
+ * @cmd:	BPF command
+ * @attr:	Command attributes
+ *
+ * Return: return value of bpf(), -1 with errno set on failure
+ *
+ * bpf() is only allowed by a separate seccomp profile, used if --splice-offload
+ * is given and set up successfully, see isolate_postfork().
+ *
+ * #syscalls:pasta_sockmap bpf
+ */
+static int sockmap_bpf(int cmd, union bpf_attr *attr)
+{
+	return syscall(SYS_bpf, cmd, attr, sizeof(*attr));
+}
+
+/**
+ * sockmap_create() - Create socket hash map keyed by socket cookie
+ *
+ * Return: map file descriptor, -1 with errno set on failure
+ */
+static int sockmap_create(void)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_type = BPF_MAP_TYPE_SOCKHASH;
+	attr.key_size = sizeof(uint64_t);
+	attr.value_size = sizeof(int);
+	attr.max_entries = FLOW_MAX * SIDES;
+
+	return sockmap_bpf(BPF_MAP_CREATE, &attr);
+}
+
+/**
+ * sockmap_init() - Create maps, load and attach stream verdict program
+ *
+ * Return: 0 on success, negative error code on failure
+ */
+int sockmap_init(void)
+{
+	/* Redirect to egress of socket found in peer map by own cookie */
+	struct bpf_insn prog[] = {
+		/* r6 = skb */
+		SOCKMAP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0),
+		/* *(u64 *)(r10 - 8) = bpf_get_socket_cookie(skb) */
+		SOCKMAP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0,
+			     BPF_FUNC_get_socket_cookie),
+		SOCKMAP_INSN(BPF_STX | BPF_MEM | BPF_DW, 10, 0, -8, 0),
+		/* return bpf_sk_redirect_hash(skb, peer, r10 - 8, 0) */
+		SOCKMAP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, 1, 6, 0, 0),
+		SOCKMAP_INSN(BPF_LD | BPF_DW | BPF_IMM, 2, BPF_PSEUDO_MAP_FD, 0,
+			     0),
+		SOCKMAP_INSN(0, 0, 0, 0, 0),
+		SOCKMAP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, 3, 10, 0, 0),
+		SOCKMAP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, 3, 0, 0, -8),
+		SOCKMAP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, 4, 0, 0, 0),
+		SOCKMAP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0,
+			     BPF_FUNC_sk_redirect_hash),
+		SOCKMAP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+	};
+	union bpf_attr attr;
+	int fd, rc;
+
+	if ((sockmap_peer = sockmap_create()) < 0 ||
+	    (sockmap_redir = sockmap_create()) < 0) {
+		rc = -errno;
+		warn_perror("Can't create BPF socket maps");
+		goto fail;
+	}
+
+	prog[4].imm = sockmap_peer;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.prog_type = BPF_PROG_TYPE_SK_SKB;
+	attr.insns = (uintptr_t)prog;
+	attr.insn_cnt = ARRAY_SIZE(prog);
+	attr.license = (uintptr_t)"GPL";
+	if ((fd = sockmap_bpf(BPF_PROG_LOAD, &attr)) < 0) {
+		rc = -errno;
+		warn_perror("Can't load BPF stream verdict program");
+		goto fail;
+	}
+
+	memset(&attr, 0, sizeof(attr));
+	attr.target_fd = sockmap_redir;
+	attr.attach_bpf_fd = fd;
+	attr.attach_type = BPF_SK_SKB_STREAM_VERDICT;
+	if (sockmap_bpf(BPF_PROG_ATTACH, &attr)) {
+		rc = -errno;
+		warn_perror("Can't attach BPF stream verdict program");
+		close(fd);
+		goto fail;
+	}
+
+	/* The map holds a reference to the program */
+	close(fd);
+
+	info("Forwarding spliced connections with BPF sockmap");
+	return 0;
+
+fail:
+	if (sockmap_peer >= 0)
+		close(sockmap_peer);
+	if (sockmap_redir >= 0)
+		close(sockmap_redir);
+	sockmap_peer = sockmap_redir = -1;
+
+	return rc;
+}
+
+/**
+ * sockmap_update() - Add or remove socket map element
+ * @map:	Map file descriptor
+ * @cookie:	Socket cookie, used as key
+ * @s:		Socket to store, -1 to delete element
+ *
+ * Return: 0 on success, -1 with errno set on failure
+ */
+static int sockmap_update(int map, uint64_t cookie, int s)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.map_fd = map;
+	attr.key = (uintptr_t)&cookie;
+
+	if (s < 0)
+		return sockmap_bpf(BPF_MAP_DELETE_ELEM, &attr);
+
+	attr.value = (uintptr_t)&s;
+	attr.flags = BPF_NOEXIST;
+
+	return sockmap_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+/**
+ * sockmap_add() - Start kernel forwarding between two connected sockets
+ * @s0:		Socket for one side
+ * @s1:		Socket for the other side
+ *
+ * Return: 0 on success, negative error code if we can't forward via sockmap
+ *
+ * #syscalls:pasta getsockopt setsockopt
+ */
+int sockmap_add(int s0, int s1)
+{
+	uint64_t cookie[SIDES];
+	socklen_t sl;
+	unsigned i;
+	int rc;
+
+	if (sockmap_peer < 0)
+		return -ENOTSUP;
+
+	sl = sizeof(cookie[0]);
+	if (getsockopt(s0, SOL_SOCKET, SO_COOKIE, &cookie[0], &sl))
+		return -errno;
+
+	sl = sizeof(cookie[1]);
+	if (getsockopt(s1, SOL_SOCKET, SO_COOKIE, &cookie[1], &sl))
+		return -errno;
+
+	if (sockmap_update(sockmap_peer, cookie[0], s1))
+		return -errno;
+
+	if (sockmap_update(sockmap_peer, cookie[1], s0)) {
+		rc = -errno;
+		goto del_peer0;
+	}
+
+	if (sockmap_update(sockmap_redir, cookie[0], s0)) {
+		rc = -errno;
+		goto del_peer1;
+	}
+
+	if (sockmap_update(sockmap_redir, cookie[1], s1)) {
+		rc = -errno;
+		goto del_redir0;
+	}
+
+	/* Data queued before we added the sockets is only redirected on the
+	 * next data_ready callback: updating SO_RCVLOWAT triggers one.
+	 */
+	for (i = 0; i < SIDES; i++) {
+		if (setsockopt(i ? s1 : s0, SOL_SOCKET, SO_RCVLOWAT,
+			       &((int){ 1 }), sizeof(int)))
+			debug_perror("Can't set SO_RCVLOWAT on sockmap socket");
+	}
+
+	return 0;
+
+del_redir0:
+	sockmap_update(sockmap_redir, cookie[0], -1);
+del_peer1:
+	sockmap_update(sockmap_peer, cookie[1], -1);
+del_peer0:
+	sockmap_update(sockmap_peer, cookie[0], -1);
+	return rc;
+}
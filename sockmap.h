@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Kernel forwarding of spliced connections with BPF sockmap
+ */
+
+#ifndef SOCKMAP_H
+#define SOCKMAP_H
+
+int sockmap_init(void);
+int sockmap_add(int s0, int s1);
+
+#endif /* SOCKMAP_H */
@@ -0,0 +1,653 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* PASST - Plug A Simple Socket Transport
+ *  for qemu/UNIX domain socket mode
+ *
+ * PASTA - Pack A Subtle Tap Abstraction
+ *  for network namespace/tap device mode
+ *
+ * stats.c - Runtime counters, in OpenMetrics format, on socket or to a file
+ *
+ * Copyright Red Hat
+ *
+ * Counters are plain global variables, as we're single-threaded: updating them
+ * costs an increment on the data path, and anything more expensive, such as
+ * scanning the flow table, is done when they're requested.
+ *
+ * Clients connect to the socket given by --stats-socket, and we reply with all
+ * the counters, in OpenMetrics text format, then close the connection, for
+ * example:
+ *
+ *   socat -u UNIX-CONNECT:/tmp/passt.stats -
+ *
+ * With --stats-file, we write the same contents to the given file, replacing
+ * them, whenever we receive SIGUSR2.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "util.h"
+#include "ip.h"
+#include "passt.h"
+#include "log.h"
+#include "tap.h"
+#include "flow_table.h"
+#include "stats.h"
+
+/* Fixed part, plus latency histograms with all buckets populated: each bucket,
+ * then +Inf, count and sum lines, of at most STATS_LAT_LINE bytes each
+ */
+#define STATS_LAT_LINE		128
+#define STATS_LAT_HISTS		(STATS_DIR_NUM * STATS_PROTO_NUM + PIF_NUM_TYPES)
+#define STATS_BUF_SIZE							\
+	(65536 + STATS_LAT_HISTS * (STATS_LAT_BUCKETS + 3) * STATS_LAT_LINE)
+#define STATS_BACKLOG		8	/* Concurrent scrapers waiting */
+
+struct stats stats;
+
+static int stats_fd = -1;		/* Listening socket */
+static int stats_client = -1;		/* Client we're still sending to */
+static char stats_client_buf[STATS_BUF_SIZE];	/* Snapshot for client */
+static size_t stats_client_len;		/* Length of snapshot */
+static size_t stats_client_off;		/* Bytes of snapshot sent already */
+static int stats_file_fd = -1;		/* File we dump counters to */
+static volatile sig_atomic_t stats_file_pending;
+static bool stats_clock;		/* Read clock for timing statistics */
+static struct timespec stats_wakeup;	/* Start of current wakeup */
+static struct timespec stats_conn_ts;	/* Start of new connection handling */
+
+static const char *stats_dir_str[] = {
+	[STATS_TO_TAP]		= "tap",
+	[STATS_TO_SOCK]		= "socket",
+};
+static_assert(ARRAY_SIZE(stats_dir_str) == STATS_DIR_NUM,
+	      "stats_dir_str[] doesn't match enum stats_dir");
+
+static const char *stats_proto_str[] = {
+	[STATS_TCP]		= "tcp",
+	[STATS_UDP]		= "udp",
+	[STATS_ICMP]		= "icmp",
+};
+static_assert(ARRAY_SIZE(stats_proto_str) == STATS_PROTO_NUM,
+	      "stats_proto_str[] doesn't match enum stats_proto");
+
+static const char *stats_flow_str[] = {
+	[FLOW_TYPE_NONE]	= "none",
+	[FLOW_TCP]		= "tcp",
+	[FLOW_TCP_SPLICE]	= "tcp_splice",
+	[FLOW_PING4]		= "ping4",
+	[FLOW_PING6]		= "ping6",
+	[FLOW_UDP]		= "udp",
+};
+static_assert(ARRAY_SIZE(stats_flow_str) == FLOW_NUM_TYPES,
+	      "stats_flow_str[] doesn't match enum flow_type");
+
+/**
+ * stats_printf() - Append formatted text to buffer, if it fits
+ * @buf:	Buffer, STATS_BUF_SIZE bytes
+ * @off:	Current offset in buffer, updated on return
+ * @fmt:	Format string
+ */
+static void __attribute__ ((format(printf, 3, 4)))
+stats_printf(char *buf, size_t *off, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(buf + *off, STATS_BUF_SIZE - *off, fmt, ap);
+	va_end(ap);
+
+	if (n > 0 && (size_t)n < STATS_BUF_SIZE - *off)
+		*off += n;
+}
+
+/**
+ * stats_family() - Append metadata for metric family
+ * @buf:	Buffer, STATS_BUF_SIZE bytes
+ * @off:	Current offset in buffer, updated on return
+ * @name:	Name of metric family, without prefix
+ * @type:	OpenMetrics type, "counter", "gauge" or "histogram"
+ * @unit:	Unit, also suffix of @name, NULL if none
+ * @help:	Description
+ */
+static void stats_family(char *buf, size_t *off, const char *name,
+			 const char *type, const char *unit, const char *help)
+{
+	stats_printf(buf, off, "# TYPE passt_%s %s\n", name, type);
+	if (unit)
+		stats_printf(buf, off, "# UNIT passt_%s %s\n", name, unit);
+	stats_printf(buf, off, "# HELP passt_%s %s\n", name, help);
+}
+
+/**
+ * stats_counter() - Append metric family with a single counter
+ * @buf:	Buffer, STATS_BUF_SIZE bytes
+ * @off:	Current offset in buffer, updated on return
+ * @name:	Name of metric family, without prefix and _total suffix
+ * @unit:	Unit, also suffix of @name, NULL if none
+ * @help:	Description
+ * @v:		Value
+ */
+static void stats_counter(char *buf, size_t *off, const char *name,
+			  const char *unit, const char *help, uint64_t v)
+{
+	stats_family(buf, off, name, "counter", unit, help);
+	stats_printf(buf, off, "passt_%s_total %" PRIu64 "\n", name, v);
+}
+
+/**
+ * stats_histogram() - Append metric family with a histogram
+ * @buf:	Buffer, STATS_BUF_SIZE bytes
+ * @off:	Current offset in buffer, updated on return
+ * @name:	Name of metric family, without prefix
+ * @unit:	Unit, also suffix of @name, NULL if none
+ * @help:	Description
+ * @h:		Histogram
+ */
+static void stats_histogram(char *buf, size_t *off, const char *name,
+			    const char *unit, const char *help,
+			    const struct stats_hist *h)
+{
+	uint64_t count = 0;
+	unsigned b;
+
+	stats_family(buf, off, name, "histogram", unit, help);
+
+	/* OpenMetrics buckets are cumulative, with inclusive upper bounds */
+	for (b = 0; b < STATS_HIST_BUCKETS - 1; b++) {
+		count += h->bucket[b];
+		stats_printf(buf, off,
+			     "passt_%s_bucket{le=\"%lu\"} %" PRIu64 "\n",
+			     name, (1UL << (b + 1)) - 1, count);
+	}
+	count += h->bucket[b];
+
+	stats_printf(buf, off, "passt_%s_bucket{le=\"+Inf\"} %" PRIu64 "\n",
+		     name, count);
+	stats_printf(buf, off, "passt_%s_count %" PRIu64 "\n", name, count);
+	stats_printf(buf, off, "passt_%s_sum %" PRIu64 "\n", name, h->sum);
+}
+
+/**
+ * stats_lat_upper() - Inclusive upper bound of latency histogram bucket
+ * @i:		Index of bucket
+ *
+ * Return: upper bound, nanoseconds
+ */
+static uint64_t stats_lat_upper(unsigned i)
+{
+	unsigned k = i / STATS_LAT_SUB, sub = i % STATS_LAT_SUB;
+
+	if (!k)
+		return i;
+
+	return ((uint64_t)(STATS_LAT_SUB + sub + 1) << (k - 1)) - 1;
+}
+
+/**
+ * stats_lat_print() - Append one latency histogram, non-empty buckets only
+ * @buf:	Buffer, STATS_BUF_SIZE bytes
+ * @off:	Current offset in buffer, updated on return
+ * @name:	Name of metric family, without prefix
+ * @labels:	Labels for this histogram, comma-separated
+ * @h:		Histogram
+ */
+static void stats_lat_print(char *buf, size_t *off, const char *name,
+			    const char *labels, const struct stats_lat *h)
+{
+	uint64_t count = 0, le;
+	unsigned i;
+
+	for (i = 0; i < STATS_LAT_BUCKETS - 1; i++) {
+		if (!h->bucket[i])
+			continue;
+
+		count += h->bucket[i];
+		le = stats_lat_upper(i);
+		stats_printf(buf, off,
+			     "passt_%s_bucket{%s,le=\"%" PRIu64 ".%09" PRIu64 "\"}"
+			     " %" PRIu64 "\n", name, labels,
+			     le / 1000000000, le % 1000000000, count);
+	}
+	count += h->bucket[i];
+
+	stats_printf(buf, off, "passt_%s_bucket{%s,le=\"+Inf\"} %" PRIu64 "\n",
+		     name, labels, count);
+	stats_printf(buf, off, "passt_%s_count{%s} %" PRIu64 "\n",
+		     name, labels, count);
+	stats_printf(buf, off,
+		     "passt_%s_sum{%s} %" PRIu64 ".%09" PRIu64 "\n",
+		     name, labels, h->sum / 1000000000, h->sum % 1000000000);
+}
+
+/**
+ * stats_latency_print() - Append latency histograms
+ * @buf:	Buffer, STATS_BUF_SIZE bytes
+ * @off:	Current offset in buffer, updated on return
+ */
+static void stats_latency_print(char *buf, size_t *off)
+{
+	enum stats_proto proto;
+	enum stats_dir dir;
+	char labels[BUFSIZ];
+	uint8_t pif;
+
+	stats_family(buf, off, "latency_seconds", "histogram", "seconds",
+		     "Time from wakeup to frame or data leaving in the same "
+		     "wakeup, by target");
+
+	for (dir = 0; dir < STATS_DIR_NUM; dir++) {
+		for (proto = 0; proto < STATS_PROTO_NUM; proto++) {
+			snprintf(labels, sizeof(labels),
+				 "to=\"%s\",proto=\"%s\"",
+				 stats_dir_str[dir], stats_proto_str[proto]);
+			stats_lat_print(buf, off, "latency_seconds", labels,
+					&stats.lat[dir][proto]);
+		}
+	}
+
+	stats_family(buf, off, "tcp_conn_seconds", "histogram", "seconds",
+		     "Time spent on new TCP connections, by initiating side");
+
+	for (pif = PIF_NONE + 1; pif < PIF_NUM_TYPES; pif++) {
+		snprintf(labels, sizeof(labels), "pif=\"%s\"", pif_name(pif));
+		stats_lat_print(buf, off, "tcp_conn_seconds", labels,
+				&stats.conn[pif]);
+	}
+}
+
+/**
+ * stats_print() - Format all counters in OpenMetrics text format
+ * @buf:	Buffer, STATS_BUF_SIZE bytes
+ *
+ * Return: length of formatted output
+ */
+static size_t stats_print(char *buf)
+{
+	unsigned flows[FLOW_NUM_TYPES][FLOW_NUM_STATES] = { 0 };
+	unsigned flowi, t, s, clusters = 0, cluster_max = 0;
+	enum stats_proto proto;
+	size_t off = 0;
+	uint8_t pif;
+
+	stats_family(buf, &off, "received_packets", "counter", NULL,
+		     "Packets, segments or datagrams received from interface");
+	for (pif = PIF_NONE + 1; pif < PIF_NUM_TYPES; pif++) {
+		for (proto = 0; proto < STATS_PROTO_NUM; proto++) {
+			stats_printf(buf, &off,
+				     "passt_received_packets_total"
+				     "{pif=\"%s\",proto=\"%s\"} %" PRIu64 "\n",
+				     pif_name(pif), stats_proto_str[proto],
+				     stats.in[pif][proto].packets);
+		}
+	}
+
+	stats_family(buf, &off, "received_bytes", "counter", "bytes",
+		     "Bytes received from interface");
+	for (pif = PIF_NONE + 1; pif < PIF_NUM_TYPES; pif++) {
+		for (proto = 0; proto < STATS_PROTO_NUM; proto++) {
+			stats_printf(buf, &off,
+				     "passt_received_bytes_total"
+				     "{pif=\"%s\",proto=\"%s\"} %" PRIu64 "\n",
+				     pif_name(pif), stats_proto_str[proto],
+				     stats.in[pif][proto].bytes);
+		}
+	}
+
+	for (flowi = 0; flowi < FLOW_MAX; flowi++) {
+		const struct flow_common *f = &flowtab[flowi].f;
+
+		flows[f->type][f->state]++;
+	}
+
+	stats_family(buf, &off, "flows", "gauge", NULL,
+		     "Entries in flow table, by flow type and state");
+	for (t = 0; t < FLOW_NUM_TYPES; t++) {
+		for (s = 0; s < FLOW_NUM_STATES; s++) {
+			if (s == FLOW_STATE_FREE)
+				continue;
+
+			stats_printf(buf, &off,
+				     "passt_flows{type=\"%s\",state=\"%s\"} %u\n",
+				     stats_flow_str[t], flow_state_str[s],
+				     flows[t][s]);
+		}
+	}
+
+	stats_family(buf, &off, "flows_max", "gauge", NULL,
+		     "Size of flow table");
+	stats_printf(buf, &off, "passt_flows_max %u\n", FLOW_MAX);
+
+	/* Free clusters are merged only by flow_defer_handler(): their number
+	 * and size tell how fragmented the table is after connection churn
+	 */
+	for (flowi = flow_first_free; flowi < FLOW_MAX;
+	     flowi = flowtab[flowi].free.next) {
+		clusters++;
+		cluster_max = MAX(cluster_max, flowtab[flowi].free.n);
+	}
+
+	stats_family(buf, &off, "flow_free_clusters", "gauge", NULL,
+		     "Clusters of free entries in flow table");
+	stats_printf(buf, &off, "passt_flow_free_clusters %u\n", clusters);
+	stats_family(buf, &off, "flow_free_cluster_max", "gauge", NULL,
+		     "Entries in largest cluster of free entries");
+	stats_printf(buf, &off, "passt_flow_free_cluster_max %u\n",
+		     cluster_max);
+
+	stats_histogram(buf, &off, "flow_hash_probes", NULL,
+			"Buckets probed for each flow hash table lookup",
+			&stats.probe);
+	stats_histogram(buf, &off, "tap_batch_frames", NULL,
+			"Frames in each batch sent to tap",
+			&stats.batch);
+	stats_histogram(buf, &off, "wakeup_microseconds", "microseconds",
+			"Time spent handling events for each wakeup",
+			&stats.loop_us);
+	stats_latency_print(buf, &off);
+
+	stats_counter(buf, &off, "tap_short_writes", NULL,
+		      "Short writes or sends to tap", stats.tap_short);
+	stats_counter(buf, &off, "tap_dropped_frames", NULL,
+		      "Frames we failed to send to tap", stats.tap_dropped);
+	stats_counter(buf, &off, "splice_bytes", "bytes",
+		      "Bytes forwarded between spliced sockets",
+		      stats.splice_bytes);
+	stats_counter(buf, &off, "tcp_retransmits", NULL,
+		      "TCP retransmissions to tap on timeout",
+		      stats.tcp_retrans);
+	stats_counter(buf, &off, "udp_no_flow_drops", NULL,
+		      "UDP datagrams dropped without a matching or new flow",
+		      stats.udp_no_flow);
+	stats_counter(buf, &off, "pcap_dropped_frames", NULL,
+		      "Frames not captured as the capture ring was full",
+		      stats.pcap_dropped);
+
+	stats_printf(buf, &off, "# EOF\n");
+
+	return off;
+}
+
+/**
+ * stats_sigusr2() - Signal handler for SIGUSR2: request dump to file
+ * @signal:	Unused, handler deals with SIGUSR2 only
+ *
+ * #syscalls rt_sigreturn|sigreturn
+ * #syscalls arm:sigreturn ppc64:sigreturn s390x:sigreturn i686:sigreturn
+ */
+static void stats_sigusr2(int signal)
+{
+	(void)signal;
+
+	stats_file_pending = 1;
+}
+
+/**
+ * stats_init() - Set up control socket and output file, if configured
+ * @c:		Execution context
+ */
+void stats_init(struct ctx *c)
+{
+	union epoll_ref ref = { .type = EPOLL_TYPE_STATS };
+	struct epoll_event ev = { 0 };
+
+	if (*c->stats_file) {
+		struct sigaction sa = { .sa_handler = stats_sigusr2 };
+
+		stats_file_fd = output_file_open(c->stats_file, O_WRONLY);
+		if (stats_file_fd < 0)
+			die_perror("Couldn't open statistics file %s",
+				   c->stats_file);
+
+		sigemptyset(&sa.sa_mask);
+		if (sigaction(SIGUSR2, &sa, NULL))
+			die_perror("Couldn't install handler for SIGUSR2");
+
+		info("Writing statistics to %s on SIGUSR2", c->stats_file);
+		stats_clock = true;
+	}
+
+	if (!*c->stats_path)
+		return;
+
+	stats_fd = tap_sock_unix_open(c->stats_path);
+	if (listen(stats_fd, STATS_BACKLOG))
+		die_perror("Failed to listen on statistics socket");
+
+	ref.fd = stats_fd;
+	ev.events = EPOLLIN;
+	ev.data.u64 = ref.u64;
+	if (epoll_ctl(c->epollfd, EPOLL_CTL_ADD, stats_fd, &ev))
+		die_perror("Failed to add statistics socket to epoll");
+
+	info("Statistics available on socket %s", c->stats_path);
+	stats_clock = true;
+}
+
+/**
+ * stats_client_send() - Send what's left of snapshot to client
+ *
+ * Return: 1 if we need to send more, 0 if done, -1 on error
+ */
+static int stats_client_send(void)
+{
+	ssize_t n;
+
+	/* Clients might go away at any time: no SIGPIPE for passt */
+	n = send(stats_client, stats_client_buf + stats_client_off,
+		 stats_client_len - stats_client_off, MSG_NOSIGNAL);
+	if (n < 0) {
+		if (errno == EAGAIN)
+			return 1;
+
+		debug_perror("Failed to send statistics");
+		return -1;
+	}
+
+	stats_client_off += n;
+	return stats_client_off < stats_client_len;
+}
+
+/**
+ * stats_handler() - Handle connection on control socket: send counters
+ * @c:		Execution context
+ * @events:	epoll events
+ *
+ * A full snapshot doesn't necessarily fit the socket buffer: if the client
+ * doesn't take it all at once, keep sending on EPOLLOUT, and stop accepting
+ * connections meanwhile, so that we keep a single snapshot around. Further
+ * clients wait in the backlog.
+ *
+ * #syscalls accept4|accept sendto|send close
+ */
+void stats_handler(const struct ctx *c, uint32_t events)
+{
+	union epoll_ref ref = { .type = EPOLL_TYPE_STATS_CLIENT };
+	struct epoll_event ev = { 0 };
+
+	/* Statistics aren't worth disrupting forwarding for */
+	if (!(events & EPOLLIN)) {
+		err("Error on statistics socket, disabling statistics");
+		epoll_ctl(c->epollfd, EPOLL_CTL_DEL, stats_fd, NULL);
+		close(stats_fd);
+		stats_fd = -1;
+		return;
+	}
+
+	if ((stats_client = accept4(stats_fd, NULL, NULL, SOCK_NONBLOCK)) < 0) {
+		debug_perror("Failed to accept statistics connection");
+		return;
+	}
+
+	stats_client_len = stats_print(stats_client_buf);
+	stats_client_off = 0;
+
+	if (stats_client_send() <= 0)
+		goto close;
+
+	ref.fd = stats_client;
+	ev.events = EPOLLOUT;
+	ev.data.u64 = ref.u64;
+	if (epoll_ctl(c->epollfd, EPOLL_CTL_ADD, stats_client, &ev)) {
+		debug_perror("Failed to add statistics client to epoll");
+		goto close;
+	}
+
+	ev.events = 0;
+	if (epoll_ctl(c->epollfd, EPOLL_CTL_MOD, stats_fd, &ev))
+		debug_perror("Failed to pause accepting statistics clients");
+
+	return;
+
+close:
+	close(stats_client);
+	stats_client = -1;
+}
+
+/**
+ * stats_client_handler() - Send more counters as client socket has room
+ * @c:		Execution context
+ * @events:	epoll events
+ */
+void stats_client_handler(const struct ctx *c, uint32_t events)
+{
+	union epoll_ref ref = { .type = EPOLL_TYPE_STATS, .fd = stats_fd };
+	struct epoll_event ev = { .events = EPOLLIN, .data.u64 = ref.u64 };
+
+	/* On EPOLLERR or EPOLLHUP, write() fails and we close the connection */
+	(void)events;
+
+	if (stats_client_send() > 0)
+		return;
+
+	epoll_ctl(c->epollfd, EPOLL_CTL_DEL, stats_client, NULL);
+	close(stats_client);
+	stats_client = -1;
+
+	/* Done with this one, serve the next client */
+	if (epoll_ctl(c->epollfd, EPOLL_CTL_MOD, stats_fd, &ev))
+		debug_perror("Failed to resume accepting statistics clients");
+}
+
+/**
+ * stats_loop_start() - Note timestamp of wakeup, as entry time for frames
+ * @now:	Timestamp taken on wakeup
+ */
+void stats_loop_start(const struct timespec *now)
+{
+	stats_wakeup = *now;
+}
+
+/**
+ * stats_loop_done() - Account for time spent handling events after wakeup
+ */
+void stats_loop_done(void)
+{
+	struct timespec now;
+
+	if (!stats_clock || clock_gettime(CLOCK_MONOTONIC, &now))
+		return;
+
+	stats_hist_add(&stats.loop_us, timespec_diff_us(&now, &stats_wakeup));
+}
+
+/**
+ * stats_latency() - Account for frames or messages leaving, since wakeup
+ * @dir:	Where they're going: tap or socket
+ * @proto:	Protocol
+ * @n:		Number of frames or messages, all sent at the same time
+ *
+ * This measures handling time within the current wakeup only: entry time is
+ * the one of the wakeup, passed around as @now to handlers, so that we only
+ * need to read the clock once for each batch. Data we leave in socket buffers,
+ * because of rate limits or per-flow budgets, is only read, and accounted, in
+ * a later wakeup. Data from tap queued out of order is accounted for with the
+ * wakeup where it's finally written to the socket, so the time it spent in the
+ * queue isn't included.
+ */
+void stats_latency(enum stats_dir dir, enum stats_proto proto, size_t n)
+{
+	struct stats_lat *h = &stats.lat[dir][proto];
+	struct timespec now;
+	int64_t ns;
+
+	if (!stats_clock || !n || clock_gettime(CLOCK_MONOTONIC, &now))
+		return;
+
+	ns = (now.tv_sec - stats_wakeup.tv_sec) * 1000000000LL +
+	     now.tv_nsec - stats_wakeup.tv_nsec;
+	if (ns < 0)
+		ns = 0;
+
+	h->bucket[stats_lat_idx(ns)] += n;
+	h->sum += ns * n;
+}
+
+/**
+ * stats_conn_start() - Note timestamp before handling new TCP connection
+ */
+void stats_conn_start(void)
+{
+	if (stats_clock && clock_gettime(CLOCK_MONOTONIC, &stats_conn_ts))
+		stats_conn_ts.tv_sec = 0;
+}
+
+/**
+ * stats_conn_done() - Account for time spent handling new TCP connection
+ * @pif:	Interface the connection was initiated from
+ *
+ * This covers flow allocation, socket setup and first segments or connect(),
+ * whether or not the connection could be set up, as the cost is paid anyway.
+ */
+void stats_conn_done(uint8_t pif)
+{
+	struct stats_lat *h = &stats.conn[pif];
+	struct timespec now;
+	int64_t ns;
+
+	if (!stats_clock || !stats_conn_ts.tv_sec ||
+	    clock_gettime(CLOCK_MONOTONIC, &now))
+		return;
+
+	ns = (now.tv_sec - stats_conn_ts.tv_sec) * 1000000000LL +
+	     now.tv_nsec - stats_conn_ts.tv_nsec;
+	if (ns < 0)
+		ns = 0;
+
+	h->bucket[stats_lat_idx(ns)]++;
+	h->sum += ns;
+}
+
+/**
+ * stats_file_handler() - Write counters to file, if requested via SIGUSR2
+ *
+ * #syscalls ftruncate pwrite64
+ */
+void stats_file_handler(void)
+{
+	static char buf[STATS_BUF_SIZE];
+	size_t len;
+
+	if (!stats_file_pending)
+		return;
+
+	stats_file_pending = 0;
+
+	len = stats_print(buf);
+	if (ftruncate(stats_file_fd, 0) ||
+	    pwrite(stats_file_fd, buf, len, 0) < (ssize_t)len)
+		warn_perror("Couldn't write statistics file");
+}
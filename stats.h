@@ -0,0 +1,163 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Runtime counters, in OpenMetrics format, on a UNIX domain socket or to a file
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+/**
+ * enum stats_proto - Protocols with separate traffic counters
+ */
+enum stats_proto {
+	STATS_TCP,
+	STATS_UDP,
+	STATS_ICMP,
+
+	STATS_PROTO_NUM,
+};
+
+/**
+ * enum stats_dir - Directions for latency histograms
+ */
+enum stats_dir {
+	STATS_TO_TAP,
+	STATS_TO_SOCK,
+
+	STATS_DIR_NUM,
+};
+
+#define STATS_HIST_BUCKETS	16	/* Powers of two: 0-1, 2-3, ..., 2^15+ */
+
+/* Log-linear latency buckets, in ns: STATS_LAT_SUB linear sub-buckets for each
+ * power of two, so that relative error is at most 1 / STATS_LAT_SUB, up to
+ * 2^STATS_LAT_BITS ns (about one second), values above that in the last one
+ */
+#define STATS_LAT_SUB_BITS	3
+#define STATS_LAT_SUB		(1 << STATS_LAT_SUB_BITS)
+#define STATS_LAT_BITS		30
+#define STATS_LAT_BUCKETS						\
+	((STATS_LAT_BITS - STATS_LAT_SUB_BITS + 1) * STATS_LAT_SUB)
+
+/**
+ * struct stats_traffic - Packet and byte counters
+ * @packets:	Packets, segments or datagrams
+ * @bytes:	Bytes, layer 4 headers included for packets from tap
+ */
+struct stats_traffic {
+	uint64_t packets;
+	uint64_t bytes;
+};
+
+/**
+ * struct stats_hist - Histogram with power-of-two buckets
+ * @bucket:	Count of values from 2^i to 2^(i + 1) - 1, last one unbounded
+ * @sum:	Sum of all values
+ */
+struct stats_hist {
+	uint64_t bucket[STATS_HIST_BUCKETS];
+	uint64_t sum;
+};
+
+/**
+ * struct stats_lat - Log-linear latency histogram
+ * @bucket:	Counts of frames, see stats_lat_idx() for bounds
+ * @sum:	Sum of latencies of all frames, ns
+ */
+struct stats_lat {
+	uint64_t bucket[STATS_LAT_BUCKETS];
+	uint64_t sum;
+};
+
+/**
+ * struct stats - Runtime counters, only ever incremented on the data path
+ * @in:			Traffic received from each pif, by protocol
+ * @lat:		Time from wakeup to frames leaving, by direction and protocol
+ * @probe:		Hash table probe lengths
+ * @batch:		Sizes of batches of frames sent to tap
+ * @loop_us:		Time spent handling events for each wakeup, us
+ * @conn:		Time spent on new TCP connections, by initiating pif
+ * @tap_short:		Short writes or sends to tap
+ * @tap_dropped:	Frames we failed to send to tap
+ * @splice_bytes:	Bytes forwarded between spliced sockets
+ * @tcp_retrans:	TCP retransmissions on timeout, from tcp_timer_handler()
+ * @udp_no_flow:	UDP datagrams dropped as we couldn't find or create a flow
+ * @pcap_dropped:	Frames not captured as the capture ring was full
+ */
+struct stats {
+	struct stats_traffic in[PIF_NUM_TYPES][STATS_PROTO_NUM];
+	struct stats_lat lat[STATS_DIR_NUM][STATS_PROTO_NUM];
+	struct stats_hist probe;
+	struct stats_hist batch;
+	struct stats_hist loop_us;
+	struct stats_lat conn[PIF_NUM_TYPES];
+	uint64_t tap_short;
+	uint64_t tap_dropped;
+	uint64_t splice_bytes;
+	uint64_t tcp_retrans;
+	uint64_t udp_no_flow;
+	uint64_t pcap_dropped;
+};
+
+extern struct stats stats;
+
+/**
+ * stats_in() - Account for traffic received from a pif
+ * @pif:	Interface we received from
+ * @proto:	Protocol, enum stats_proto
+ * @packets:	Number of packets, segments or datagrams
+ * @bytes:	Number of bytes
+ */
+static inline void stats_in(uint8_t pif, enum stats_proto proto,
+			    size_t packets, size_t bytes)
+{
+	stats.in[pif][proto].packets += packets;
+	stats.in[pif][proto].bytes += bytes;
+}
+
+/**
+ * stats_hist_add() - Account for value in histogram
+ * @h:		Histogram
+ * @n:		Value
+ */
+static inline void stats_hist_add(struct stats_hist *h, unsigned long n)
+{
+	unsigned b = n ? sizeof(n) * 8 - 1 - __builtin_clzl(n) : 0;
+
+	h->bucket[MIN(b, STATS_HIST_BUCKETS - 1)]++;
+	h->sum += n;
+}
+
+/**
+ * stats_lat_idx() - Find bucket of latency histogram for given value
+ * @ns:		Latency, nanoseconds
+ *
+ * Return: index of bucket
+ */
+static inline unsigned stats_lat_idx(uint64_t ns)
+{
+	unsigned e, i;
+
+	if (ns < STATS_LAT_SUB)
+		return ns;
+
+	/* Magnitude selects group of sub-buckets, top bits select one */
+	e = sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(ns);
+	i = (e - STATS_LAT_SUB_BITS + 1) * STATS_LAT_SUB +
+	    (ns >> (e - STATS_LAT_SUB_BITS)) - STATS_LAT_SUB;
+
+	return MIN(i, STATS_LAT_BUCKETS - 1);
+}
+
+void stats_init(struct ctx *c);
+void stats_handler(const struct ctx *c, uint32_t events);
+void stats_client_handler(const struct ctx *c, uint32_t events);
+void stats_loop_start(const struct timespec *now);
+void stats_loop_done(void);
+void stats_latency(enum stats_dir dir, enum stats_proto proto, size_t n);
+void stats_conn_start(void);
+void stats_conn_done(uint8_t pif);
+void stats_file_handler(void);
+
+#endif /* STATS_H */
@@ -58,6 +58,9 @@
 #include "packet.h"
 #include "tap.h"
 #include "log.h"
+#include "zerocopy.h"
+#include "stats.h"
+#include "usdt.h"
 
 /* IPv4 (plus ARP) and IPv6 message batches from tap/guest to IP handlers */
 static PACKET_POOL_NOINIT(pool_tap4, TAP_MSGS, pkt_buf);
@@ -339,6 +342,7 @@ static size_t tap_send_frames_pasta(const struct ctx *c,
 			}
 		} else if ((size_t)rc < framelen) {
 			debug("short write on tuntap: %zd/%zu", rc, framelen);
+			stats.tap_short++;
 			break;
 		}
 	}
@@ -384,6 +388,7 @@ static size_t tap_send_frames_passt(const struct ctx *c,
 		/* Number of unsent or partially sent buffers for the frame */
 		size_t rembufs = bufs_per_frame - (i % bufs_per_frame);
 
+		stats.tap_short++;
 		if (write_remainder(c->fd_tap, &iov[i], rembufs, buf_offset) < 0) {
 			err_perror("tap: partial frame send");
 			return i;
@@ -419,11 +424,16 @@ size_t tap_send_frames(const struct ctx *c, const struct iovec *iov,
 	else
 		m = tap_send_frames_passt(c, iov, bufs_per_frame, nframes);
 
-	if (m < nframes)
-		debug("tap: failed to send %zu frames of %zu",
-		      nframes - m, nframes);
+	USDT2(tap_flush, nframes, m);
+	stats_hist_add(&stats.batch, nframes);
+	if (m < nframes) {
+		debug_ratelimit("tap: failed to send %zu frames of %zu",
+				nframes - m, nframes);
+		stats.tap_dropped += nframes - m;
+		USDT1(tap_drop, nframes - m);
+	}
 
-	pcap_multiple(iov, bufs_per_frame, m,
+	pcap_multiple(iov, bufs_per_frame, nframes, m,
 		      c->mode == MODE_PASST ? sizeof(uint32_t) : 0);
 
 	return m;
@@ -508,6 +518,9 @@ static void tap_packet_debug(const struct iphdr *iph,
 	char buf4s[INET_ADDRSTRLEN], buf4d[INET_ADDRSTRLEN];
 	uint8_t proto = 0;
 
+	if (!log_trace)
+		return;
+
 	if (iph || seq4) {
 		if (iph) {
 			inet_ntop(AF_INET, &iph->saddr, buf4s, sizeof(buf4s));
@@ -626,9 +639,11 @@ resume:
 		    IN4_IS_ADDR_LOOPBACK(&iph->daddr)) {
 			char sstr[INET_ADDRSTRLEN], dstr[INET_ADDRSTRLEN];
 
-			debug("Loopback address on tap interface: %s -> %s",
-			      inet_ntop(AF_INET, &iph->saddr, sstr, sizeof(sstr)),
-			      inet_ntop(AF_INET, &iph->daddr, dstr, sizeof(dstr)));
+			debug_ratelimit("Loopback address on tap interface: %s -> %s",
+					inet_ntop(AF_INET, &iph->saddr,
+						  sstr, sizeof(sstr)),
+					inet_ntop(AF_INET, &iph->daddr,
+						  dstr, sizeof(dstr)));
 			continue;
 		}
 
@@ -648,6 +663,7 @@ resume:
 			tap_packet_debug(iph, NULL, NULL, 0, NULL, 1);
 
 			packet_add(pkt, l4len, l4h);
+			stats_in(PIF_TAP, STATS_ICMP, 1, l4len);
 			icmp_tap_handler(c, PIF_TAP, AF_INET,
 					 &iph->saddr, &iph->daddr,
 					 pkt, now);
@@ -711,6 +727,8 @@ resume:
 
 append:
 		packet_add((struct pool *)&seq->p, l4len, l4h);
+		stats_in(PIF_TAP, iph->protocol == IPPROTO_TCP ?
+				  STATS_TCP : STATS_UDP, 1, l4len);
 	}
 
 	for (j = 0, seq = tap4_l4; j < seq_count; j++, seq++) {
@@ -791,9 +809,11 @@ resume:
 		if (IN6_IS_ADDR_LOOPBACK(saddr) || IN6_IS_ADDR_LOOPBACK(daddr)) {
 			char sstr[INET6_ADDRSTRLEN], dstr[INET6_ADDRSTRLEN];
 
-			debug("Loopback address on tap interface: %s -> %s",
-			      inet_ntop(AF_INET6, saddr, sstr, sizeof(sstr)),
-			      inet_ntop(AF_INET6, daddr, dstr, sizeof(dstr)));
+			debug_ratelimit("Loopback address on tap interface: %s -> %s",
+					inet_ntop(AF_INET6, saddr,
+						  sstr, sizeof(sstr)),
+					inet_ntop(AF_INET6, daddr,
+						  dstr, sizeof(dstr)));
 			continue;
 		}
 
@@ -823,6 +843,7 @@ resume:
 
 			tap_packet_debug(NULL, ip6h, NULL, proto, NULL, 1);
 
+			stats_in(PIF_TAP, STATS_ICMP, 1, l4len);
 			icmp_tap_handler(c, PIF_TAP, AF_INET6,
 					 saddr, daddr, pkt, now);
 			continue;
@@ -888,6 +909,8 @@ resume:
 
 append:
 		packet_add((struct pool *)&seq->p, l4len, l4h);
+		stats_in(PIF_TAP, proto == IPPROTO_TCP ? STATS_TCP : STATS_UDP,
+			 1, l4len);
 	}
 
 	for (j = 0, seq = tap6_l4; j < seq_count; j++, seq++) {
@@ -996,24 +1019,34 @@ static void tap_sock_reset(struct ctx *c)
  */
 static void tap_passt_input(struct ctx *c, const struct timespec *now)
 {
+	static char partial_copy[sizeof(uint32_t) + ETH_MAX_MTU];
 	static const char *partial_frame;
 	static ssize_t partial_len = 0;
+	char *buf, *p;
+	size_t size;
 	ssize_t n;
-	char *p;
 
 	tap_flush_pools();
 
+	/* Getting a zero-copy buffer might replace pages of pkt_buf */
+	if (partial_len && c->zerocopy) {
+		memcpy(partial_copy, partial_frame, partial_len);
+		partial_frame = partial_copy;
+	}
+
+	buf = zerocopy_buf(c, &size);
+
 	if (partial_len) {
 		/* We have a partial frame from an earlier pass.  Move it to the
 		 * start of the buffer, top up with new data, then process all
 		 * of it.
 		 */
-		memmove(pkt_buf, partial_frame, partial_len);
+		memmove(buf, partial_frame, partial_len);
 	}
 
 	do {
-		n = recv(c->fd_tap, pkt_buf + partial_len,
-			 TAP_BUF_BYTES - partial_len, MSG_DONTWAIT);
+		n = recv(c->fd_tap, buf + partial_len,
+			 size - partial_len, MSG_DONTWAIT);
 	} while ((n < 0) && errno == EINTR);
 
 	if (n < 0) {
@@ -1024,7 +1057,7 @@ static void tap_passt_input(struct ctx *c, const struct timespec *now)
 		return;
 	}
 
-	p = pkt_buf;
+	p = buf;
 	n += partial_len;
 
 	while (n >= (ssize_t)sizeof(uint32_t)) {
@@ -1081,11 +1114,14 @@ void tap_handler_passt(struct ctx *c, uint32_t events,
 static void tap_pasta_input(struct ctx *c, const struct timespec *now)
 {
 	ssize_t n, len;
+	size_t size;
+	char *buf;
 
 	tap_flush_pools();
+	buf = zerocopy_buf(c, &size);
 
-	for (n = 0; n <= (ssize_t)(TAP_BUF_BYTES - ETH_MAX_MTU); n += len) {
-		len = read(c->fd_tap, pkt_buf + n, ETH_MAX_MTU);
+	for (n = 0; n <= (ssize_t)(size - ETH_MAX_MTU); n += len) {
+		len = read(c->fd_tap, buf + n, ETH_MAX_MTU);
 
 		if (len == 0) {
 			die("EOF on tap device, exiting");
@@ -1106,7 +1142,7 @@ static void tap_pasta_input(struct ctx *c, const struct timespec *now)
 		    len > (ssize_t)ETH_MAX_MTU)
 			continue;
 
-		tap_add_packet(c, len, pkt_buf + n);
+		tap_add_packet(c, len, buf + n);
 	}
 
 	tap_handler(c, now);
@@ -200,9 +200,11 @@
  * - ACT_TIMEOUT, in the presence of any event: if no activity is detected on
  *   either side, the connection is reset
  *
- * - ACK_INTERVAL elapsed after data segment received from tap without having
+ * - ACK delay elapsed after data segment received from tap without having
  *   sent an ACK segment, or zero-sized window advertised to tap/guest (flag
- *   ACK_TO_TAP_DUE): forcibly check if an ACK segment can be sent
+ *   ACK_TO_TAP_DUE): forcibly check if an ACK segment can be sent. The delay
+ *   is adaptive, derived from the minimum RTT reported by the kernel for the
+ *   socket, between ACK_INTERVAL_MIN and ACK_INTERVAL
  *
  *
  * Summary of data flows (with ESTABLISHED event)
@@ -244,8 +246,11 @@
  *       two ACKs with number @seq_ack_to_tap, discard packet
  *     - otherwise queue data to socket, set @seq_from_tap to seq from header
  *       plus payload length
- *     - in ESTABLISHED state, send ACK to tap as soon as we queue to the
- *       socket. In other states, query socket for TCP_INFO, set
+ *     - in ESTABLISHED state, coalesce ACKs for all the data segments from
+ *       the same batch of packets from tap (see tcp_ack_flush()), then send
+ *       an ACK to tap if at least ACK_SEGS segments were received since the
+ *       last one, or if 1 / ACK_WND_FRACTION of the window is used, otherwise
+ *       delay it. In other states, query socket for TCP_INFO, set
  *       @seq_ack_to_tap to (tcpi_bytes_acked + @seq_init_from_tap) % 2^32 and
  *       send ACK to tap/guest
  *
@@ -304,12 +309,21 @@
 #include "flow_table.h"
 #include "tcp_internal.h"
 #include "tcp_buf.h"
+#include "tcp_ofo.h"
+#include "zerocopy.h"
+#include "stats.h"
+#include "rate.h"
+#include "usdt.h"
 
 /* MSS rounding: see SET_MSS() */
 #define MSS_DEFAULT			536
 #define WINDOW_DEFAULT			14600		/* RFC 6928 */
 
 #define ACK_INTERVAL			10		/* ms */
+#define ACK_INTERVAL_MIN		1		/* ms */
+#define ACK_SEGS			2	/* ACK at least every two segments */
+#define ACK_WND_FRACTION		4	/* ...or if a quarter of window used */
+#define ACK_BATCH_MAX			128	/* Deferred ACKs per batch */
 #define SYN_TIMEOUT			10		/* s */
 #define ACK_TIMEOUT			2
 #define FIN_TIMEOUT			60
@@ -347,6 +361,38 @@ static const char *tcp_flag_str[] __attribute((__unused__)) = {
 	"ACK_FROM_TAP_DUE",
 };
 
+/* Connections with ACKs to tap deferred until the end of the tap batch */
+static unsigned tcp_ack_batch[ACK_BATCH_MAX];
+static unsigned tcp_ack_batch_n;
+
+/**
+ * struct tcp_ack_stats - Counters for ACK segments sent to tap/guest
+ * @acks:	ACK segments without data sent to tap
+ * @coalesced:	ACKs coalesced with others from the same batch
+ * @delayed:	ACKs delayed past the end of the batch
+ * @bytes:	Data bytes received from tap and queued to sockets
+ * @bytes_log:	Value of @bytes when counters were last logged
+ */
+static struct tcp_ack_stats {
+	uint64_t acks;
+	uint64_t coalesced;
+	uint64_t delayed;
+	uint64_t bytes;
+	uint64_t bytes_log;
+} tcp_ack_stats;
+
+/**
+ * struct tcp_rexmit_stats - Counters for data retransmitted to tap/guest
+ * @bytes:	Bytes retransmitted rewinding the whole window
+ * @sack:	Bytes retransmitted only up to the first SACK block
+ * @log:	Sum of counters when they were last logged
+ */
+static struct tcp_rexmit_stats {
+	uint64_t bytes;
+	uint64_t sack;
+	uint64_t log;
+} tcp_rexmit_stats;
+
 /* Listening sockets, used for automatic port forwarding in pasta mode only */
 static int tcp_sock_init_ext	[NUM_PORTS][IP_VERSIONS];
 static int tcp_sock_ns		[NUM_PORTS][IP_VERSIONS];
@@ -438,7 +484,7 @@ static uint32_t tcp_conn_epoll_events(uint8_t events, uint8_t conn_flags)
 		if (conn_flags & STALLED)
 			return EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
 
-		return EPOLLIN | EPOLLRDHUP;
+		return EPOLLIN | EPOLLRDHUP | EPOLLET;
 	}
 
 	if (events == TAP_SYN_RCVD)
@@ -533,7 +579,9 @@ static void tcp_timer_ctl(const struct ctx *c, struct tcp_tap_conn *conn)
 	}
 
 	if (conn->flags & ACK_TO_TAP_DUE) {
-		it.it_value.tv_nsec = (long)ACK_INTERVAL * 1000 * 1000;
+		int delay = conn->ack_delay ? conn->ack_delay : ACK_INTERVAL;
+
+		it.it_value.tv_nsec = (long)delay * 1000 * 1000;
 	} else if (conn->flags & ACK_FROM_TAP_DUE) {
 		if (!(conn->events & ESTABLISHED))
 			it.it_value.tv_sec = SYN_TIMEOUT;
@@ -592,6 +640,8 @@ void conn_flag_do(const struct ctx *c, struct tcp_tap_conn *conn,
 			flow_dbg(conn, "%s", tcp_flag_str[flag_index]);
 	}
 
+	USDT3(tcp_flag, FLOW_IDX(conn), flag, conn->flags);
+
 	if (flag == STALLED || flag == ~STALLED)
 		tcp_epoll_ctl(c, conn);
 
@@ -636,6 +686,8 @@ void conn_event_do(const struct ctx *c, struct tcp_tap_conn *conn,
 	if (conn->flags & ACTIVE_CLOSE)
 		new += 5;
 
+	USDT3(tcp_event, FLOW_IDX(conn), event, conn->events);
+
 	if (prev != new)
 		flow_dbg(conn, "%s: %s -> %s",
 			 num == -1 	       ? "CLOSED" : tcp_event_str[num],
@@ -923,21 +975,14 @@ bool tcp_flow_defer(const struct tcp_tap_conn *conn)
 	if (conn->events != CLOSED)
 		return false;
 
+	zerocopy_close(conn->sock);
 	close(conn->sock);
 	if (conn->timer != -1)
 		close(conn->timer);
 
-	return true;
-}
+	tcp_ofo_drop(conn);
 
-/**
- * tcp_defer_handler() - Handler for TCP deferred tasks
- * @c:		Execution context
- */
-/* cppcheck-suppress [constParameterPointer, unmatchedSuppression] */
-void tcp_defer_handler(struct ctx *c)
-{
-	tcp_payload_flush(c);
+	return true;
 }
 
 /**
@@ -1100,6 +1145,35 @@ size_t tcp_l2_buf_fill_headers(const struct tcp_tap_conn *conn,
 				 seq, no_tcp_csum);
 }
 
+/**
+ * tcp_wnd_rate_clamp() - Clamp window to guest to what rate limits let through
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ * @wnd:	Window we would advertise otherwise, not scaled
+ *
+ * Data written to the socket takes tokens away as the guest fills the window,
+ * so the right edge stays put until buckets refill: the window never shrinks.
+ *
+ * Return: @wnd, clamped to tokens available towards the host
+ */
+static uint32_t tcp_wnd_rate_clamp(const struct ctx *c,
+				   const struct tcp_tap_conn *conn,
+				   uint32_t wnd)
+{
+	size_t avail;
+
+	if (!c->rate_flow && !c->rate_pif)
+		return wnd;
+
+	avail = rate_avail(c, PIF_HOST, FLOW_IDX(conn));
+	if (avail >= wnd)
+		return wnd;
+
+	/* Send a window update once we have tokens again */
+	rate_throttled(FLOW_IDX(conn));
+	return avail;
+}
+
 /**
  * tcp_update_seqack_wnd() - Update ACK sequence and window to guest/tap
  * @c:		Execution context
@@ -1147,13 +1221,15 @@ int tcp_update_seqack_wnd(const struct ctx *c, struct tcp_tap_conn *conn,
 	if (!snd_wnd_cap) {
 		tcp_get_sndbuf(conn);
 		new_wnd_to_tap = MIN(SNDBUF_GET(conn), MAX_WINDOW);
+		new_wnd_to_tap = tcp_wnd_rate_clamp(c, conn, new_wnd_to_tap);
 		conn->wnd_to_tap = MIN(new_wnd_to_tap >> conn->ws_to_tap,
 				       USHRT_MAX);
 		goto out;
 	}
 
 	if (!tinfo) {
-		if (prev_wnd_to_tap > WINDOW_DEFAULT) {
+		if (prev_wnd_to_tap > WINDOW_DEFAULT &&
+		    !c->rate_flow && !c->rate_pif) {
 			goto out;
 		}
 		tinfo = &tinfo_new;
@@ -1171,6 +1247,7 @@ int tcp_update_seqack_wnd(const struct ctx *c, struct tcp_tap_conn *conn,
 	}
 
 	new_wnd_to_tap = MIN(new_wnd_to_tap, MAX_WINDOW);
+	new_wnd_to_tap = tcp_wnd_rate_clamp(c, conn, new_wnd_to_tap);
 	if (!(conn->events & ESTABLISHED))
 		new_wnd_to_tap = MAX(new_wnd_to_tap, WINDOW_DEFAULT);
 
@@ -1210,9 +1287,85 @@ static void tcp_update_seqack_from_tap(const struct ctx *c,
 
 		conn->retrans = 0;
 		conn->seq_ack_from_tap = seq;
+
+		conn->sack_rexmit = false;
+		if (SEQ_GE(seq, conn->seq_sack_from_tap))
+			conn->sack_valid = false;
+	}
+}
+
+/**
+ * tcp_sack_update() - Record lowest left edge of SACK blocks from tap
+ * @conn:	Connection pointer
+ * @opts:	Pointer to start of TCP options in header
+ * @optlen:	Length of options
+ * @ack_seq:	ACK sequence from the same segment, host order
+ *
+ * Only the first hole matters to us: we retransmit data between the last
+ * acknowledged sequence and the first block the receiver already has, and
+ * leave recovery of any further hole to subsequent duplicate ACKs.
+ */
+static void tcp_sack_update(struct tcp_tap_conn *conn, const char *opts,
+			    size_t optlen, uint32_t ack_seq)
+{
+	const char *blocks = NULL;
+	uint8_t len = 0;
+	int i;
+
+	/* Not the return value: that's the first left edge, might look negative */
+	tcp_opt_get(opts, optlen, OPT_SACK, &len, &blocks);
+	if (!blocks)
+		return;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		uint32_t left, right;
+
+		memcpy(&left, blocks + i, sizeof(left));
+		memcpy(&right, blocks + i + 4, sizeof(right));
+		left = ntohl(left);
+		right = ntohl(right);
+
+		if (SEQ_LE(left, ack_seq) || SEQ_LE(right, left) ||
+		    SEQ_GT(right, conn->seq_to_tap))
+			continue;
+
+		if (!conn->sack_valid || SEQ_LT(left, conn->seq_sack_from_tap)) {
+			conn->seq_sack_from_tap = left;
+			conn->sack_valid = true;
+		}
 	}
 }
 
+/**
+ * tcp_sack_rexmit() - Retransmit data up to the first SACK block
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ *
+ * Return: negative on connection reset, bytes retransmitted otherwise
+ */
+static int tcp_sack_rexmit(const struct ctx *c, struct tcp_tap_conn *conn)
+{
+	int n;
+
+	if (SEQ_GT(conn->seq_sack_from_tap, conn->seq_to_tap) ||
+	    SEQ_LE(conn->seq_sack_from_tap, conn->seq_ack_from_tap)) {
+		conn->sack_valid = false;
+		return 0;
+	}
+
+	flow_trace(conn, "SACK re-transmit, ACK: %u, first SACK block: %u",
+		   conn->seq_ack_from_tap, conn->seq_sack_from_tap);
+
+	n = tcp_buf_retransmit(c, conn, conn->seq_sack_from_tap -
+					conn->seq_ack_from_tap);
+	if (n < 0)
+		return n;
+
+	tcp_rexmit_stats.sack += n;
+	conn->sack_rexmit = true;
+	return n;
+}
+
 /**
  * tcp_prepare_flags() - Prepare header for flags-only segment (no payload)
  * @c:		Execution context
@@ -1234,8 +1387,9 @@ int tcp_prepare_flags(const struct ctx *c, struct tcp_tap_conn *conn,
 	socklen_t sl = sizeof(tinfo);
 	int s = conn->sock;
 
+	/* With rate limits, the window might need to reopen: check anyway */
 	if (SEQ_GE(conn->seq_ack_to_tap, conn->seq_from_tap) &&
-	    !flags && conn->wnd_to_tap)
+	    !flags && conn->wnd_to_tap && !c->rate_flow && !c->rate_pif)
 		return 0;
 
 	if (getsockopt(s, SOL_TCP, TCP_INFO, &tinfo, &sl)) {
@@ -1246,6 +1400,11 @@ int tcp_prepare_flags(const struct ctx *c, struct tcp_tap_conn *conn,
 	if (!(conn->flags & LOCAL))
 		tcp_rtt_dst_check(conn, &tinfo);
 
+	if (min_rtt_cap) {
+		conn->ack_delay = MIN(MAX(tinfo.tcpi_min_rtt / 1000,
+					  ACK_INTERVAL_MIN), ACK_INTERVAL);
+	}
+
 	if (!tcp_update_seqack_wnd(c, conn, !!flags, &tinfo) && !flags)
 		return 0;
 
@@ -1272,9 +1431,16 @@ int tcp_prepare_flags(const struct ctx *c, struct tcp_tap_conn *conn,
 		conn->ws_to_tap = MIN(MAX_WS, tinfo.tcpi_snd_wscale);
 
 		*opts = TCP_SYN_OPTS(mss, conn->ws_to_tap);
-		*optlen = sizeof(*opts);
+		if (conn->tap_sack)
+			*optlen = sizeof(*opts);
+		else
+			*optlen = TCP_SYN_OPTS_NO_SACK_LEN;
 	} else if (!(flags & RST)) {
 		flags |= ACK;
+
+		/* Report out-of-order data we queued, see tcp_ofo.c */
+		if (conn->tap_sack)
+			*optlen = tcp_ofo_sack(conn, (char *)opts);
 	}
 
 	th->doff = (sizeof(*th) + *optlen) / 4;
@@ -1285,6 +1451,9 @@ int tcp_prepare_flags(const struct ctx *c, struct tcp_tap_conn *conn,
 	th->fin = !!(flags & FIN);
 
 	if (th->ack) {
+		conn->ack_segs = 0;
+		tcp_ack_stats.acks++;
+
 		if (SEQ_GE(conn->seq_ack_to_tap, conn->seq_from_tap))
 			conn_flag(c, conn, ~ACK_TO_TAP_DUE);
 		else
@@ -1453,13 +1622,15 @@ int tcp_conn_sock(const struct ctx *c, sa_family_t af)
 
 /**
  * tcp_conn_tap_mss() - Get MSS value advertised by tap/guest
+ * @c:		Execution context
  * @conn:	Connection pointer
  * @opts:	Pointer to start of TCP options
  * @optlen:	Bytes in options: caller MUST ensure available length
  *
  * Return: clamped MSS value
  */
-static uint16_t tcp_conn_tap_mss(const struct tcp_tap_conn *conn,
+static uint16_t tcp_conn_tap_mss(const struct ctx *c,
+				 const struct tcp_tap_conn *conn,
 				 const char *opts, size_t optlen)
 {
 	unsigned int mss;
@@ -1475,6 +1646,13 @@ static uint16_t tcp_conn_tap_mss(const struct tcp_tap_conn *conn,
 	else
 		mss = MIN(MSS6, mss);
 
+	/* Frames to tap are sized for the MTU, see tcp_sock_iov_init() */
+	if (c->mtu != -1) {
+		mss = MIN(c->mtu - sizeof(struct tcphdr) -
+			  (CONN_V4(conn) ? sizeof(struct iphdr) :
+					   sizeof(struct ipv6hdr)), mss);
+	}
+
 	return MIN(mss, USHRT_MAX);
 }
 
@@ -1563,9 +1741,10 @@ static void tcp_conn_from_tap(const struct ctx *c, sa_family_t af,
 		goto cancel;
 
 	if (flow->f.pif[TGTSIDE] != PIF_HOST) {
-		flow_err(flow, "No support for forwarding TCP from %s to %s",
-			 pif_name(flow->f.pif[INISIDE]),
-			 pif_name(flow->f.pif[TGTSIDE]));
+		flow_err_ratelimit(flow,
+				   "No support for forwarding TCP from %s to %s",
+				   pif_name(flow->f.pif[INISIDE]),
+				   pif_name(flow->f.pif[TGTSIDE]));
 		goto cancel;
 	}
 
@@ -1575,9 +1754,11 @@ static void tcp_conn_from_tap(const struct ctx *c, sa_family_t af,
 	    !inany_is_unicast(&ini->oaddr) || ini->oport == 0) {
 		char sstr[INANY_ADDRSTRLEN], dstr[INANY_ADDRSTRLEN];
 
-		debug("Invalid endpoint in TCP SYN: %s:%hu -> %s:%hu",
-		      inany_ntop(&ini->eaddr, sstr, sizeof(sstr)), ini->eport,
-		      inany_ntop(&ini->oaddr, dstr, sizeof(dstr)), ini->oport);
+		debug_ratelimit("Invalid endpoint in TCP SYN: %s:%hu -> %s:%hu",
+				inany_ntop(&ini->eaddr, sstr, sizeof(sstr)),
+				ini->eport,
+				inany_ntop(&ini->oaddr, dstr, sizeof(dstr)),
+				ini->oport);
 		goto cancel;
 	}
 
@@ -1612,12 +1793,13 @@ static void tcp_conn_from_tap(const struct ctx *c, sa_family_t af,
 
 	conn->wnd_to_tap = WINDOW_DEFAULT;
 
-	mss = tcp_conn_tap_mss(conn, opts, optlen);
+	mss = tcp_conn_tap_mss(c, conn, opts, optlen);
 	if (setsockopt(s, SOL_TCP, TCP_MAXSEG, &mss, sizeof(mss)))
 		flow_trace(conn, "failed to set TCP_MAXSEG on socket %i", s);
 	MSS_SET(conn, mss);
 
 	tcp_get_tap_ws(conn, opts, optlen);
+	conn->tap_sack = tcp_opt_get(opts, optlen, OPT_SACKP, NULL, NULL) >= 0;
 
 	/* RFC 7323, 2.2: first value is not scaled. Also, don't clamp yet, to
 	 * avoid getting a zero scale just because we set a small window now.
@@ -1699,13 +1881,166 @@ static int tcp_sock_consume(const struct tcp_tap_conn *conn, uint32_t ack_seq)
  * @c:		Execution context
  * @conn:	Connection pointer
  *
+ * Sockets are edge-triggered: keep reading as long as we fill all the buffers
+ * we pass, up to FLOW_BUDGET times, then let other flows run, and resume this
+ * one on the next main loop iteration.
+ *
  * Return: negative on connection reset, 0 otherwise
  *
  * #syscalls recvmsg
  */
 static int tcp_data_from_sock(const struct ctx *c, struct tcp_tap_conn *conn)
 {
-	return tcp_buf_data_from_sock(c, conn);
+	int i, ret;
+
+	for (i = 0; i < FLOW_BUDGET; i++) {
+		if ((ret = tcp_buf_data_from_sock(c, conn)) <= 0)
+			return ret;
+	}
+
+	flow_ready(FLOW_IDX(conn));
+	return 0;
+}
+
+/**
+ * tcp_data_resume() - Resume sending data to tap, throttled or out of budget
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ *
+ * Also reopens the window to the guest, if rate limits clamped it.
+ */
+void tcp_data_resume(const struct ctx *c, struct tcp_tap_conn *conn)
+{
+	if (!(conn->events & ESTABLISHED))
+		return;
+
+	if (c->rate_flow || c->rate_pif)
+		tcp_send_flag(c, conn, ACK_IF_NEEDED);
+
+	if (!(conn->events & TAP_FIN_SENT))
+		tcp_data_from_sock(c, conn);
+}
+
+/**
+ * tcp_ack_defer() - Defer ACK to tap until the end of the current batch
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ */
+static void tcp_ack_defer(const struct ctx *c, struct tcp_tap_conn *conn)
+{
+	if (conn->ack_batch) {
+		tcp_ack_stats.coalesced++;
+		return;
+	}
+
+	if (tcp_ack_batch_n >= ARRAY_SIZE(tcp_ack_batch)) {
+		tcp_send_flag(c, conn, ACK_IF_NEEDED);
+		return;
+	}
+
+	/* Not a connection flag: no need to log or trace it on every batch */
+	conn->ack_batch = true;
+	tcp_ack_batch[tcp_ack_batch_n++] = FLOW_IDX(conn);
+}
+
+/**
+ * tcp_ack_now() - Check if we should send an ACK to tap right away
+ * @conn:	Connection pointer
+ *
+ * Return: true if enough segments or a significant part of the window are
+ *	   unacknowledged, if the peer is local, or if there's nothing to delay
+ */
+static bool tcp_ack_now(const struct tcp_tap_conn *conn)
+{
+	uint32_t wnd = conn->wnd_to_tap << conn->ws_to_tap;
+	uint32_t unacked = conn->seq_from_tap - conn->seq_ack_to_tap;
+
+	if (!unacked || !wnd)
+		return true;
+
+	if (conn->ack_segs >= ACK_SEGS || unacked >= wnd / ACK_WND_FRACTION)
+		return true;
+
+	return (conn->flags & LOCAL) || tcp_rtt_dst_low(conn);
+}
+
+/**
+ * tcp_ack_flush() - Send or delay ACKs deferred during the last tap batch
+ * @c:		Execution context
+ */
+static void tcp_ack_flush(const struct ctx *c)
+{
+	unsigned i;
+
+	for (i = 0; i < tcp_ack_batch_n; i++) {
+		struct tcp_tap_conn *conn = &FLOW(tcp_ack_batch[i])->tcp;
+
+		if (conn->f.type != FLOW_TCP)
+			continue;
+
+		conn->ack_batch = false;
+		if (conn->events == CLOSED)
+			continue;
+
+		if (tcp_ack_now(conn)) {
+			tcp_send_flag(c, conn, ACK_IF_NEEDED);
+		} else {
+			tcp_ack_stats.delayed++;
+			conn_flag(c, conn, ACK_TO_TAP_DUE);
+		}
+	}
+
+	tcp_ack_batch_n = 0;
+}
+
+/**
+ * tcp_defer_handler() - Handler for TCP deferred tasks
+ * @c:		Execution context
+ */
+/* cppcheck-suppress [constParameterPointer, unmatchedSuppression] */
+void tcp_defer_handler(struct ctx *c)
+{
+	tcp_ack_flush(c);
+	tcp_payload_flush(c);
+}
+
+/**
+ * tcp_data_ofo_queue() - Queue segments received after a hole in sequence
+ * @conn:	Connection pointer
+ * @p:		Pool of TCP packets, with TCP headers
+ * @idx:	Index of first out-of-order packet in pool
+ * @seq_from_tap:	Next expected sequence from tap, host order
+ */
+static void tcp_data_ofo_queue(struct tcp_tap_conn *conn, const struct pool *p,
+			       int idx, uint32_t seq_from_tap)
+{
+	uint32_t wnd = conn->wnd_to_tap << conn->ws_to_tap;
+	int i;
+
+	for (i = idx; i < (int)p->count; i++) {
+		const struct tcphdr *th;
+		size_t len, off;
+		uint32_t seq;
+		char *data;
+
+		th = packet_get(p, i, 0, sizeof(*th), &len);
+		if (!th)
+			return;
+		len += sizeof(*th);
+		off = th->doff * 4UL;
+
+		seq = ntohl(th->seq);
+		if (!SEQ_GT(seq, seq_from_tap) || seq - seq_from_tap >= wnd)
+			continue;
+
+		len = MIN(len - off, seq_from_tap + wnd - seq);
+		if (!len || !(data = packet_get(p, i, off, len, NULL)))
+			continue;
+
+		if (tcp_ofo_queue(conn, seq, data, len) < len)
+			flow_trace_ratelimit(conn,
+					     "out-of-order queue full, dropping data");
+	}
 }
 
 /**
@@ -1723,9 +2058,11 @@ static int tcp_data_from_tap(const struct ctx *c, struct tcp_tap_conn *conn,
 			     const struct pool *p, int idx)
 {
 	int i, iov_i, ack = 0, fin = 0, retr = 0, keep = -1, partial_send = 0;
+	int ofo_i = 0, zc = 0;
 	uint16_t max_ack_seq_wnd = conn->wnd_from_tap;
 	uint32_t max_ack_seq = conn->seq_ack_from_tap;
 	uint32_t seq_from_tap = conn->seq_from_tap;
+	uint32_t seq_end = conn->seq_from_tap;
 	struct msghdr mh = { .msg_iov = tcp_iov };
 	size_t len;
 	ssize_t n;
@@ -1766,6 +2103,15 @@ static int tcp_data_from_tap(const struct ctx *c, struct tcp_tap_conn *conn,
 		if (th->ack) {
 			ack = 1;
 
+			if (conn->tap_sack && off > sizeof(*th)) {
+				const char *opts;
+
+				opts = packet_get(p, i, sizeof(*th),
+						  off - sizeof(*th), NULL);
+				tcp_sack_update(conn, opts, off - sizeof(*th),
+						ack_seq);
+			}
+
 			if (SEQ_GE(ack_seq, conn->seq_ack_from_tap) &&
 			    SEQ_GE(ack_seq, max_ack_seq)) {
 				/* Fast re-transmit */
@@ -1784,6 +2130,9 @@ static int tcp_data_from_tap(const struct ctx *c, struct tcp_tap_conn *conn,
 		if (!len)
 			continue;
 
+		if (SEQ_GT(seq + len, seq_end))
+			seq_end = seq + len;
+
 		seq_offset = seq_from_tap - seq;
 		/* Use data from this buffer only in these two cases:
 		 *
@@ -1834,10 +2183,27 @@ static int tcp_data_from_tap(const struct ctx *c, struct tcp_tap_conn *conn,
 
 	tcp_tap_window_update(conn, max_ack_seq_wnd);
 
-	if (retr) {
+	/* Hold data after a hole, and append any queued data now in sequence */
+	if (keep != -1)
+		tcp_data_ofo_queue(conn, p, keep, seq_from_tap);
+
+	if (conn->ofo_head) {
+		ofo_i = tcp_ofo_iov(conn, &seq_from_tap, tcp_iov + iov_i,
+				    UIO_MAXIOV - iov_i);
+		iov_i += ofo_i;
+	}
+
+	if (retr && conn->sack_valid) {
+		/* Retransmit the first hole once, further duplicate ACKs
+		 * just report blocks the receiver got in the meantime
+		 */
+		if (!conn->sack_rexmit && tcp_sack_rexmit(c, conn) < 0)
+			return -1;
+	} else if (retr) {
 		flow_trace(conn,
 			   "fast re-transmit, ACK: %u, previous sequence: %u",
 			   max_ack_seq, conn->seq_to_tap);
+		tcp_rexmit_stats.bytes += conn->seq_to_tap - max_ack_seq;
 		conn->seq_to_tap = max_ack_seq;
 		if (tcp_set_peek_offset(conn->sock, 0)) {
 			tcp_rst(c, conn);
@@ -1849,10 +2215,22 @@ static int tcp_data_from_tap(const struct ctx *c, struct tcp_tap_conn *conn,
 	if (!iov_i)
 		goto out;
 
+	/* Blocks of out-of-order data are recycled right after sending */
+	if (!ofo_i) {
+		zc = zerocopy_flags(c, conn->sock,
+				    seq_from_tap - conn->seq_from_tap);
+	}
+
 	mh.msg_iovlen = iov_i;
 eintr:
-	n = sendmsg(conn->sock, &mh, MSG_DONTWAIT | MSG_NOSIGNAL);
+	n = sendmsg(conn->sock, &mh, MSG_DONTWAIT | MSG_NOSIGNAL | zc);
 	if (n < 0) {
+		if (errno == ENOBUFS && zc) {
+			/* No memory for completion notifications: copy */
+			zc = 0;
+			goto eintr;
+		}
+
 		if (errno == EPIPE) {
 			/* Here's the wrap, said the tap.
 			 * In my pocket, said the socket.
@@ -1873,6 +2251,16 @@ eintr:
 		return -1;
 	}
 
+	if (zc)
+		zerocopy_sent(conn->sock, 1);
+
+	stats_latency(STATS_TO_SOCK, STATS_TCP, 1);
+
+	rate_consume(c, PIF_HOST, FLOW_IDX(conn), n);
+
+	tcp_ack_stats.bytes += n;
+	conn->ack_segs = MIN(conn->ack_segs + iov_i, TCP_ACK_SEGS_MAX);
+
 	if (n < (int)(seq_from_tap - conn->seq_from_tap)) {
 		partial_send = 1;
 		conn->seq_from_tap += n;
@@ -1881,8 +2269,11 @@ eintr:
 		conn->seq_from_tap += n;
 	}
 
+	tcp_ofo_consume(conn, conn->seq_from_tap);
+
 out:
-	if (keep != -1) {
+	/* Queued data might have just filled the hole: if not, ask again */
+	if (keep != -1 && SEQ_LT(conn->seq_from_tap, seq_end)) {
 		/* We use an 8-bit approximation here: the associated risk is
 		 * that we skip a duplicate ACK on 8-bit sequence number
 		 * collision. Fast retransmit is a SHOULD in RFC 5681, 3.2.
@@ -1903,7 +2294,7 @@ out:
 
 		conn_event(c, conn, TAP_FIN_RCVD);
 	} else {
-		tcp_send_flag(c, conn, ACK_IF_NEEDED);
+		tcp_ack_defer(c, conn);
 	}
 
 	return p->count - idx;
@@ -1924,12 +2315,13 @@ static void tcp_conn_from_sock_finish(const struct ctx *c,
 {
 	tcp_tap_window_update(conn, ntohs(th->window));
 	tcp_get_tap_ws(conn, opts, optlen);
+	conn->tap_sack = tcp_opt_get(opts, optlen, OPT_SACKP, NULL, NULL) >= 0;
 
 	/* First value is not scaled */
 	if (!(conn->wnd_from_tap >>= conn->ws_from_tap))
 		conn->wnd_from_tap = 1;
 
-	MSS_SET(conn, tcp_conn_tap_mss(conn, opts, optlen));
+	MSS_SET(conn, tcp_conn_tap_mss(c, conn, opts, optlen));
 
 	conn->seq_init_from_tap = ntohl(th->seq) + 1;
 	conn->seq_from_tap = conn->seq_init_from_tap;
@@ -1993,9 +2385,12 @@ int tcp_tap_handler(const struct ctx *c, uint8_t pif, sa_family_t af,
 
 	/* New connection from tap */
 	if (!flow) {
-		if (opts && th->syn && !th->ack)
+		if (opts && th->syn && !th->ack) {
+			stats_conn_start();
 			tcp_conn_from_tap(c, af, saddr, daddr, th,
 					  opts, optlen, now);
+			stats_conn_done(PIF_TAP);
+		}
 		return 1;
 	}
 
@@ -2135,6 +2530,7 @@ static void tcp_tap_conn_from_sock(const struct ctx *c, union flow *flow,
 	conn->sock = s;
 	conn->timer = -1;
 	conn->ws_to_tap = conn->ws_from_tap = 0;
+	conn->tap_sack = true;		/* Offer SACK, see tcp_prepare_flags() */
 	conn_event(c, conn, SOCK_ACCEPTED);
 
 	hash = flow_hash_insert(c, TAP_SIDX(conn));
@@ -2204,9 +2600,10 @@ void tcp_listen_handler(const struct ctx *c, union epoll_ref ref,
 		break;
 
 	default:
-		flow_err(flow, "No support for forwarding TCP from %s to %s",
-			 pif_name(flow->f.pif[INISIDE]),
-			 pif_name(flow->f.pif[TGTSIDE]));
+		flow_err_ratelimit(flow,
+				   "No support for forwarding TCP from %s to %s",
+				   pif_name(flow->f.pif[INISIDE]),
+				   pif_name(flow->f.pif[TGTSIDE]));
 		goto cancel;
 	}
 
@@ -2257,6 +2654,30 @@ void tcp_timer_handler(const struct ctx *c, union epoll_ref ref)
 		} else {
 			flow_dbg(conn, "ACK timeout, retry");
 			conn->retrans++;
+			stats.tcp_retrans++;
+
+			if (conn->sack_valid) {
+				int n;
+
+				/* Blocks after the hole might have been
+				 * discarded by the receiver (RFC 2018, 8),
+				 * retransmit everything if this fails again
+				 */
+				conn->sack_valid = false;
+				n = tcp_sack_rexmit(c, conn);
+				if (n < 0)
+					return;
+
+				if (n) {
+					tcp_timer_ctl(c, conn);
+					return;
+				}
+
+				/* Stale SACK block, nothing sent: rewind now */
+			}
+
+			tcp_rexmit_stats.bytes += conn->seq_to_tap -
+						  conn->seq_ack_from_tap;
 			conn->seq_to_tap = conn->seq_ack_from_tap;
 			if (tcp_set_peek_offset(conn->sock, 0)) {
 				tcp_rst(c, conn);
@@ -2304,8 +2725,15 @@ void tcp_sock_handler(const struct ctx *c, union epoll_ref ref,
 		return;
 
 	if (events & EPOLLERR) {
-		tcp_rst(c, conn);
-		return;
+		socklen_t sl = sizeof(int);
+		int err = 0;
+
+		/* Zero-copy completions are reported as errors, too */
+		if (!c->zerocopy || zerocopy_recverr(ref.fd) <= 0 ||
+		    getsockopt(ref.fd, SOL_SOCKET, SO_ERROR, &err, &sl) || err) {
+			tcp_rst(c, conn);
+			return;
+		}
 	}
 
 	if ((conn->events & TAP_FIN_SENT) && (events & EPOLLHUP)) {
@@ -2732,4 +3160,24 @@ void tcp_timer(struct ctx *c, const struct timespec *now)
 	tcp_sock_refill_init(c);
 	if (c->mode == MODE_PASTA)
 		tcp_splice_refill(c);
+
+	if (tcp_ack_stats.bytes != tcp_ack_stats.bytes_log) {
+		debug("TCP: %llu ACKs to tap for %llu bytes from tap"
+		      " (%llu coalesced, %llu delayed)",
+		      (unsigned long long)tcp_ack_stats.acks,
+		      (unsigned long long)tcp_ack_stats.bytes,
+		      (unsigned long long)tcp_ack_stats.coalesced,
+		      (unsigned long long)tcp_ack_stats.delayed);
+		tcp_ack_stats.bytes_log = tcp_ack_stats.bytes;
+	}
+
+	if (tcp_rexmit_stats.bytes + tcp_rexmit_stats.sack !=
+	    tcp_rexmit_stats.log) {
+		debug("TCP: %llu bytes retransmitted to tap, %llu using SACK",
+		      (unsigned long long)(tcp_rexmit_stats.bytes +
+					   tcp_rexmit_stats.sack),
+		      (unsigned long long)tcp_rexmit_stats.sack);
+		tcp_rexmit_stats.log = tcp_rexmit_stats.bytes +
+				       tcp_rexmit_stats.sack;
+	}
 }
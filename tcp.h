@@ -8,6 +8,9 @@
 
 #define TCP_TIMER_INTERVAL		1000	/* ms */
 
+#define TCP_FRAMES_DEFAULT		128	/* Frames to tap per batch */
+#define TCP_FRAMES_MAX			256	/* UIO_MAXIOV / TCP_NUM_IOVS */
+
 struct ctx;
 
 void tcp_timer_handler(const struct ctx *c, union epoll_ref ref);
@@ -59,13 +62,17 @@ union tcp_listen_epoll_ref {
  * @fwd_in:		Port forwarding configuration for inbound packets
  * @fwd_out:		Port forwarding configuration for outbound packets
  * @timer_run:		Timestamp of most recent timer run
- * @pipe_size:		Size of pipes for spliced connections
+ * @pipe_size:		Maximum size of pipes for spliced connections
+ * @frames:		Number of frames queued to tap per batch, 0 for default
+ * @splice_offload:	Forward data for spliced connections in kernel
  */
 struct tcp_ctx {
 	struct fwd_ports fwd_in;
 	struct fwd_ports fwd_out;
 	struct timespec timer_run;
 	size_t pipe_size;
+	unsigned int frames;
+	int splice_offload;
 };
 
 #endif /* TCP_H */
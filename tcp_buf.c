@@ -18,6 +18,8 @@
 #include <string.h>
 #include <errno.h>
 
+#include <sys/uio.h>
+
 #include <netinet/ip.h>
 
 #include <netinet/tcp.h>
@@ -30,12 +32,17 @@
 #include "siphash.h"
 #include "inany.h"
 #include "tcp_conn.h"
+#include "flow_table.h"
 #include "tcp_internal.h"
 #include "tcp_buf.h"
+#include "rate.h"
+#include "stats.h"
 
-#define TCP_FRAMES_MEM			128
 #define TCP_FRAMES							   \
-	(c->mode == MODE_PASTA ? 1 : TCP_FRAMES_MEM)
+	(c->mode == MODE_PASTA ? 1 : (int)tcp_frames)
+
+static_assert(TCP_FRAMES_MAX * TCP_NUM_IOVS <= UIO_MAXIOV,
+	      "Can't send TCP_FRAMES_MAX frames in a single sendmsg()");
 
 /* Static buffers */
 
@@ -43,26 +50,46 @@
 static struct ethhdr		tcp4_eth_src;
 static struct ethhdr		tcp6_eth_src;
 
-static struct tap_hdr		tcp_payload_tap_hdr[TCP_FRAMES_MEM];
+static struct tap_hdr		tcp_payload_tap_hdr[TCP_FRAMES_MAX];
 
 /* IP headers for IPv4 and IPv6 */
-struct iphdr		tcp4_payload_ip[TCP_FRAMES_MEM];
-struct ipv6hdr		tcp6_payload_ip[TCP_FRAMES_MEM];
+struct iphdr		tcp4_payload_ip[TCP_FRAMES_MAX];
+struct ipv6hdr		tcp6_payload_ip[TCP_FRAMES_MAX];
 
-/* TCP segments with payload for IPv4 and IPv6 frames */
-static struct tcp_payload_t	tcp_payload[TCP_FRAMES_MEM];
+/* TCP segments with payload for IPv4 and IPv6 frames: arena of frames sized
+ * for the MTU at start-up, see tcp_sock_iov_init(). Pages we don't use are
+ * never touched, so they don't add to our resident memory.
+ */
+static char tcp_frame_mem[TCP_FRAMES_MAX * sizeof(struct tcp_payload_t)]
+	__attribute__ ((aligned(__alignof__(struct tcp_payload_t))));
+static size_t tcp_frame_size;
+static unsigned int tcp_frames;
 
-static_assert(MSS4 <= sizeof(tcp_payload[0].data), "MSS4 is greater than 65516");
-static_assert(MSS6 <= sizeof(tcp_payload[0].data), "MSS6 is greater than 65516");
+static_assert(MSS4 <= sizeof(struct tcp_payload_t) - sizeof(struct tcphdr),
+	      "MSS4 is greater than 65516");
+static_assert(MSS6 <= sizeof(struct tcp_payload_t) - sizeof(struct tcphdr),
+	      "MSS6 is greater than 65516");
 
 /* References tracking the owner connection of frames in the tap outqueue */
-static struct tcp_tap_conn *tcp_frame_conns[TCP_FRAMES_MEM];
+static struct tcp_tap_conn *tcp_frame_conns[TCP_FRAMES_MAX];
 static unsigned int tcp_payload_used;
 
 /* recvmsg()/sendmsg() data for tap */
-static struct iovec	iov_sock		[TCP_FRAMES_MEM + 1];
+static struct iovec	iov_sock		[TCP_FRAMES_MAX + 1];
 
-static struct iovec	tcp_l2_iov[TCP_FRAMES_MEM][TCP_NUM_IOVS];
+static struct iovec	tcp_l2_iov[TCP_FRAMES_MAX][TCP_NUM_IOVS];
+
+/**
+ * tcp_frame() - Get frame from arena
+ * @i:		Frame index
+ *
+ * Return: pointer to TCP header and payload for frame, which can hold up to
+ *	   tcp_frame_size bytes, not sizeof(struct tcp_payload_t)
+ */
+static struct tcp_payload_t *tcp_frame(unsigned int i)
+{
+	return (struct tcp_payload_t *)(tcp_frame_mem + i * tcp_frame_size);
+}
 
 /**
  * tcp_update_l2_buf() - Update Ethernet header buffers with addresses
@@ -83,22 +110,39 @@ void tcp_sock_iov_init(const struct ctx *c)
 {
 	struct ipv6hdr ip6 = L2_BUF_IP6_INIT(IPPROTO_TCP);
 	struct iphdr iph = L2_BUF_IP4_INIT(IPPROTO_TCP);
-	int i;
+	unsigned int i;
 
 	tcp6_eth_src.h_proto = htons_constant(ETH_P_IPV6);
 	tcp4_eth_src.h_proto = htons_constant(ETH_P_IP);
 
-	for (i = 0; i < ARRAY_SIZE(tcp_payload); i++) {
-		tcp6_payload_ip[i] = ip6;
-		tcp4_payload_ip[i] = iph;
+	/* Largest segment we'll send is MTU minus IPv4 header, but we always
+	 * need room for a full set of options, see tcp_buf_send_flag()
+	 */
+	if (c->mtu == -1) {
+		tcp_frame_size = sizeof(struct tcp_payload_t);
+	} else {
+		tcp_frame_size = MAX(c->mtu - sizeof(struct iphdr),
+				     sizeof(struct tcphdr) + TCP_OPTLEN_MAX);
+		tcp_frame_size = ROUND_UP(tcp_frame_size,
+					  __alignof__(struct tcp_payload_t));
+		tcp_frame_size = MIN(tcp_frame_size,
+				     sizeof(struct tcp_payload_t));
 	}
 
-	for (i = 0; i < TCP_FRAMES_MEM; i++) {
+	tcp_frames = c->tcp.frames ? c->tcp.frames : TCP_FRAMES_DEFAULT;
+
+	debug("TCP: %u frames of %zu bytes for data to tap",
+	      tcp_frames, tcp_frame_size);
+
+	for (i = 0; i < tcp_frames; i++) {
 		struct iovec *iov = tcp_l2_iov[i];
 
+		tcp6_payload_ip[i] = ip6;
+		tcp4_payload_ip[i] = iph;
+
 		iov[TCP_IOV_TAP] = tap_hdr_iov(c, &tcp_payload_tap_hdr[i]);
 		iov[TCP_IOV_ETH].iov_len = sizeof(struct ethhdr);
-		iov[TCP_IOV_PAYLOAD].iov_base = &tcp_payload[i];
+		iov[TCP_IOV_PAYLOAD].iov_base = tcp_frame(i);
 	}
 }
 
@@ -140,6 +184,7 @@ void tcp_payload_flush(const struct ctx *c)
 
 	m = tap_send_frames(c, &tcp_l2_iov[0][0], TCP_NUM_IOVS,
 			    tcp_payload_used);
+	stats_latency(STATS_TO_TAP, STATS_TCP, m);
 	if (m != tcp_payload_used) {
 		tcp_revert_seq(c, &tcp_frame_conns[m], &tcp_l2_iov[m],
 			       tcp_payload_used - m);
@@ -195,7 +240,7 @@ int tcp_buf_send_flag(const struct ctx *c, struct tcp_tap_conn *conn, int flags)
 		dup_iov[TCP_IOV_PAYLOAD].iov_len = l4len;
 	}
 
-	if (tcp_payload_used > TCP_FRAMES_MEM - 2)
+	if (tcp_payload_used > tcp_frames - 2)
 		tcp_payload_flush(c);
 
 	return 0;
@@ -240,7 +285,7 @@ static void tcp_data_to_tap(const struct ctx *c, struct tcp_tap_conn *conn,
 	payload->th.ack = 1;
 	l4len = tcp_l2_buf_fill_headers(conn, iov, dlen, check, seq, false);
 	iov[TCP_IOV_PAYLOAD].iov_len = l4len;
-	if (++tcp_payload_used > TCP_FRAMES_MEM - 1)
+	if (++tcp_payload_used > tcp_frames - 1)
 		tcp_payload_flush(c);
 }
 
@@ -249,7 +294,8 @@ static void tcp_data_to_tap(const struct ctx *c, struct tcp_tap_conn *conn,
  * @c:		Execution context
  * @conn:	Connection pointer
  *
- * Return: negative on connection reset, 0 otherwise
+ * Return: negative on connection reset, 1 if we filled all the buffers and more
+ *	   data might be pending, 0 otherwise
  *
  * #syscalls recvmsg
  */
@@ -262,6 +308,7 @@ int tcp_buf_data_from_sock(const struct ctx *c, struct tcp_tap_conn *conn)
 	uint16_t mss = MSS_GET(conn);
 	uint32_t already_sent, seq;
 	struct iovec *iov;
+	size_t send_max;
 
 	/* How much have we read/sent since last received ack ? */
 	already_sent = conn->seq_to_tap - conn->seq_ack_from_tap;
@@ -284,13 +331,22 @@ int tcp_buf_data_from_sock(const struct ctx *c, struct tcp_tap_conn *conn)
 		return 0;
 	}
 
+	/* Don't exceed rate limits, wait until we can send a full segment */
+	send_max = MIN(wnd_scaled - already_sent,
+		       rate_avail(c, PIF_TAP, FLOW_IDX(conn)));
+	if (send_max < MIN(wnd_scaled - already_sent, mss)) {
+		conn_flag(c, conn, STALLED);
+		rate_throttled(FLOW_IDX(conn));
+		return 0;
+	}
+
 	/* Set up buffer descriptors we'll fill completely and partially. */
-	fill_bufs = DIV_ROUND_UP(wnd_scaled - already_sent, mss);
+	fill_bufs = DIV_ROUND_UP(send_max, mss);
 	if (fill_bufs > TCP_FRAMES) {
 		fill_bufs = TCP_FRAMES;
 		iov_rem = 0;
 	} else {
-		iov_rem = (wnd_scaled - already_sent) % mss;
+		iov_rem = send_max % mss;
 	}
 
 	/* Prepare iov according to kernel capability */
@@ -304,7 +360,7 @@ int tcp_buf_data_from_sock(const struct ctx *c, struct tcp_tap_conn *conn)
 		mh_sock.msg_iovlen = fill_bufs;
 	}
 
-	if (tcp_payload_used + fill_bufs > TCP_FRAMES_MEM) {
+	if (tcp_payload_used + fill_bufs > tcp_frames) {
 		tcp_payload_flush(c);
 
 		/* Silence Coverity CWE-125 false positive */
@@ -312,7 +368,7 @@ int tcp_buf_data_from_sock(const struct ctx *c, struct tcp_tap_conn *conn)
 	}
 
 	for (i = 0, iov = iov_sock + 1; i < fill_bufs; i++, iov++) {
-		iov->iov_base = &tcp_payload[tcp_payload_used + i].data;
+		iov->iov_base = &tcp_frame(tcp_payload_used + i)->data;
 		iov->iov_len = mss;
 	}
 	if (iov_rem)
@@ -355,8 +411,10 @@ int tcp_buf_data_from_sock(const struct ctx *c, struct tcp_tap_conn *conn)
 	}
 
 	conn_flag(c, conn, ~STALLED);
+	rate_consume(c, PIF_TAP, FLOW_IDX(conn), len);
 
 	send_bufs = DIV_ROUND_UP(len, mss);
+	stats_in(conn->f.pif[!TAPSIDE(conn)], STATS_TCP, send_bufs, len);
 	last_len = len - (send_bufs - 1) * mss;
 
 	/* Likely, some new data was acked too. */
@@ -377,5 +435,81 @@ int tcp_buf_data_from_sock(const struct ctx *c, struct tcp_tap_conn *conn)
 
 	conn_flag(c, conn, ACK_FROM_TAP_DUE);
 
-	return 0;
+	return (size_t)len == MIN(send_max, (size_t)fill_bufs * mss);
+}
+
+/**
+ * tcp_buf_retransmit() - Retransmit data at the start of the window to tap
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ * @len:	Length of data to retransmit, from @conn->seq_ack_from_tap
+ *
+ * Return: negative on connection reset, number of bytes queued otherwise
+ *
+ * #syscalls recvmsg
+ */
+int tcp_buf_retransmit(const struct ctx *c, struct tcp_tap_conn *conn,
+		       uint32_t len)
+{
+	uint32_t seq = conn->seq_ack_from_tap, seq_to_tap = conn->seq_to_tap;
+	struct msghdr mh_sock = { .msg_iov = &iov_sock[1] };
+	int fill_bufs, send_bufs, n, dlen, i, s = conn->sock;
+	uint16_t mss = MSS_GET(conn);
+	struct iovec *iov;
+
+	fill_bufs = DIV_ROUND_UP(len, mss);
+	if (fill_bufs > TCP_FRAMES) {
+		fill_bufs = TCP_FRAMES;
+		len = fill_bufs * mss;
+	}
+
+	if (tcp_payload_used + fill_bufs > tcp_frames) {
+		tcp_payload_flush(c);
+
+		/* Silence Coverity CWE-125 false positive */
+		tcp_payload_used = 0;
+	}
+
+	for (i = 0, iov = iov_sock + 1; i < fill_bufs; i++, iov++) {
+		iov->iov_base = &tcp_frame(tcp_payload_used + i)->data;
+		iov->iov_len = mss;
+	}
+	if (len % mss)
+		iov_sock[fill_bufs].iov_len = len % mss;
+	mh_sock.msg_iovlen = fill_bufs;
+
+	/* Peek from the beginning of the queue, then restore the offset */
+	if (tcp_set_peek_offset(s, 0))
+		goto reset;
+
+	do
+		n = recvmsg(s, &mh_sock, MSG_PEEK);
+	while (n < 0 && errno == EINTR);
+
+	if (tcp_set_peek_offset(s, seq_to_tap - seq))
+		goto reset;
+
+	if (n <= 0)
+		return 0;
+
+	send_bufs = DIV_ROUND_UP(n, mss);
+	for (i = 0; i < send_bufs; i++) {
+		int no_csum = i && i != send_bufs - 1 && tcp_payload_used;
+
+		dlen = (i == send_bufs - 1) ? n - i * mss : mss;
+		tcp_data_to_tap(c, conn, dlen, no_csum, seq);
+		seq += dlen;
+	}
+
+	/* tcp_data_to_tap() moved the sequence back to the end of the range we
+	 * retransmitted: restore it, so that we don't send the data after it
+	 * again. If sending frames fails later, tcp_revert_seq() rewinds it.
+	 */
+	conn->seq_to_tap = seq_to_tap;
+
+	return n;
+
+reset:
+	tcp_rst(c, conn);
+	return -1;
 }
@@ -13,10 +13,16 @@
  * struct tcp_tap_conn - Descriptor for a TCP connection (not spliced)
  * @f:			Generic flow information
  * @in_epoll:		Is the connection in the epoll set?
+ * @tap_sack:		Selective acknowledgements negotiated with tap/guest
+ * @sack_valid:		@seq_sack_from_tap holds a valid SACK left edge
+ * @sack_rexmit:	Data up to @seq_sack_from_tap was already retransmitted
+ * @ack_batch:		ACK to tap/guest deferred to the end of current tap batch
  * @retrans:		Number of retransmissions occurred due to ACK_TIMEOUT
  * @ws_from_tap:	Window scaling factor advertised from tap/guest
  * @ws_to_tap:		Window scaling factor advertised to tap/guest
  * @tap_mss:		MSS advertised by tap/guest, rounded to 2 ^ TCP_MSS_BITS
+ * @ack_segs:		Data segments from tap/guest not acknowledged yet
+ * @ack_delay:		Delayed ACK interval to tap/guest in ms, 0 if unknown
  * @sock:		Socket descriptor number
  * @events:		Connection events, implying connection states
  * @timer:		timerfd descriptor for timeout events
@@ -30,12 +36,19 @@
  * @seq_from_tap:	Next sequence for packets from tap (not actually sent)
  * @seq_ack_to_tap:	Last ACK number sent to tap
  * @seq_init_from_tap:	Initial sequence number from tap
+ * @seq_sack_from_tap:	Lowest left edge of SACK blocks from tap, see above
+ * @ofo_head:		First block of out-of-order data from tap, see tcp_ofo.c
+ * @ofo_count:		Number of blocks of out-of-order data from tap
  */
 struct tcp_tap_conn {
 	/* Must be first element */
 	struct flow_common f;
 
 	bool		in_epoll	:1;
+	bool		tap_sack	:1;
+	bool		sack_valid	:1;
+	bool		sack_rexmit	:1;
+	bool		ack_batch	:1;
 
 #define TCP_RETRANS_BITS		3
 	unsigned int	retrans		:TCP_RETRANS_BITS;
@@ -51,6 +64,14 @@ struct tcp_tap_conn {
 #define MSS_SET(conn, mss)	(conn->tap_mss = (mss >> (16 - TCP_MSS_BITS)))
 #define MSS_GET(conn)		(conn->tap_mss << (16 - TCP_MSS_BITS))
 
+#define TCP_ACK_SEGS_BITS		4
+	unsigned int	ack_segs	:TCP_ACK_SEGS_BITS;
+#define TCP_ACK_SEGS_MAX		MAX_FROM_BITS(TCP_ACK_SEGS_BITS)
+
+#define TCP_ACK_DELAY_BITS		4
+	unsigned int	ack_delay	:TCP_ACK_DELAY_BITS;
+#define TCP_ACK_DELAY_MAX		MAX_FROM_BITS(TCP_ACK_DELAY_BITS)
+
 	int		sock		:FD_REF_BITS;
 
 	uint8_t		events;
@@ -93,6 +114,10 @@ struct tcp_tap_conn {
 	uint32_t	seq_from_tap;
 	uint32_t	seq_ack_to_tap;
 	uint32_t	seq_init_from_tap;
+	uint32_t	seq_sack_from_tap;
+
+	uint16_t	ofo_head;
+	uint16_t	ofo_count;
 };
 
 /**
@@ -104,7 +129,9 @@ struct tcp_tap_conn {
  * @written:		Bytes written (not fully written from one other side read)
  * @events:		Events observed/actions performed on connection
  * @flags:		Connection flags (attributes, not events)
+ * @pipe_shift:		Pipe size for each side, as MIN_PIPE_SIZE shifted left
  * @in_epoll:		Is the connection in the epoll set?
+ * @pipe_act:		Pipe used since last timer, by side, as BIT(sidei)
  */
 struct tcp_splice_conn {
 	/* Must be first element */
@@ -128,8 +155,12 @@ struct tcp_splice_conn {
 #define RCVLOWAT_SET(sidei_)		((sidei_) ? BIT(1) : BIT(0))
 #define RCVLOWAT_ACT(sidei_)		((sidei_) ? BIT(3) : BIT(2))
 #define CLOSING				BIT(4)
+#define OFFLOAD				BIT(5)
+
+	uint8_t pipe_shift[SIDES];
 
 	bool in_epoll	:1;
+	uint8_t pipe_act :2;
 };
 
 /* Socket pools */
@@ -139,6 +170,7 @@ extern int init_sock_pool4	[TCP_SOCK_POOL_SIZE];
 extern int init_sock_pool6	[TCP_SOCK_POOL_SIZE];
 
 bool tcp_flow_defer(const struct tcp_tap_conn *conn);
+void tcp_data_resume(const struct ctx *c, struct tcp_tap_conn *conn);
 bool tcp_splice_flow_defer(struct tcp_splice_conn *conn);
 void tcp_splice_timer(const struct ctx *c, struct tcp_splice_conn *conn);
 int tcp_conn_pool_sock(int pool[]);
@@ -38,6 +38,8 @@
 #define OPT_SACK	5
 #define OPT_TS		8
 
+#define TCP_OPTLEN_MAX	40
+
 #define TAPSIDE(conn_)	((conn_)->f.pif[1] == PIF_TAP)
 #define TAPFLOW(conn_)	(&((conn_)->f.side[TAPSIDE(conn_)]))
 #define TAP_SIDX(conn_)	(FLOW_SIDX((conn_), TAPSIDE(conn_)))
@@ -117,22 +119,44 @@ struct tcp_opt_ws {
 		.shift = (shift_),			\
 	})
 
+/** struct tcp_opt_sackp - TCP SACK Permitted option
+ * @kind:	Option kind (OPT_SACKP == 4)
+ * @len:	Option length (2)
+ */
+struct tcp_opt_sackp {
+	uint8_t kind;
+	uint8_t len;
+} __attribute__ ((packed));
+#define TCP_OPT_SACKP					\
+	((struct tcp_opt_sackp) {			\
+		.kind = OPT_SACKP,			\
+		.len = sizeof(struct tcp_opt_sackp),	\
+	})
+
 /** struct tcp_syn_opts - TCP options we apply to SYN packets
  * @mss:	Maximum Segment Size (MSS) option
  * @nop:	NOP opt (for alignment)
  * @ws:		Window Scaling (WS) option
+ * @nop_sackp:	NOP opts (for alignment)
+ * @sackp:	SACK Permitted option, last, omitted if SACK is not used
  */
 struct tcp_syn_opts {
 	struct tcp_opt_mss mss;
 	struct tcp_opt_nop nop;
 	struct tcp_opt_ws ws;
+	struct tcp_opt_nop nop_sackp[2];
+	struct tcp_opt_sackp sackp;
 } __attribute__ ((packed));
 #define TCP_SYN_OPTS(mss_, ws_)				\
 	((struct tcp_syn_opts){				\
 		.mss = TCP_OPT_MSS(mss_),		\
 		.nop = TCP_OPT_NOP,			\
 		.ws = TCP_OPT_WS(ws_),			\
+		.nop_sackp = { TCP_OPT_NOP, TCP_OPT_NOP }, \
+		.sackp = TCP_OPT_SACKP,			\
 	})
+#define TCP_SYN_OPTS_NO_SACK_LEN			\
+	offsetof(struct tcp_syn_opts, nop_sackp)
 
 extern char tcp_buf_discard [MAX_WINDOW];
 
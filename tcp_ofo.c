@@ -0,0 +1,290 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Out-of-order queue for data from tap/guest
+ *
+ * Segments received from the guest after a hole in the sequence used to be
+ * discarded, and the guest had to retransmit them, possibly after a full
+ * retransmission timeout. We now copy them to fixed-size blocks from a static
+ * arena, linked in per-connection lists sorted by sequence, and write them to
+ * the socket as soon as the hole is filled. Queued ranges are reported back to
+ * the guest as SACK blocks, if negotiated.
+ *
+ * The arena is capped globally, and each connection can only use a fraction of
+ * it: past either limit, segments are discarded as before.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/uio.h>
+
+#include "util.h"
+#include "ip.h"
+#include "passt.h"
+#include "siphash.h"
+#include "inany.h"
+#include "flow.h"
+#include "tcp_conn.h"
+#include "tcp_internal.h"
+#include "tcp_ofo.h"
+
+/**
+ * struct tcp_ofo_block - Descriptor for a block of queued data
+ * @seq:	Sequence of first queued byte, host order
+ * @len:	Length of queued data
+ * @off:	Offset of first queued byte in data block
+ * @next:	Next block for the same connection, or in free list
+ * @stamp:	Value of tcp_ofo_rx when data in the block was last received
+ */
+static struct tcp_ofo_block {
+	uint32_t seq;
+	uint16_t len;
+	uint16_t off;
+	uint16_t next;
+	uint32_t stamp;
+} tcp_ofo_block[TCP_OFO_BLOCKS + 1];	/* Index 0 is TCP_OFO_NONE */
+
+static char tcp_ofo_data[TCP_OFO_BLOCKS + 1][TCP_OFO_BLOCK];
+
+static uint16_t tcp_ofo_free;		/* Head of list of released blocks */
+static uint16_t tcp_ofo_used;		/* Blocks ever used, from the arena */
+static uint32_t tcp_ofo_rx;		/* Segments queued, for SACK order */
+
+/**
+ * tcp_ofo_alloc() - Get a free block
+ *
+ * Return: block index, TCP_OFO_NONE if the arena is exhausted
+ */
+static uint16_t tcp_ofo_alloc(void)
+{
+	uint16_t b = tcp_ofo_free;
+
+	if (b) {
+		tcp_ofo_free = tcp_ofo_block[b].next;
+		return b;
+	}
+
+	if (tcp_ofo_used < TCP_OFO_BLOCKS)
+		return ++tcp_ofo_used;
+
+	return TCP_OFO_NONE;
+}
+
+/**
+ * tcp_ofo_release() - Return block to free list
+ * @b:		Block index
+ *
+ * Return: index of next block for the same connection
+ */
+static uint16_t tcp_ofo_release(uint16_t b)
+{
+	uint16_t next = tcp_ofo_block[b].next;
+
+	tcp_ofo_block[b].next = tcp_ofo_free;
+	tcp_ofo_free = b;
+
+	return next;
+}
+
+/**
+ * tcp_ofo_queue() - Queue out-of-order data, skipping data already queued
+ * @conn:	Connection pointer
+ * @seq:	Sequence of first byte, host order
+ * @data:	Segment payload
+ * @len:	Length of payload
+ *
+ * Return: number of bytes queued, might be less than @len if limits are hit
+ */
+size_t tcp_ofo_queue(struct tcp_tap_conn *conn, uint32_t seq,
+		     const char *data, size_t len)
+{
+	uint16_t *prev = &conn->ofo_head;
+	uint32_t stamp = ++tcp_ofo_rx;
+	size_t queued = 0;
+
+	while (len) {
+		struct tcp_ofo_block *b;
+		uint16_t new;
+		size_t n;
+
+		/* Skip blocks ending before this byte */
+		while (*prev && SEQ_LE(tcp_ofo_block[*prev].seq +
+				       tcp_ofo_block[*prev].len, seq))
+			prev = &tcp_ofo_block[*prev].next;
+
+		b = &tcp_ofo_block[*prev];
+		if (*prev && SEQ_LE(b->seq, seq)) {
+			/* Already queued: skip overlapping part */
+			n = MIN(len, b->seq + b->len - seq);
+			b->stamp = stamp;
+			seq += n;
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		n = MIN(len, TCP_OFO_BLOCK);
+		if (*prev)
+			n = MIN(n, b->seq - seq);
+
+		if (conn->ofo_count >= TCP_OFO_CONN_BLOCKS ||
+		    !(new = tcp_ofo_alloc()))
+			break;
+
+		b = &tcp_ofo_block[new];
+		b->seq = seq;
+		b->len = n;
+		b->off = 0;
+		b->next = *prev;
+		b->stamp = stamp;
+		memcpy(tcp_ofo_data[new], data, n);
+
+		*prev = new;
+		prev = &b->next;
+		conn->ofo_count++;
+
+		seq += n;
+		data += n;
+		len -= n;
+		queued += n;
+	}
+
+	return queued;
+}
+
+/**
+ * tcp_ofo_iov() - Point iovec entries to queued data in sequence
+ * @conn:	Connection pointer
+ * @seq:	Next expected sequence, updated to end of data in @iov
+ * @iov:	iovec array to fill
+ * @cnt:	Number of entries available in @iov
+ *
+ * Return: number of @iov entries used
+ */
+int tcp_ofo_iov(const struct tcp_tap_conn *conn, uint32_t *seq,
+		struct iovec *iov, int cnt)
+{
+	uint16_t i = conn->ofo_head;
+	int n = 0;
+
+	for (; i && n < cnt; i = tcp_ofo_block[i].next) {
+		const struct tcp_ofo_block *b = &tcp_ofo_block[i];
+		uint32_t skip = *seq - b->seq;
+
+		if (SEQ_LE(b->seq + b->len, *seq))
+			continue;
+
+		if (SEQ_GT(b->seq, *seq))
+			break;
+
+		iov[n].iov_base = tcp_ofo_data[i] + b->off + skip;
+		iov[n].iov_len = b->len - skip;
+		*seq += iov[n].iov_len;
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * tcp_ofo_consume() - Release queued data before a given sequence
+ * @conn:	Connection pointer
+ * @seq:	Sequence of first byte we still need, host order
+ */
+void tcp_ofo_consume(struct tcp_tap_conn *conn, uint32_t seq)
+{
+	while (conn->ofo_head) {
+		struct tcp_ofo_block *b = &tcp_ofo_block[conn->ofo_head];
+
+		if (SEQ_GT(b->seq + b->len, seq)) {
+			uint32_t n = SEQ_LT(b->seq, seq) ? seq - b->seq : 0;
+
+			b->seq += n;
+			b->off += n;
+			b->len -= n;
+			return;
+		}
+
+		conn->ofo_head = tcp_ofo_release(conn->ofo_head);
+		conn->ofo_count--;
+	}
+}
+
+/**
+ * tcp_ofo_drop() - Release all queued data for a connection being closed
+ * @conn:	Connection pointer
+ */
+void tcp_ofo_drop(const struct tcp_tap_conn *conn)
+{
+	uint16_t i = conn->ofo_head;
+
+	while (i)
+		i = tcp_ofo_release(i);
+}
+
+/**
+ * tcp_ofo_sack() - Write SACK option describing queued data
+ * @conn:	Connection pointer
+ * @opts:	Buffer for TCP options, at least TCP_OPTLEN_MAX bytes
+ *
+ * As required by RFC 2018, Section 4, the first SACK block covers the most
+ * recently received segment, and further blocks follow by recency.
+ *
+ * Return: length of options written, 0 if nothing is queued
+ */
+size_t tcp_ofo_sack(const struct tcp_tap_conn *conn, char *opts)
+{
+	struct {
+		uint32_t left;
+		uint32_t right;
+		uint32_t stamp;
+	} r[TCP_OFO_CONN_BLOCKS];
+	uint32_t edges[TCP_OFO_SACK_MAX * 2];
+	uint16_t i = conn->ofo_head;
+	int n = 0, k, j;
+
+	if (!i)
+		return 0;
+
+	for (; i && n < TCP_OFO_CONN_BLOCKS; i = tcp_ofo_block[i].next) {
+		const struct tcp_ofo_block *b = &tcp_ofo_block[i];
+
+		/* Merge contiguous blocks into the same SACK block */
+		if (n && r[n - 1].right == b->seq) {
+			r[n - 1].right = b->seq + b->len;
+			if ((int32_t)(b->stamp - r[n - 1].stamp) > 0)
+				r[n - 1].stamp = b->stamp;
+			continue;
+		}
+
+		r[n].left = b->seq;
+		r[n].right = b->seq + b->len;
+		r[n].stamp = b->stamp;
+		n++;
+	}
+
+	/* Partial selection sort, most recent first */
+	for (k = 0; k < n && k < TCP_OFO_SACK_MAX; k++) {
+		int last = k;
+
+		for (j = k + 1; j < n; j++) {
+			if ((int32_t)(r[j].stamp - r[last].stamp) > 0)
+				last = j;
+		}
+
+		edges[k * 2] = htonl(r[last].left);
+		edges[k * 2 + 1] = htonl(r[last].right);
+		r[last] = r[k];
+	}
+
+	opts[0] = opts[1] = OPT_NOP;
+	opts[2] = OPT_SACK;
+	opts[3] = 2 + k * sizeof(uint32_t) * 2;
+	memcpy(opts + 4, edges, k * sizeof(uint32_t) * 2);
+
+	return 4 + k * sizeof(uint32_t) * 2;
+}
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Out-of-order queue for data from tap/guest
+ */
+
+#ifndef TCP_OFO_H
+#define TCP_OFO_H
+
+#define TCP_OFO_NONE		0
+#define TCP_OFO_BLOCK		4096	/* Bytes per block */
+#define TCP_OFO_BLOCKS		1024	/* Global cap: 4 MiB */
+#define TCP_OFO_CONN_BLOCKS	256	/* Per-connection cap: 1 MiB */
+#define TCP_OFO_SACK_MAX	4	/* SACK blocks fitting in 40 bytes */
+
+size_t tcp_ofo_queue(struct tcp_tap_conn *conn, uint32_t seq,
+		     const char *data, size_t len);
+int tcp_ofo_iov(const struct tcp_tap_conn *conn, uint32_t *seq,
+		struct iovec *iov, int cnt);
+void tcp_ofo_consume(struct tcp_tap_conn *conn, uint32_t seq);
+void tcp_ofo_drop(const struct tcp_tap_conn *conn);
+size_t tcp_ofo_sack(const struct tcp_tap_conn *conn, char *opts);
+
+#endif /* TCP_OFO_H */
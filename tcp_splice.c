@@ -28,6 +28,15 @@
  * - FIN_SENT_0:		FIN (write shutdown) sent to accepted socket
  * - FIN_SENT_1:		FIN (write shutdown) sent to target socket
  *
+ * Pipes are taken from a pool of pre-opened ones, with a small size, only once
+ * there's data to move in the given direction. If a read fills most of the
+ * pipe, the pipe is doubled in size, up to the maximum size probed at start,
+ * and pipes which saw no activity for a whole timer interval are shrunk and
+ * returned to the pool, so that idle connections don't pin pipe memory.
+ *
+ * With --splice-offload, data is forwarded by the kernel instead, see
+ * sockmap.c, and we only handle connection setup and shutdown.
+ *
  * #syscalls:pasta pipe2|pipe fcntl arm:fcntl64 ppc64:fcntl64 i686:fcntl64
  */
 
@@ -45,8 +54,10 @@
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <linux/sockios.h>
 
 #include "util.h"
 #include "ip.h"
@@ -56,10 +67,15 @@
 #include "siphash.h"
 #include "inany.h"
 #include "flow.h"
+#include "sockmap.h"
+#include "linux_dep.h"
 
 #include "flow_table.h"
+#include "stats.h"
+#include "usdt.h"
 
 #define MAX_PIPE_SIZE			(8UL * 1024 * 1024)
+#define MIN_PIPE_SIZE			(64UL * 1024)
 #define TCP_SPLICE_PIPE_POOL_SIZE	32
 #define TCP_SPLICE_CONN_PRESSURE	30	/* % of conn_count */
 #define TCP_SPLICE_FILE_PRESSURE	30	/* % of c->nofile */
@@ -83,8 +99,8 @@ static const char *tcp_splice_event_str[] __attribute((__unused__)) = {
 
 /* Display strings for connection flags */
 static const char *tcp_splice_flag_str[] __attribute((__unused__)) = {
-	"SPLICE_V6", "RCVLOWAT_SET_0", "RCVLOWAT_SET_1", "RCVLOWAT_ACT_0",
-	"RCVLOWAT_ACT_1", "CLOSING",
+	"RCVLOWAT_SET_0", "RCVLOWAT_SET_1", "RCVLOWAT_ACT_0", "RCVLOWAT_ACT_1",
+	"CLOSING", "OFFLOAD",
 };
 
 /* Forward declaration */
@@ -112,9 +128,10 @@ static struct tcp_splice_conn *conn_at_sidx(flow_sidx_t sidx)
 /**
  * tcp_splice_conn_epoll_events() - epoll events masks for given state
  * @events:	Connection event flags
+ * @flags:	Connection flags
  * @ev:		Events to fill in, 0 is accepted socket, 1 is connecting socket
  */
-static void tcp_splice_conn_epoll_events(uint16_t events,
+static void tcp_splice_conn_epoll_events(uint16_t events, uint8_t flags,
 					 struct epoll_event ev[])
 {
 	unsigned sidei;
@@ -124,6 +141,12 @@ static void tcp_splice_conn_epoll_events(uint16_t events,
 
 	if (events & SPLICE_ESTABLISHED) {
 		flow_foreach_sidei(sidei) {
+			/* With kernel forwarding, there's nothing to read after
+			 * end of file: don't get stuck on EPOLLIN
+			 */
+			if ((flags & OFFLOAD) && (events & FIN_RCVD(sidei)))
+				continue;
+
 			if (!(events & FIN_SENT(!sidei)))
 				ev[sidei].events = EPOLLIN | EPOLLRDHUP;
 		}
@@ -155,7 +178,7 @@ static int tcp_splice_epoll_ctl(const struct ctx *c,
 	struct epoll_event ev[SIDES] = { { .data.u64 = ref[0].u64 },
 					 { .data.u64 = ref[1].u64 } };
 
-	tcp_splice_conn_epoll_events(conn->events, ev);
+	tcp_splice_conn_epoll_events(conn->events, conn->flags, ev);
 
 	if (epoll_ctl(c->epollfd, m, conn->s[0], &ev[0]) ||
 	    epoll_ctl(c->epollfd, m, conn->s[1], &ev[1])) {
@@ -199,6 +222,8 @@ static void conn_flag_do(const struct ctx *c, struct tcp_splice_conn *conn,
 			flow_dbg(conn, "%s", tcp_splice_flag_str[flag_index]);
 	}
 
+	USDT3(splice_flag, FLOW_IDX(conn), flag, conn->flags);
+
 	if (flag == CLOSING) {
 		epoll_ctl(c->epollfd, EPOLL_CTL_DEL, conn->s[0], NULL);
 		epoll_ctl(c->epollfd, EPOLL_CTL_DEL, conn->s[1], NULL);
@@ -240,6 +265,8 @@ static void conn_event_do(const struct ctx *c, struct tcp_splice_conn *conn,
 			flow_dbg(conn, "%s", tcp_splice_event_str[flag_index]);
 	}
 
+	USDT3(splice_event, FLOW_IDX(conn), event, conn->events);
+
 	if (tcp_splice_epoll_ctl(c, conn))
 		conn_flag(c, conn, CLOSING);
 }
@@ -288,50 +315,116 @@ bool tcp_splice_flow_defer(struct tcp_splice_conn *conn)
 }
 
 /**
- * tcp_splice_connect_finish() - Completion of connect() or call on success
- * @c:		Execution context
+ * tcp_splice_pipe_get() - Get a pipe for one direction, from pool if possible
  * @conn:	Connection pointer
+ * @sidei:	Side we read from, for this pipe
  *
  * Return: 0 on success, -EIO on failure
  */
-static int tcp_splice_connect_finish(const struct ctx *c,
-				     struct tcp_splice_conn *conn)
+static int tcp_splice_pipe_get(struct tcp_splice_conn *conn, unsigned sidei)
 {
-	unsigned sidei;
-	int i = 0;
+	int i;
 
-	flow_foreach_sidei(sidei) {
-		for (; i < TCP_SPLICE_PIPE_POOL_SIZE; i++) {
-			if (splice_pipe_pool[i][0] >= 0) {
-				SWAP(conn->pipe[sidei][0],
-				     splice_pipe_pool[i][0]);
-				SWAP(conn->pipe[sidei][1],
-				     splice_pipe_pool[i][1]);
-				break;
-			}
+	conn->pipe_shift[sidei] = 0;
+
+	for (i = 0; i < TCP_SPLICE_PIPE_POOL_SIZE; i++) {
+		if (splice_pipe_pool[i][0] >= 0) {
+			SWAP(conn->pipe[sidei][0], splice_pipe_pool[i][0]);
+			SWAP(conn->pipe[sidei][1], splice_pipe_pool[i][1]);
+			return 0;
 		}
+	}
 
-		if (conn->pipe[sidei][0] < 0) {
-			if (pipe2(conn->pipe[sidei], O_NONBLOCK | O_CLOEXEC)) {
-				flow_err(conn, "cannot create %d->%d pipe: %s",
-					 sidei, !sidei, strerror(errno));
-				conn_flag(c, conn, CLOSING);
-				return -EIO;
-			}
+	if (pipe2(conn->pipe[sidei], O_NONBLOCK | O_CLOEXEC)) {
+		flow_err(conn, "cannot create %d->%d pipe: %s",
+			 sidei, !sidei, strerror(errno));
+		return -EIO;
+	}
 
-			if (fcntl(conn->pipe[sidei][0], F_SETPIPE_SZ,
-				  c->tcp.pipe_size) != (int)c->tcp.pipe_size) {
-				flow_trace(conn,
-					   "cannot set %d->%d pipe size to %zu",
-					   sidei, !sidei, c->tcp.pipe_size);
-			}
+	if (fcntl(conn->pipe[sidei][0], F_SETPIPE_SZ,
+		  MIN_PIPE_SIZE) != (int)MIN_PIPE_SIZE) {
+		flow_trace(conn, "cannot set %d->%d pipe size to %lu",
+			   sidei, !sidei, MIN_PIPE_SIZE);
+	}
+
+	return 0;
+}
+
+/**
+ * tcp_splice_pipe_put() - Shrink empty pipe, return it to pool or close it
+ * @conn:	Connection pointer
+ * @sidei:	Side we read from, for this pipe
+ */
+static void tcp_splice_pipe_put(struct tcp_splice_conn *conn, unsigned sidei)
+{
+	int i;
+
+	if (conn->pipe_shift[sidei] &&
+	    fcntl(conn->pipe[sidei][0], F_SETPIPE_SZ,
+		  MIN_PIPE_SIZE) != (int)MIN_PIPE_SIZE)
+		goto close;
+
+	/* Free slots precede pre-opened pipes in the pool, see
+	 * tcp_splice_pipe_refill(): use the last free one
+	 */
+	for (i = TCP_SPLICE_PIPE_POOL_SIZE - 1; i >= 0; i--) {
+		if (splice_pipe_pool[i][0] < 0) {
+			SWAP(conn->pipe[sidei][0], splice_pipe_pool[i][0]);
+			SWAP(conn->pipe[sidei][1], splice_pipe_pool[i][1]);
+			flow_trace(conn, "%d->%d pipe back to pool",
+				   sidei, !sidei);
+			return;
 		}
 	}
 
+close:
+	close(conn->pipe[sidei][0]);
+	close(conn->pipe[sidei][1]);
+	conn->pipe[sidei][0] = conn->pipe[sidei][1] = -1;
+}
+
+/**
+ * tcp_splice_pipe_grow() - Double pipe size, up to probed maximum
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ * @sidei:	Side we read from, for this pipe
+ *
+ * Return: new pipe size, or current one if it can't grow further
+ */
+static size_t tcp_splice_pipe_grow(const struct ctx *c,
+				   struct tcp_splice_conn *conn, unsigned sidei)
+{
+	size_t size = MIN_PIPE_SIZE << (conn->pipe_shift[sidei] + 1);
+
+	if (size > c->tcp.pipe_size)
+		return size / 2;
+
+	if (fcntl(conn->pipe[sidei][0], F_SETPIPE_SZ, size) != (int)size) {
+		flow_trace(conn, "cannot grow %d->%d pipe to %zu",
+			   sidei, !sidei, size);
+		return size / 2;
+	}
+
+	conn->pipe_shift[sidei]++;
+	flow_trace(conn, "%d->%d pipe size now %zu", sidei, !sidei, size);
+
+	return size;
+}
+
+/**
+ * tcp_splice_connect_finish() - Completion of connect() or call on success
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ */
+static void tcp_splice_connect_finish(const struct ctx *c,
+				      struct tcp_splice_conn *conn)
+{
+	/* No need for pipes if the kernel forwards data for us */
+	if (c->tcp.splice_offload && !sockmap_add(conn->s[0], conn->s[1]))
+		conn_flag(c, conn, OFFLOAD);
+
 	if (!(conn->events & SPLICE_ESTABLISHED))
 		conn_event(c, conn, SPLICE_ESTABLISHED);
-
-	return 0;
 }
 
 /**
@@ -377,7 +470,7 @@ static int tcp_splice_connect(const struct ctx *c, struct tcp_splice_conn *conn)
 		conn_event(c, conn, SPLICE_CONNECT);
 	} else {
 		conn_event(c, conn, SPLICE_ESTABLISHED);
-		return tcp_splice_connect_finish(c, conn);
+		tcp_splice_connect_finish(c, conn);
 	}
 
 	return 0;
@@ -441,6 +534,59 @@ void tcp_splice_conn_from_sock(const struct ctx *c, union flow *flow, int s0)
 	FLOW_ACTIVATE(conn);
 }
 
+/**
+ * tcp_splice_offload_shutdown() - Forward FINs if kernel forwards data
+ * @c:		Execution context
+ * @conn:	Connection pointer
+ *
+ * Data is moved to the output socket asynchronously, so we can't shut it down
+ * as soon as we see end of file on the other side: wait until all the data we
+ * received there is queued for sending (or acknowledged), and check again from
+ * tcp_splice_timer() otherwise. The output socket is writable all along, so
+ * waiting for EPOLLOUT would just wake us up over and over.
+ *
+ * Return: 0 on success, -1 on failure to get socket information
+ *
+ * #syscalls:pasta ioctl
+ */
+static int tcp_splice_offload_shutdown(const struct ctx *c,
+				       struct tcp_splice_conn *conn)
+{
+	unsigned sidei;
+
+	flow_foreach_sidei(sidei) {
+		struct tcp_info_linux in, out;
+		socklen_t sl;
+		int outq;
+
+		if (!(conn->events & FIN_RCVD(sidei)) ||
+		    (conn->events & FIN_SENT(!sidei)))
+			continue;
+
+		sl = sizeof(in);
+		if (getsockopt(conn->s[sidei], SOL_TCP, TCP_INFO, &in, &sl))
+			return -1;
+
+		sl = sizeof(out);
+		if (getsockopt(conn->s[!sidei], SOL_TCP, TCP_INFO, &out, &sl))
+			return -1;
+
+		if (ioctl(conn->s[!sidei], SIOCOUTQ, &outq))
+			return -1;
+
+		/* Both counters include one sequence number for control flags:
+		 * FIN for received bytes, SYN for acknowledged ones.
+		 */
+		if (in.tcpi_bytes_received != out.tcpi_bytes_acked + outq)
+			continue;
+
+		shutdown(conn->s[!sidei], SHUT_WR);
+		conn_event(c, conn, FIN_SENT(!sidei));
+	}
+
+	return 0;
+}
+
 /**
  * tcp_splice_sock_handler() - Handler for socket mapped to spliced connection
  * @c:		Execution context
@@ -456,6 +602,7 @@ void tcp_splice_sock_handler(struct ctx *c, union epoll_ref ref,
 	unsigned evsidei = ref.flowside.sidei, fromsidei;
 	uint8_t lowat_set_flag, lowat_act_flag;
 	int eof, never_read;
+	size_t pipe_size;
 
 	ASSERT(conn->f.type == FLOW_TCP_SPLICE);
 
@@ -480,8 +627,7 @@ void tcp_splice_sock_handler(struct ctx *c, union epoll_ref ref,
 	if (conn->events == SPLICE_CONNECT) {
 		if (!(events & EPOLLOUT))
 			goto close;
-		if (tcp_splice_connect_finish(c, conn))
-			goto close;
+		tcp_splice_connect_finish(c, conn);
 	}
 
 	if (events & EPOLLOUT) {
@@ -495,10 +641,29 @@ void tcp_splice_sock_handler(struct ctx *c, union epoll_ref ref,
 		/* For side 0 this is fake, but implied */
 		conn_event(c, conn, FIN_RCVD(evsidei));
 
+	if (conn->flags & OFFLOAD) {
+		if (tcp_splice_offload_shutdown(c, conn))
+			goto close;
+
+		if (CONN_HAS(conn, FIN_SENT(0) | FIN_SENT(1)) ||
+		    (events & EPOLLHUP))
+			goto close;
+
+		return;
+	}
+
 swap:
 	eof = 0;
 	never_read = 1;
 
+	if (conn->pipe[fromsidei][0] < 0 &&
+	    tcp_splice_pipe_get(conn, fromsidei))
+		goto close;
+
+	pipe_size = MIN_PIPE_SIZE << conn->pipe_shift[fromsidei];
+	/* Not a flag: conn_flag() would log this on every transfer */
+	conn->pipe_act |= BIT(fromsidei);
+
 	lowat_set_flag = RCVLOWAT_SET(fromsidei);
 	lowat_act_flag = RCVLOWAT_ACT(fromsidei);
 
@@ -508,8 +673,7 @@ swap:
 
 retry:
 		readlen = splice(conn->s[fromsidei], NULL,
-				 conn->pipe[fromsidei][1], NULL,
-				 c->tcp.pipe_size,
+				 conn->pipe[fromsidei][1], NULL, pipe_size,
 				 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
 		flow_trace(conn, "%zi from read-side call", readlen);
 		if (readlen < 0) {
@@ -523,28 +687,36 @@ retry:
 		} else {
 			never_read = 0;
 
-			if (readlen >= (long)c->tcp.pipe_size * 90 / 100)
+			if (readlen >= (long)pipe_size * 90 / 100) {
 				more = SPLICE_F_MORE;
+				pipe_size = tcp_splice_pipe_grow(c, conn,
+								 fromsidei);
+			}
 
 			if (conn->flags & lowat_set_flag)
 				conn_flag(c, conn, lowat_act_flag);
 		}
 
+		/* Nothing new, and the pipe is empty: skip write-side call */
+		if (readlen <= 0 &&
+		    conn->read[fromsidei] == conn->written[fromsidei])
+			break;
+
 eintr:
 		written = splice(conn->pipe[fromsidei][0], NULL,
-				 conn->s[!fromsidei], NULL, c->tcp.pipe_size,
+				 conn->s[!fromsidei], NULL, pipe_size,
 				 SPLICE_F_MOVE | more | SPLICE_F_NONBLOCK);
 		flow_trace(conn, "%zi from write-side call (passed %zi)",
-			   written, c->tcp.pipe_size);
+			   written, pipe_size);
 
 		/* Most common case: skip updating counters. */
 		if (readlen > 0 && readlen == written) {
-			if (readlen >= (long)c->tcp.pipe_size * 10 / 100)
+			if (readlen >= (long)pipe_size * 10 / 100)
 				continue;
 
 			if (conn->flags & lowat_set_flag &&
-			    readlen > (long)c->tcp.pipe_size / 10) {
-				int lowat = c->tcp.pipe_size / 4;
+			    readlen > (long)pipe_size / 10) {
+				int lowat = pipe_size / 4;
 
 				if (setsockopt(conn->s[fromsidei], SOL_SOCKET,
 					       SO_RCVLOWAT,
@@ -563,6 +735,7 @@ eintr:
 
 		conn->read[fromsidei]    += readlen > 0 ? readlen : 0;
 		conn->written[fromsidei] += written > 0 ? written : 0;
+		stats.splice_bytes += written > 0 ? written : 0;
 
 		if (written < 0) {
 			if (errno == EINTR)
@@ -578,7 +751,7 @@ eintr:
 			break;
 		}
 
-		if (never_read && written == (long)(c->tcp.pipe_size))
+		if (never_read && written == (long)pipe_size)
 			goto retry;
 
 		pending = conn->read[fromsidei] - conn->written[fromsidei];
@@ -621,7 +794,7 @@ close:
 }
 
 /**
- * tcp_set_pipe_size() - Set usable pipe size, probe starting from MAX_PIPE_SIZE
+ * tcp_set_pipe_size() - Set maximum pipe size, probe starting from MAX_PIPE_SIZE
  * @c:		Execution context
  */
 static void tcp_set_pipe_size(struct ctx *c)
@@ -659,9 +832,8 @@ smaller:
 
 /**
  * tcp_splice_pipe_refill() - Refill pool of pre-opened pipes
- * @c:		Execution context
  */
-static void tcp_splice_pipe_refill(const struct ctx *c)
+static void tcp_splice_pipe_refill(void)
 {
 	int i;
 
@@ -672,9 +844,9 @@ static void tcp_splice_pipe_refill(const struct ctx *c)
 			continue;
 
 		if (fcntl(splice_pipe_pool[i][0], F_SETPIPE_SZ,
-			  c->tcp.pipe_size) != (int)c->tcp.pipe_size) {
-			trace("TCP (spliced): cannot set pool pipe size to %zu",
-			      c->tcp.pipe_size);
+			  MIN_PIPE_SIZE) != (int)MIN_PIPE_SIZE) {
+			trace("TCP (spliced): cannot set pool pipe size to %lu",
+			      MIN_PIPE_SIZE);
 		}
 	}
 }
@@ -718,7 +890,7 @@ void tcp_splice_refill(const struct ctx *c)
 	    (c->ifi6 && ns_sock_pool6[TCP_SOCK_POOL_TSH] < 0))
 		NS_CALL(tcp_sock_refill_ns, c);
 
-	tcp_splice_pipe_refill(c);
+	tcp_splice_pipe_refill();
 }
 
 /**
@@ -746,6 +918,14 @@ void tcp_splice_timer(const struct ctx *c, struct tcp_splice_conn *conn)
 
 	ASSERT(!(conn->flags & CLOSING));
 
+	if (conn->flags & OFFLOAD) {
+		if (tcp_splice_offload_shutdown(c, conn) ||
+		    CONN_HAS(conn, FIN_SENT(0) | FIN_SENT(1)))
+			conn_flag(c, conn, CLOSING);
+
+		return;
+	}
+
 	flow_foreach_sidei(sidei) {
 		if ((conn->flags & RCVLOWAT_SET(sidei)) &&
 		    !(conn->flags & RCVLOWAT_ACT(sidei))) {
@@ -760,4 +940,16 @@ void tcp_splice_timer(const struct ctx *c, struct tcp_splice_conn *conn)
 
 	flow_foreach_sidei(sidei)
 		conn_flag(c, conn, ~RCVLOWAT_ACT(sidei));
+
+	/* Release empty pipes we didn't use for a whole interval */
+	flow_foreach_sidei(sidei) {
+		if (conn->pipe[sidei][0] < 0)
+			continue;
+
+		if (!(conn->pipe_act & BIT(sidei)) &&
+		    conn->read[sidei] == conn->written[sidei])
+			tcp_splice_pipe_put(conn, sidei);
+	}
+
+	conn->pipe_act = 0;
 }
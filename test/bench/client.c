@@ -0,0 +1,454 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* client - Helpers for benchmarks acting as qemu
+ *
+ * Copyright Red Hat
+ *
+ * Start passt in foreground, connect to its UNIX domain socket, queue frames
+ * from the guest and read frames back, open sinks on the host loopback, and
+ * measure CPU cycles used by passt.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/perf_event.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "util.h"
+#include "checksum.h"
+#include "client.h"
+
+const uint8_t guest_mac[ETH_ALEN] = { 0x52, 0x54, 0, 0x12, 0x34, 0x56 };
+const uint8_t passt_mac[ETH_ALEN] = { 0x9a, 0x55, 0x9a, 0x55, 0x9a, 0x55 };
+
+uint8_t out_buf[OUT_BUF_BYTES];
+static uint8_t in_buf[IN_BUF_BYTES];
+static size_t in_fill;		/* Bytes of partial frame left in in_buf */
+
+/**
+ * now_ns() - Get current time from monotonic clock
+ *
+ * Return: nanoseconds
+ */
+uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * cpu_mhz() - Get nominal clock frequency from /proc/cpuinfo
+ *
+ * Return: frequency in MHz, 0 if not found
+ */
+static double cpu_mhz(void)
+{
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	char line[BUFSIZ];
+	double mhz = 0;
+
+	if (!f)
+		return 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "cpu MHz : %lf", &mhz) == 1)
+			break;
+	}
+
+	fclose(f);
+	return mhz;
+}
+
+/**
+ * cpu_time_ns() - Get CPU time of process
+ * @pid:	Process
+ * @ns:	CPU time in nanoseconds, set on return
+ *
+ * Use the CPU-time clock of the process, which includes the time of the current
+ * run, instead of /proc/PID/schedstat, only updated as the process is switched
+ * out or on scheduler ticks. Fall back to schedstat if the clock isn't
+ * available. Zero is a valid result, for a process that just started.
+ *
+ * Return: 0 on success, -1 on failure
+ */
+static int cpu_time_ns(pid_t pid, uint64_t *ns)
+{
+	unsigned long long sched_ns;
+	char path[PATH_MAX];
+	struct timespec ts;
+	clockid_t clk;
+	int rc = -1;
+	FILE *f;
+
+	if (!clock_getcpuclockid(pid, &clk) && !clock_gettime(clk, &ts)) {
+		*ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+		return 0;
+	}
+
+	snprintf(path, sizeof(path), "/proc/%i/schedstat", pid);
+	if (!(f = fopen(path, "r")))
+		return -1;
+
+	if (fscanf(f, "%llu", &sched_ns) == 1) {
+		*ns = sched_ns;
+		rc = 0;
+	}
+
+	fclose(f);
+	return rc;
+}
+
+/**
+ * meter_start() - Start measuring CPU usage of process
+ * @m:		Meter to set up
+ * @pid:	Process
+ */
+void meter_start(struct meter *m, pid_t pid)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_HARDWARE,
+		.size		= sizeof(attr),
+		.config		= PERF_COUNT_HW_CPU_CYCLES,
+		.exclude_hv	= 1,
+	};
+
+	m->pid = pid;
+	m->perf_fd = syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+	m->start = 0;
+
+	if (m->perf_fd < 0 || read(m->perf_fd, &m->start, sizeof(m->start)) !=
+			      sizeof(m->start)) {
+		if (m->perf_fd >= 0)
+			close(m->perf_fd);
+		m->perf_fd = -1;
+		m->mhz = cpu_time_ns(pid, &m->start) ? 0 : cpu_mhz();
+	}
+}
+
+/**
+ * meter_stop() - Stop measuring CPU usage of process
+ * @m:		Meter
+ * @estimated:	Set if cycles were estimated from CPU time
+ *
+ * Return: CPU cycles used by process, negative if not available
+ */
+double meter_stop(struct meter *m, bool *estimated)
+{
+	uint64_t end;
+
+	*estimated = false;
+
+	if (m->perf_fd >= 0) {
+		ssize_t n = read(m->perf_fd, &end, sizeof(end));
+
+		close(m->perf_fd);
+		return n == sizeof(end) ? (double)(end - m->start) : -1;
+	}
+
+	if (!m->mhz || cpu_time_ns(m->pid, &end))
+		return -1;
+
+	*estimated = true;
+	return (double)(end - m->start) * m->mhz / 1000;
+}
+
+/**
+ * passt_start() - Start passt in foreground, connect to it as qemu would
+ * @passt:	Path to passt binary
+ * @args:	Further options for passt, NULL-terminated
+ * @pid:	PID of passt, set on return
+ *
+ * Return: connected socket, -1 on failure
+ */
+int passt_start(const char *passt, const char *const *args, pid_t *pid)
+{
+	struct sockaddr_un a = { AF_UNIX, { 0 } };
+	const char *argv[64] = { passt, "-f", "-q", "-1", "-s", a.sun_path,
+				 "-a", GUEST_ADDR, "-n", "24", "-g", GW_ADDR,
+				 "--map-host-loopback", GW_ADDR };
+	static unsigned instance;
+	int s, i, n;
+
+	for (n = 0; argv[n]; n++)
+		;
+	while (*args && n < (int)ARRAY_SIZE(argv) - 1)
+		argv[n++] = *args++;
+
+	in_fill = 0;
+
+	snprintf(a.sun_path, sizeof(a.sun_path),
+		 "/tmp/passt_bench_%i_%u.socket", getpid(), instance++);
+	unlink(a.sun_path);
+
+	if (!(*pid = fork())) {
+		int fd = open("/dev/null", O_WRONLY);
+
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		execv(passt, (char *const *)argv);
+		_exit(EXIT_FAILURE);
+	}
+
+	if (*pid < 0)
+		return -1;
+
+	for (i = 0; i < 200; i++) {
+		if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+			return -1;
+
+		if (!connect(s, (struct sockaddr *)&a, sizeof(a))) {
+			fcntl(s, F_SETFL, O_NONBLOCK);
+			unlink(a.sun_path);
+			return s;
+		}
+
+		close(s);
+		if (waitpid(*pid, NULL, WNOHANG))
+			break;
+		usleep(10 * 1000);
+	}
+
+	fprintf(stderr, "Couldn't start %s, or connect to it\n", passt);
+	kill(*pid, SIGKILL);
+	waitpid(*pid, NULL, 0);
+	unlink(a.sun_path);
+	return -1;
+}
+
+/**
+ * passt_stop() - Terminate passt, close connection
+ * @s:		Socket connected to passt
+ * @pid:	PID of passt
+ */
+void passt_stop(int s, pid_t pid)
+{
+	close(s);
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+}
+
+/**
+ * sink_open() - Open sink socket on loopback, bound to ephemeral port
+ * @type:	SOCK_DGRAM or SOCK_STREAM, listening
+ * @port:	Bound port, host order, set on return
+ *
+ * Return: socket, -1 on failure
+ */
+int sink_open(int type, in_port_t *port)
+{
+	struct sockaddr_in a = { AF_INET, 0, { htonl(INADDR_LOOPBACK) }, { 0 } };
+	socklen_t sl = sizeof(a);
+	int s, v = 16 << 20;
+
+	if ((s = socket(AF_INET, type | SOCK_NONBLOCK, 0)) < 0)
+		return -1;
+
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, &v, sizeof(v));
+
+	if (bind(s, (struct sockaddr *)&a, sizeof(a)) ||
+	    getsockname(s, (struct sockaddr *)&a, &sl) ||
+	    (type == SOCK_STREAM && listen(s, SOMAXCONN))) {
+		close(s);
+		return -1;
+	}
+
+	*port = ntohs(a.sin_port);
+	return s;
+}
+
+/**
+ * frame_ip4() - Queue frame header, Ethernet and IPv4, from guest to gateway
+ * @o:		Output queue
+ * @proto:	Layer 4 protocol
+ * @l4len:	Length of layer 4 header and payload
+ *
+ * Return: pointer to layer 4 header in output buffer, NULL if full
+ */
+uint8_t *frame_ip4(struct out *o, uint8_t proto, size_t l4len)
+{
+	size_t l2len = ETH_HLEN + sizeof(struct iphdr) + l4len;
+	uint8_t *p = out_buf + o->len;
+	uint32_t vnet_len = htonl(l2len);
+	struct ethhdr *eh;
+	struct iphdr *iph;
+
+	if (o->len + sizeof(vnet_len) + l2len > sizeof(out_buf))
+		return NULL;
+
+	memcpy(p, &vnet_len, sizeof(vnet_len));
+	eh = (struct ethhdr *)(p + sizeof(vnet_len));
+	memcpy(eh->h_dest, passt_mac, ETH_ALEN);
+	memcpy(eh->h_source, guest_mac, ETH_ALEN);
+	eh->h_proto = htons(ETH_P_IP);
+
+	iph = (struct iphdr *)(eh + 1);
+	*iph = (struct iphdr){
+		.version	= 4,
+		.ihl		= 5,
+		.tot_len	= htons(sizeof(*iph) + l4len),
+		.frag_off	= htons(IP_DF),
+		.ttl		= 64,
+		.protocol	= proto,
+	};
+	inet_pton(AF_INET, GUEST_ADDR, &iph->saddr);
+	inet_pton(AF_INET, GW_ADDR, &iph->daddr);
+	iph->check = csum(iph, sizeof(*iph), 0);
+
+	o->len += sizeof(vnet_len) + l2len;
+	return (uint8_t *)(iph + 1);
+}
+
+/**
+ * tcp_send() - Queue TCP segment with no options from guest to passt
+ * @o:		Output queue
+ * @sport:	Source port, guest side
+ * @dport:	Destination port
+ * @seq:	Sequence number
+ * @ack:	Acknowledgement number
+ * @flags:	TCP flags, as in byte 13 of the header
+ * @data:	Payload, can be NULL
+ * @dlen:	Length of payload
+ */
+void tcp_send(struct out *o, in_port_t sport, in_port_t dport,
+	      uint32_t seq, uint32_t ack, uint8_t flags,
+	      const void *data, size_t dlen)
+{
+	struct in_addr saddr, daddr;
+	struct tcphdr *th;
+	uint32_t psum;
+
+	if (!(th = (struct tcphdr *)frame_ip4(o, IPPROTO_TCP,
+					      sizeof(*th) + dlen)))
+		return;
+
+	memset(th, 0, sizeof(*th));
+	th->source = htons(sport);
+	th->dest = htons(dport);
+	th->seq = htonl(seq);
+	th->ack_seq = htonl(ack);
+	th->doff = sizeof(*th) / 4;
+	((uint8_t *)th)[13] = flags;
+	th->window = htons(USHRT_MAX);
+	if (dlen)
+		memcpy(th + 1, data, dlen);
+
+	inet_pton(AF_INET, GUEST_ADDR, &saddr);
+	inet_pton(AF_INET, GW_ADDR, &daddr);
+	psum = proto_ipv4_header_psum(sizeof(*th) + dlen, IPPROTO_TCP,
+				      saddr, daddr);
+	th->check = csum(th, sizeof(*th) + dlen, psum);
+}
+
+/**
+ * out_write() - Write out queued frames, as much as passt takes
+ * @s:		Socket connected to passt
+ * @o:		Output queue
+ *
+ * Return: 0 on success, -1 on error
+ */
+int out_write(int s, struct out *o)
+{
+	ssize_t n;
+
+	if (o->off == o->len)
+		return 0;
+
+	n = write(s, out_buf + o->off, o->len - o->off);
+	if (n < 0)
+		return errno == EAGAIN ? 0 : -1;
+
+	o->off += n;
+	if (o->off == o->len) {
+		o->off = o->len = 0;
+	} else if (o->off > sizeof(out_buf) / 2) {
+		memmove(out_buf, out_buf + o->off, o->len - o->off);
+		o->len -= o->off;
+		o->off = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * in_read() - Read frames from passt, call handler for each complete one
+ * @s:		Socket connected to passt
+ * @handler:	Handler for frames, can be NULL
+ * @arg:	Opaque argument for handler
+ *
+ * Return: 0 on success, -1 on error or if passt closed the connection
+ */
+int in_read(int s, void (*handler)(const uint8_t *frame, size_t len, void *arg),
+	    void *arg)
+{
+	size_t off = 0;
+	ssize_t n;
+
+	n = read(s, in_buf + in_fill, sizeof(in_buf) - in_fill);
+	if (n < 0)
+		return errno == EAGAIN ? 0 : -1;
+	if (!n)
+		return -1;
+
+	in_fill += n;
+
+	while (in_fill - off >= sizeof(uint32_t)) {
+		uint32_t len;
+
+		memcpy(&len, in_buf + off, sizeof(len));
+		len = ntohl(len);
+
+		if (in_fill - off - sizeof(len) < len)
+			break;
+
+		if (handler)
+			handler(in_buf + off + sizeof(len), len, arg);
+		off += sizeof(len) + len;
+	}
+
+	memmove(in_buf, in_buf + off, in_fill - off);
+	in_fill -= off;
+	return 0;
+}
+
+/**
+ * frame_l4() - Get layer 4 header from IPv4 frame, if protocol matches
+ * @frame:	Frame from passt
+ * @len:	Length of frame
+ * @proto:	Expected protocol
+ * @l4len:	Length of layer 4 header and payload, set on return
+ *
+ * Return: pointer to layer 4 header, NULL if not matching
+ */
+const uint8_t *frame_l4(const uint8_t *frame, size_t len, uint8_t proto,
+			size_t *l4len)
+{
+	const struct ethhdr *eh = (const struct ethhdr *)frame;
+	const struct iphdr *iph = (const struct iphdr *)(eh + 1);
+
+	if (len < ETH_HLEN + sizeof(*iph) || eh->h_proto != htons(ETH_P_IP) ||
+	    iph->protocol != proto ||
+	    len < ETH_HLEN + iph->ihl * 4UL + sizeof(struct udphdr))
+		return NULL;
+
+	*l4len = len - ETH_HLEN - iph->ihl * 4;
+	return (const uint8_t *)iph + iph->ihl * 4;
+}
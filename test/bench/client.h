@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Helpers for benchmarks acting as qemu: start passt, exchange frames with it
+ */
+
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#define OUT_BUF_BYTES		(4UL << 20)
+#define IN_BUF_BYTES		(4UL << 20)
+
+#define GUEST_ADDR		"192.0.2.2"
+#define GW_ADDR			"192.0.2.1"	/* Mapped to host loopback */
+
+extern const uint8_t guest_mac[ETH_ALEN];
+extern const uint8_t passt_mac[ETH_ALEN];
+
+extern uint8_t out_buf[OUT_BUF_BYTES];
+
+/**
+ * struct meter - CPU usage of passt process
+ * @pid:	PID of passt
+ * @perf_fd:	perf event file descriptor for CPU cycles, -1 if not available
+ * @mhz:	Nominal clock frequency, MHz, 0 if unknown or without CPU time
+ * @start:	Cycles, or CPU time in nanoseconds, at start
+ */
+struct meter {
+	pid_t pid;
+	int perf_fd;
+	double mhz;
+	uint64_t start;
+};
+
+/**
+ * struct out - Output queue of frames to passt
+ * @len:	Bytes queued in out_buf
+ * @off:	Offset of first byte not written yet
+ */
+struct out {
+	size_t len;
+	size_t off;
+};
+
+uint64_t now_ns(void);
+void meter_start(struct meter *m, pid_t pid);
+double meter_stop(struct meter *m, bool *estimated);
+int passt_start(const char *passt, const char *const *args, pid_t *pid);
+void passt_stop(int s, pid_t pid);
+int sink_open(int type, in_port_t *port);
+uint8_t *frame_ip4(struct out *o, uint8_t proto, size_t l4len);
+void tcp_send(struct out *o, in_port_t sport, in_port_t dport,
+	      uint32_t seq, uint32_t ack, uint8_t flags,
+	      const void *data, size_t dlen);
+int out_write(int s, struct out *o);
+int in_read(int s, void (*handler)(const uint8_t *frame, size_t len, void *arg),
+	    void *arg);
+const uint8_t *frame_l4(const uint8_t *frame, size_t len, uint8_t proto,
+			size_t *l4len);
+
+#endif /* CLIENT_H */
@@ -0,0 +1,805 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* crr - Measure connection rate and flow table churn, without guests
+ *
+ * Copyright Red Hat
+ *
+ * Starts passt in foreground, connects to it as qemu would, and opens and
+ * closes short flows, CRR_CONCURRENT at a time, each with a single request and
+ * response (TCP_CRR in netperf terms):
+ *
+ * - tcp_out: from the guest to a sink listening on the host loopback, which
+ *   gets to tcp_conn_from_tap(). The guest sends a SYN, an ACK and a one-byte
+ *   request once the connection is established, and a FIN once the sink
+ *   replied with one byte and closed the connection
+ * - tcp_in: from the host to a port forwarded to the guest, which gets to
+ *   tcp_listen_handler(). The guest replies to each segment without keeping
+ *   any state: SYN, ACK to a SYN, response and FIN to a request, ACK to a FIN
+ * - udp: datagrams from the guest, each one from a new source port, or to a
+ *   new sink, echoed back by sinks on the host loopback. As flows expire only
+ *   after minutes, the flow table fills up, and the count is capped below its
+ *   size, and below the number of file descriptors passt can open for sockets
+ *   bound to flows: past that, datagrams would just be lost
+ *
+ * For each case, we report connections (or datagrams) completed per second,
+ * median and 99th percentile of their duration as seen by the client, and,
+ * from passt's statistics (see --stats-file): average time spent by passt
+ * handling a new TCP connection, peak flow table occupancy, peak number of
+ * free clusters in the flow table (that is, its fragmentation), and peak
+ * number of file descriptors passt has open, from /proc, as well as CPU cycles
+ * used by passt for each connection, as reported by replay.
+ *
+ * A case fails if more connections or datagrams fail than complete.
+ *
+ * Usage: crr [PASST [COUNT]]
+ *
+ * where COUNT is the number of connections or datagrams for each case, 100000
+ * by default.
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "util.h"
+#include "checksum.h"
+#include "client.h"
+#include "ip.h"
+#include "siphash.h"
+#include "inany.h"
+#include "flow.h"
+
+#define CRR_COUNT_DEFAULT	100000
+#define CRR_CONCURRENT		64
+#define CRR_STALL_MS		2000	/* Give up without progress for this */
+#define CRR_SAMPLE_MS		100	/* Sample statistics and descriptors */
+#define UDP_SINKS		4
+#define UDP_LOSS_MS		50	/* Datagrams not back by then are lost */
+#define UDP_FLOWS_SLACK		256	/* Flows, fds passt might need otherwise */
+#define PORT_MIN		1024
+#define PORTS			(65536 - PORT_MIN)
+#define GUEST_ISN		0x1000
+#define SINK_FDS		1024
+#define LAT_MAX			(1 << 20)	/* Latency samples kept */
+
+/**
+ * struct crr_result - Results for a single case
+ * @done:		Connections or datagrams completed
+ * @failed:		Connections reset, or datagrams lost
+ * @ns:			Duration, nanoseconds
+ * @lat:		Durations of connections or round trips, ns, saturated
+ * @lat_n:		Samples in @lat
+ * @setup_ns:		Average time passt spent on new TCP connections
+ * @flows_max:		Peak flow table occupancy
+ * @clusters_max:	Peak number of free clusters in flow table
+ * @fds_max:		Peak number of open file descriptors, -1 if unknown
+ * @cycles:		CPU cycles used by passt, negative if not available
+ * @estimated:		@cycles were estimated from CPU time
+ */
+struct crr_result {
+	uint64_t done;
+	uint64_t failed;
+	uint64_t ns;
+	uint32_t lat[LAT_MAX];
+	size_t lat_n;
+	double setup_ns;
+	unsigned flows_max;
+	unsigned clusters_max;
+	int fds_max;
+	double cycles;
+	bool estimated;
+};
+
+/**
+ * struct crr - State of a single case, shared with frame handlers
+ * @o:		Output queue
+ * @count:	Connections or datagrams to complete
+ * @next:	Index of next connection or datagram to start
+ * @inflight:	Connections or datagrams started, not completed yet
+ * @start:	Start time of connection, by guest port, tcp_out only
+ * @port:	Sink port, tcp_out, or guest port, tcp_in
+ * @sink:	Ports of sinks, udp only
+ * @last_rx:	Time of last datagram back, udp only
+ * @r:		Results
+ */
+struct crr {
+	struct out o;
+	uint64_t count;
+	uint64_t next;
+	unsigned inflight;
+	uint64_t start[65536];
+	in_port_t port;
+	in_port_t sink[UDP_SINKS];
+	uint64_t last_rx;
+	struct crr_result r;
+};
+
+static struct crr crr;
+
+static const char *stats_path;
+
+/**
+ * lat_add() - Record latency sample
+ * @r:		Results
+ * @ns:		Latency, nanoseconds
+ */
+static void lat_add(struct crr_result *r, uint64_t ns)
+{
+	if (r->lat_n < LAT_MAX)
+		r->lat[r->lat_n++] = MIN(ns, UINT32_MAX);
+}
+
+/**
+ * lat_cmp() - Compare latency samples, for qsort()
+ * @a:		First sample
+ * @b:		Second sample
+ *
+ * Return: negative, zero, or positive as in strcmp()
+ */
+static int lat_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * fds_count() - Count open file descriptors of process
+ * @pid:	Process
+ *
+ * Return: number of descriptors, -1 if not available
+ */
+static int fds_count(pid_t pid)
+{
+	char path[PATH_MAX];
+	struct dirent *d;
+	int n = 0;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "/proc/%i/fd", pid);
+	if (!(dir = opendir(path)))
+		return -1;
+
+	while ((d = readdir(dir))) {
+		if (*d->d_name != '.')
+			n++;
+	}
+
+	closedir(dir);
+	return n;
+}
+
+/**
+ * stats_read() - Read passt statistics from file, update peaks in result
+ * @r:		Results
+ *
+ * Return: 0 on success, -1 if the file isn't complete
+ */
+static int stats_read(struct crr_result *r)
+{
+	double sum = 0, count = 0;
+	unsigned flows = 0, v;
+	char line[BUFSIZ];
+	bool eof = false;
+	FILE *f;
+
+	if (!(f = fopen(stats_path, "r")))
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		const char *val = strrchr(line, ' ');
+		double d;
+
+		if (!strcmp(line, "# EOF\n"))
+			eof = true;
+
+		if (!val || *line == '#')
+			continue;
+
+		if (!strncmp(line, "passt_flows{", strlen("passt_flows{")) &&
+		    sscanf(val, "%u", &v) == 1)
+			flows += v;
+		else if (sscanf(line, "passt_flow_free_clusters %u", &v) == 1)
+			r->clusters_max = MAX(r->clusters_max, v);
+		else if (sscanf(line, "passt_tcp_conn_seconds_sum{%*[^}]} %lf",
+				&d) == 1)
+			sum += d;
+		else if (sscanf(line, "passt_tcp_conn_seconds_count{%*[^}]} %lf",
+				&d) == 1)
+			count += d;
+	}
+
+	fclose(f);
+
+	if (!eof)
+		return -1;
+
+	r->flows_max = MAX(r->flows_max, flows);
+	r->setup_ns = count ? sum / count * 1e9 : 0;
+	return 0;
+}
+
+/**
+ * sample() - Sample statistics and descriptors, request next statistics
+ * @pid:	PID of passt
+ * @r:		Results to update
+ */
+static void sample(pid_t pid, struct crr_result *r)
+{
+	int fds = fds_count(pid);
+
+	r->fds_max = fds < 0 ? -1 : MAX(r->fds_max, fds);
+	stats_read(r);
+	kill(pid, SIGUSR2);
+}
+
+/**
+ * tcp_out_start() - Start new connections from guest, up to concurrency limit
+ */
+static void tcp_out_start(void)
+{
+	while (crr.inflight < CRR_CONCURRENT && crr.next < crr.count) {
+		in_port_t port = PORT_MIN + crr.next++ % PORTS;
+
+		crr.start[port] = now_ns();
+		tcp_send(&crr.o, port, crr.port, GUEST_ISN, 0, TH_SYN, NULL, 0);
+		crr.inflight++;
+	}
+}
+
+/**
+ * tcp_out_frame() - Handle frame from passt for connections from guest
+ * @frame:	Frame
+ * @len:	Length of frame
+ * @arg:	Unused
+ */
+static void tcp_out_frame(const uint8_t *frame, size_t len, void *arg)
+{
+	const struct tcphdr *th;
+	in_port_t port;
+	size_t l4len;
+	uint32_t end;
+
+	(void)arg;
+
+	th = (const struct tcphdr *)frame_l4(frame, len, IPPROTO_TCP, &l4len);
+	if (!th || l4len < sizeof(*th) || th->doff * 4UL > l4len)
+		return;
+
+	port = ntohs(th->dest);
+	if (!crr.start[port])
+		return;		/* Already done, or reset */
+
+	end = ntohl(th->seq) + l4len - th->doff * 4 + th->syn + th->fin;
+
+	if (th->rst) {
+		crr.r.failed++;
+	} else if (th->syn) {
+		/* As guests do: passt ignores data on the handshake ACK */
+		tcp_send(&crr.o, port, crr.port, GUEST_ISN + 1, end,
+			 TH_ACK, NULL, 0);
+		tcp_send(&crr.o, port, crr.port, GUEST_ISN + 1, end,
+			 TH_ACK | TH_PUSH, "q", 1);
+		return;
+	} else if (!th->fin) {
+		if (l4len > th->doff * 4UL)
+			tcp_send(&crr.o, port, crr.port, GUEST_ISN + 2, end,
+				 TH_ACK, NULL, 0);
+		return;
+	} else {
+		tcp_send(&crr.o, port, crr.port, GUEST_ISN + 2, end,
+			 TH_ACK | TH_FIN, NULL, 0);
+		lat_add(&crr.r, now_ns() - crr.start[port]);
+		crr.r.done++;
+	}
+
+	crr.start[port] = 0;
+	crr.inflight--;
+}
+
+/**
+ * tcp_in_frame() - Handle frame from passt for connections to guest
+ * @frame:	Frame
+ * @len:	Length of frame
+ * @arg:	Unused
+ *
+ * Replies don't depend on any state: the guest accepts any connection, sends
+ * a one-byte response and a FIN to any request, and acknowledges any FIN.
+ */
+static void tcp_in_frame(const uint8_t *frame, size_t len, void *arg)
+{
+	const struct tcphdr *th;
+	size_t l4len, dlen;
+	in_port_t port;
+	uint32_t end;
+
+	(void)arg;
+
+	th = (const struct tcphdr *)frame_l4(frame, len, IPPROTO_TCP, &l4len);
+	if (!th || l4len < sizeof(*th) || th->doff * 4UL > l4len ||
+	    ntohs(th->dest) != crr.port || th->rst)
+		return;
+
+	port = ntohs(th->source);
+	dlen = l4len - th->doff * 4;
+	end = ntohl(th->seq) + dlen + th->syn + th->fin;
+
+	if (th->syn && !th->ack)
+		tcp_send(&crr.o, crr.port, port, GUEST_ISN, end,
+			 TH_SYN | TH_ACK, NULL, 0);
+	else if (dlen)
+		tcp_send(&crr.o, crr.port, port, GUEST_ISN + 1, end,
+			 TH_ACK | TH_PUSH | TH_FIN, "r", 1);
+	else if (th->fin)
+		tcp_send(&crr.o, crr.port, port, GUEST_ISN + 3, end,
+			 TH_ACK, NULL, 0);
+}
+
+/**
+ * udp_flows_max() - Get number of UDP flows passt can keep at the same time
+ *
+ * Return: flow table size or file descriptor limit, whichever is lower, minus
+ *	   UDP_FLOWS_SLACK. passt raises its limit to the hard one, inherited
+ */
+static uint64_t udp_flows_max(void)
+{
+	uint64_t max = FLOW_MAX;
+	struct rlimit limit;
+
+	if (!getrlimit(RLIMIT_NOFILE, &limit) && limit.rlim_max < max)
+		max = limit.rlim_max;
+
+	return max > UDP_FLOWS_SLACK ? max - UDP_FLOWS_SLACK : 1;
+}
+
+/**
+ * udp_start() - Send datagrams from guest, up to concurrency limit
+ */
+static void udp_start(void)
+{
+	while (crr.inflight < CRR_CONCURRENT && crr.next < crr.count) {
+		uint64_t i = crr.next++, ts = now_ns();
+		struct udphdr *uh;
+
+		uh = (struct udphdr *)frame_ip4(&crr.o, IPPROTO_UDP,
+						sizeof(*uh) + sizeof(ts));
+		if (!uh)
+			return;
+
+		uh->source = htons(PORT_MIN + i % PORTS);
+		uh->dest = htons(crr.sink[i / PORTS % UDP_SINKS]);
+		uh->len = htons(sizeof(*uh) + sizeof(ts));
+		uh->check = 0;
+		memcpy(uh + 1, &ts, sizeof(ts));
+
+		crr.inflight++;
+	}
+}
+
+/**
+ * udp_frame() - Handle frame from passt, echoed datagrams
+ * @frame:	Frame
+ * @len:	Length of frame
+ * @arg:	Unused
+ */
+static void udp_frame(const uint8_t *frame, size_t len, void *arg)
+{
+	const struct udphdr *uh;
+	size_t l4len;
+	uint64_t ts;
+
+	(void)arg;
+
+	uh = (const struct udphdr *)frame_l4(frame, len, IPPROTO_UDP, &l4len);
+	if (!uh || l4len < sizeof(*uh) + sizeof(ts))
+		return;
+
+	memcpy(&ts, uh + 1, sizeof(ts));
+	crr.last_rx = now_ns();
+	lat_add(&crr.r, crr.last_rx - ts);
+	crr.r.done++;
+	if (crr.inflight)
+		crr.inflight--;
+}
+
+/**
+ * udp_echo() - Echo back datagrams received by UDP sinks
+ * @udp_s:	Sink sockets
+ */
+static void udp_echo(const int *udp_s)
+{
+	char buf[BUFSIZ];
+	unsigned i;
+
+	for (i = 0; i < UDP_SINKS; i++) {
+		struct sockaddr_in a;
+		socklen_t sl = sizeof(a);
+		ssize_t n;
+
+		while ((n = recvfrom(udp_s[i], buf, sizeof(buf), 0,
+				     (struct sockaddr *)&a, &sl)) > 0)
+			sendto(udp_s[i], buf, n, 0, (struct sockaddr *)&a, sl);
+	}
+}
+
+/**
+ * sinks_handle() - Accept, answer and close connections to TCP sink
+ * @l:		Listening socket
+ * @fds:	Accepted sockets, -1 for free slots
+ */
+static void sinks_handle(int l, int *fds)
+{
+	int i, j = 0, s;
+	char c;
+
+	while ((s = accept4(l, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+		while (j < SINK_FDS && fds[j] >= 0)
+			j++;
+
+		if (j == SINK_FDS) {
+			close(s);
+			continue;
+		}
+
+		fds[j] = s;
+	}
+
+	for (i = 0; i < SINK_FDS; i++) {
+		if (fds[i] < 0 ||
+		    (recv(fds[i], &c, 1, 0) < 0 && errno == EAGAIN))
+			continue;
+
+		/* Request or end of stream, answer and close anyway */
+		send(fds[i], "r", 1, MSG_NOSIGNAL);
+		close(fds[i]);
+		fds[i] = -1;
+	}
+}
+
+/**
+ * clients_handle() - Start and complete connections from host to guest
+ * @fds:	Client sockets, -1 for free slots
+ * @start:	Start times of connections
+ * @connected:	Request sent, by slot
+ */
+static void clients_handle(int *fds, uint64_t *start, bool *connected)
+{
+	struct sockaddr_in a = { AF_INET, htons(crr.port),
+				 { htonl(INADDR_LOOPBACK) }, { 0 } };
+	char c;
+	int i;
+
+	for (i = 0; i < CRR_CONCURRENT; i++) {
+		ssize_t n;
+
+		if (fds[i] < 0) {
+			if (crr.next >= crr.count)
+				continue;
+
+			fds[i] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK,
+					0);
+			if (fds[i] < 0)
+				continue;
+
+			connected[i] = false;
+			start[i] = now_ns();
+			crr.next++;
+			if (connect(fds[i], (struct sockaddr *)&a, sizeof(a)) &&
+			    errno != EINPROGRESS)
+				goto fail;
+			continue;
+		}
+
+		if (!connected[i]) {
+			if (send(fds[i], "q", 1, MSG_NOSIGNAL) < 0) {
+				if (errno == EAGAIN || errno == ENOTCONN)
+					continue;
+				goto fail;
+			}
+			connected[i] = true;
+			continue;
+		}
+
+		while ((n = recv(fds[i], &c, 1, 0)) > 0)
+			;
+		if (n < 0 && errno == EAGAIN)
+			continue;
+		if (n < 0)
+			goto fail;
+
+		lat_add(&crr.r, now_ns() - start[i]);
+		crr.r.done++;
+		close(fds[i]);
+		fds[i] = -1;
+		continue;
+fail:
+		crr.r.failed++;
+		close(fds[i]);
+		fds[i] = -1;
+	}
+}
+
+/**
+ * run() - Run a single case
+ * @name:	Name of case: tcp_out, tcp_in or udp
+ * @passt:	Path to passt binary
+ * @count:	Connections or datagrams to complete
+ *
+ * Return: 0 on success, -1 on failure
+ */
+static int run(const char *name, const char *passt, uint64_t count)
+{
+	int sink_fds[SINK_FDS], client_fds[CRR_CONCURRENT];
+	bool tcp_in = !strcmp(name, "tcp_in");
+	bool udp = !strcmp(name, "udp");
+	uint64_t t, last, progress, sampled;
+	bool connected[CRR_CONCURRENT] = { 0 };
+	uint64_t start[CRR_CONCURRENT];
+	int s, l = -1, udp_s[UDP_SINKS];
+	const char *args[] = { "-t", "none", "-u", "none", "--stats-file",
+			       stats_path, "-4", NULL };
+	char port[sizeof("65535")];
+	struct meter m;
+	unsigned i;
+	pid_t pid;
+
+	if (udp && count > udp_flows_max()) {
+		count = udp_flows_max();
+		printf("crr udp: capped at %" PRIu64 " datagrams, as flows don't "
+		       "expire for minutes\n", count);
+	}
+
+	memset(&crr, 0, sizeof(crr));
+	crr.count = count;
+	crr.r.fds_max = 0;
+
+	for (i = 0; i < SINK_FDS; i++)
+		sink_fds[i] = -1;
+	for (i = 0; i < CRR_CONCURRENT; i++)
+		client_fds[i] = -1;
+	for (i = 0; i < UDP_SINKS; i++)
+		udp_s[i] = -1;
+
+	if (udp) {
+		for (i = 0; i < UDP_SINKS; i++) {
+			if ((udp_s[i] = sink_open(SOCK_DGRAM, &crr.sink[i])) < 0)
+				goto fail;
+		}
+	} else {
+		/* Listen on host for tcp_out, find a free port for tcp_in */
+		if ((l = sink_open(SOCK_STREAM, &crr.port)) < 0)
+			goto fail;
+
+		if (tcp_in) {
+			close(l);
+			l = -1;
+			snprintf(port, sizeof(port), "%hu", crr.port);
+			args[1] = port;
+		}
+	}
+
+	if ((s = passt_start(passt, args, &pid)) < 0)
+		goto fail;
+
+	/* Wait for passt to listen on the forwarded port */
+	for (i = 0; tcp_in && i < 100; i++) {
+		struct sockaddr_in a = { AF_INET, htons(crr.port),
+					 { htonl(INADDR_LOOPBACK) }, { 0 } };
+		int probe = socket(AF_INET, SOCK_STREAM, 0);
+
+		if (!bind(probe, (struct sockaddr *)&a, sizeof(a))) {
+			close(probe);
+			usleep(10 * 1000);
+			continue;
+		}
+		close(probe);
+		break;
+	}
+
+	meter_start(&m, pid);
+	t = last = progress = sampled = now_ns();
+	crr.last_rx = t;
+
+	while (crr.r.done + crr.r.failed < count) {
+		struct pollfd pfd[2 + UDP_SINKS + SINK_FDS + CRR_CONCURRENT];
+		void (*handler)(const uint8_t *frame, size_t len, void *arg);
+		uint64_t done = crr.r.done + crr.r.failed;
+		nfds_t n = 0;
+
+		if (udp)
+			handler = udp_frame;
+		else if (tcp_in)
+			handler = tcp_in_frame;
+		else
+			handler = tcp_out_frame;
+
+		if (in_read(s, handler, NULL)) {
+			fprintf(stderr, "passt closed the connection\n");
+			break;
+		}
+
+		if (udp) {
+			udp_echo(udp_s);
+			udp_start();
+		} else if (tcp_in) {
+			clients_handle(client_fds, start, connected);
+		} else {
+			sinks_handle(l, sink_fds);
+			tcp_out_start();
+		}
+
+		if (out_write(s, &crr.o)) {
+			fprintf(stderr, "Failed to write to passt\n");
+			break;
+		}
+
+		pfd[n++] = (struct pollfd){ s, POLLIN |
+			   (crr.o.len > crr.o.off ? POLLOUT : 0), 0 };
+		if (l >= 0)
+			pfd[n++] = (struct pollfd){ l, POLLIN, 0 };
+		for (i = 0; i < UDP_SINKS; i++) {
+			if (udp_s[i] >= 0)
+				pfd[n++] = (struct pollfd){ udp_s[i], POLLIN, 0 };
+		}
+		for (i = 0; i < SINK_FDS; i++) {
+			if (sink_fds[i] >= 0)
+				pfd[n++] = (struct pollfd){ sink_fds[i], POLLIN,
+							    0 };
+		}
+		for (i = 0; i < CRR_CONCURRENT; i++) {
+			if (client_fds[i] >= 0)
+				pfd[n++] = (struct pollfd){ client_fds[i],
+					   connected[i] ? POLLIN : POLLOUT, 0 };
+		}
+		poll(pfd, n, 1);
+
+		last = now_ns();
+		if (udp && crr.inflight &&
+		    last - crr.last_rx > UDP_LOSS_MS * 1000000ULL) {
+			crr.r.failed += crr.inflight;
+			crr.inflight = 0;
+			crr.last_rx = last;
+		}
+
+		if (crr.r.done + crr.r.failed != done)
+			progress = last;
+		else if (last - progress > CRR_STALL_MS * 1000000ULL) {
+			crr.r.failed += crr.inflight;
+			break;
+		}
+
+		if (last - sampled > CRR_SAMPLE_MS * 1000000ULL) {
+			sample(pid, &crr.r);
+			sampled = last;
+		}
+	}
+
+	crr.r.ns = last - t;
+	crr.r.cycles = meter_stop(&m, &crr.r.estimated);
+
+	/* Last sample, for the average time spent on new connections */
+	sample(pid, &crr.r);
+	usleep(CRR_SAMPLE_MS * 1000);
+	stats_read(&crr.r);
+
+	passt_stop(s, pid);
+
+	for (i = 0; i < SINK_FDS; i++) {
+		if (sink_fds[i] >= 0)
+			close(sink_fds[i]);
+	}
+	for (i = 0; i < CRR_CONCURRENT; i++) {
+		if (client_fds[i] >= 0)
+			close(client_fds[i]);
+	}
+	for (i = 0; i < UDP_SINKS; i++) {
+		if (udp_s[i] >= 0)
+			close(udp_s[i]);
+	}
+	if (l >= 0)
+		close(l);
+
+	return 0;
+
+fail:
+	perror(name);
+	for (i = 0; i < UDP_SINKS; i++) {
+		if (udp_s[i] >= 0)
+			close(udp_s[i]);
+	}
+	if (l >= 0)
+		close(l);
+	return -1;
+}
+
+/**
+ * report() - Print results for a single case
+ * @name:	Name of case
+ * @r:		Results
+ */
+static void report(const char *name, struct crr_result *r)
+{
+	char cycles[BUFSIZ] = "n/a", fds[BUFSIZ] = "n/a";
+	double p50 = 0, p99 = 0;
+
+	if (r->lat_n) {
+		qsort(r->lat, r->lat_n, sizeof(*r->lat), lat_cmp);
+		p50 = r->lat[r->lat_n / 2] / 1e3;
+		p99 = r->lat[r->lat_n * 99 / 100] / 1e3;
+	}
+
+	if (r->cycles >= 0 && r->done)
+		snprintf(cycles, sizeof(cycles), "%s%.0f",
+			 r->estimated ? "~" : "", r->cycles / r->done);
+
+	if (r->fds_max >= 0)
+		snprintf(fds, sizeof(fds), "%i", r->fds_max);
+
+	printf("crr %-7s %8" PRIu64 " done %6" PRIu64 " failed %8.0f /s "
+	       "p50 %7.1f us p99 %8.1f us setup %5.1f us flows %6u "
+	       "free clusters %5u fds %6s %8s cycles/conn\n",
+	       name, r->done, r->failed, r->done / (r->ns / 1e9), p50, p99,
+	       r->setup_ns / 1e3, r->flows_max, r->clusters_max, fds, cycles);
+}
+
+/**
+ * main() - Entry point
+ * @argc:	Argument count
+ * @argv:	Path to passt, default: ./passt, then number of connections
+ *
+ * Return: 0 on success, 1 on failure
+ */
+int main(int argc, char **argv)
+{
+	static const char *cases[] = { "tcp_out", "tcp_in", "udp" };
+	const char *passt = argc > 1 ? argv[1] : "./passt";
+	uint64_t count = CRR_COUNT_DEFAULT;
+	static char path[PATH_MAX];
+	unsigned i;
+
+	if (argc > 2 && !(count = strtoull(argv[2], NULL, 0))) {
+		fprintf(stderr, "Usage: %s [PASST [COUNT]]\n", argv[0]);
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	snprintf(path, sizeof(path), "/tmp/passt_bench_%i.stats", getpid());
+	stats_path = path;
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		if (run(cases[i], passt, count)) {
+			unlink(stats_path);
+			return 1;
+		}
+
+		report(cases[i], &crr.r);
+
+		if (crr.r.failed > crr.r.done) {
+			fprintf(stderr, "%s: most attempts failed\n", cases[i]);
+			unlink(stats_path);
+			return 1;
+		}
+	}
+
+	unlink(stats_path);
+	return 0;
+}
@@ -0,0 +1,717 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* footprint - Check memory footprint of passt and pasta instances
+ *
+ * Copyright Red Hat
+ *
+ * For each configuration, starts a few instances of passt, each connected to
+ * as qemu would, or of pasta, all at once, lets them settle, and reports, per
+ * instance:
+ *
+ * - RSS and PSS, from /proc/PID/smaps_rollup: as instances share text and
+ *   libraries, PSS is what each further instance actually costs
+ * - BSS touched: resident part of the anonymous mappings right after the
+ *   binary, that is, of buffers and tables we don't allocate dynamically
+ * - file descriptors, by type: sockets, pipes, timerfds, and anything else
+ *
+ * then, for a single passt instance, the same figures for each of FP_FLOWS TCP
+ * connections, and UDP flows, from the guest to sinks on the host loopback,
+ * kept open.
+ *
+ * Figures are checked against thresholds given below, and we exit with failure
+ * if any is exceeded, or if instances fail to start, or exit, so that
+ * 'make bench' catches regressions. Two environment limits are checked upfront,
+ * and configurations hitting them are reported and skipped: pasta needs to
+ * create and join namespaces, so pasta configurations are skipped if a plain
+ * pasta instance can't start, and '-t all' needs more than 65536 file
+ * descriptors, so it's skipped if the hard limit, which passt raises its own
+ * limit to, is lower than that.
+ *
+ * Usage: footprint [PASST [PASTA]]
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "util.h"
+#include "checksum.h"
+#include "client.h"
+
+#define FP_INSTANCES		8
+#define FP_SETTLE_MS		500	/* Wait before measuring */
+#define FP_FLOWS		1000
+#define FP_FLOWS_MS		5000	/* Give up setting up flows after this */
+#define PORT_MIN		1024
+#define GUEST_ISN		0x1000
+
+/**
+ * struct fp - Memory footprint of a process, or its growth
+ * @rss:	Resident set size, KiB
+ * @pss:	Proportional set size, KiB
+ * @bss:	Resident part of BSS, KiB
+ * @sockets:	Sockets
+ * @pipes:	Pipe ends
+ * @timerfds:	Timer file descriptors
+ * @other:	Any other file descriptor
+ */
+struct fp {
+	double rss;
+	double pss;
+	double bss;
+	double sockets;
+	double pipes;
+	double timerfds;
+	double other;
+};
+
+/**
+ * struct fp_field - Field of struct fp, for reports and checks
+ * @name:	Name
+ * @off:	Offset in struct fp
+ */
+static const struct fp_field {
+	const char *name;
+	size_t off;
+} fp_fields[] = {
+	{ "rss",	offsetof(struct fp, rss)	},
+	{ "pss",	offsetof(struct fp, pss)	},
+	{ "bss",	offsetof(struct fp, bss)	},
+	{ "sockets",	offsetof(struct fp, sockets)	},
+	{ "pipes",	offsetof(struct fp, pipes)	},
+	{ "timerfds",	offsetof(struct fp, timerfds)	},
+	{ "other",	offsetof(struct fp, other)	},
+};
+
+/**
+ * struct fp_config - Configuration to measure, with thresholds
+ * @name:	Name, for reports
+ * @pasta:	Start pasta instead of passt
+ * @args:	Further options, NULL-terminated
+ * @pcap:	Capture to a file for each instance
+ * @instances:	Number of instances, started all at once
+ * @nofile:	Hard limit of open files needed, 0 if any will do
+ * @max:	Thresholds per instance, fields set to zero aren't checked
+ */
+struct fp_config {
+	const char *name;
+	bool pasta;
+	const char *args[8];
+	bool pcap;
+	unsigned instances;
+	unsigned long nofile;
+	struct fp max;
+};
+
+/* Ports can be bound by a single instance at a time, hence -t all alone */
+static const struct fp_config configs[] = {
+	{ "passt",		false,	{ NULL },
+	  false, FP_INSTANCES, 0,
+	  { .rss = 14336, .pss = 10240, .bss = 8704,
+	    .sockets = 80, .pipes = 0.1, .timerfds = 0.1, .other = 4 } },
+	{ "passt -4",		false,	{ "-4", NULL },
+	  false, FP_INSTANCES, 0,
+	  { .rss = 14336, .pss = 10240, .bss = 8704,
+	    .sockets = 80, .pipes = 0.1, .timerfds = 0.1, .other = 4 } },
+	{ "passt -6",		false,	{ "-6", NULL },
+	  false, FP_INSTANCES, 0,
+	  { .rss = 14336, .pss = 10240, .bss = 8704,
+	    .sockets = 80, .pipes = 0.1, .timerfds = 0.1, .other = 4 } },
+	{ "passt -t all",	false,	{ "-t", "all", NULL },
+	  false, 1, 65536 + 1024,
+	  { .rss = 16384, .pss = 12288, .bss = 10240,
+	    .sockets = 65536 * 2 + 80, .pipes = 0.1, .timerfds = 0.1,
+	    .other = 4 } },
+	{ "passt pcap",		false,	{ NULL },
+	  true, FP_INSTANCES, 0,
+	  { .rss = 14336, .pss = 10240, .bss = 8704,
+	    .sockets = 80, .pipes = 0.1, .timerfds = 0.1, .other = 5 } },
+	{ "passt pcap mmap",	false,	{ "--pcap-size", "1048576",
+					  "--pcap-files", "2", NULL },
+	  true, FP_INSTANCES, 0,
+	  { .rss = 16384, .pss = 12288, .bss = 8704,
+	    .sockets = 80, .pipes = 0.1, .timerfds = 0.1, .other = 6 } },
+	{ "pasta",		true,	{ NULL },
+	  false, FP_INSTANCES, 0,
+	  { .rss = 16384, .pss = 12288, .bss = 8704,
+	    .sockets = 160, .pipes = 0.1, .timerfds = 0.1, .other = 8 } },
+	{ "pasta pcap",		true,	{ NULL },
+	  true, FP_INSTANCES, 0,
+	  { .rss = 16384, .pss = 12288, .bss = 8704,
+	    .sockets = 160, .pipes = 0.1, .timerfds = 0.1, .other = 9 } },
+};
+
+/* Thresholds per flow, for TCP connections and UDP flows from guest: sockets
+ * from the pool of TCP sockets, refilled later, might be counted for either
+ */
+static const struct fp fp_max_tcp = {
+	.rss = 1, .pss = 1, .bss = 1,
+	.sockets = 1.05, .pipes = 0.01, .timerfds = 1.01, .other = 0.01,
+};
+
+static const struct fp fp_max_udp = {
+	.rss = 1, .pss = 1, .bss = 1,
+	.sockets = 1.05, .pipes = 0.01, .timerfds = 0.01, .other = 0.01,
+};
+
+/**
+ * fp_smaps() - Get RSS and PSS of process, and resident part of its BSS
+ * @pid:	Process
+ * @fp:	Footprint, @rss, @pss and @bss updated on return
+ *
+ * Return: 0 on success, -1 if the process is gone
+ */
+static int fp_smaps(pid_t pid, struct fp *fp)
+{
+	unsigned long start, end, last = 0, v;
+	char path[PATH_MAX], exe[PATH_MAX];
+	char line[BUFSIZ];
+	bool bss = false;
+	ssize_t n;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%i/exe", pid);
+	if ((n = readlink(path, exe, sizeof(exe) - 1)) < 0)
+		return -1;
+	exe[n] = 0;
+
+	snprintf(path, sizeof(path), "/proc/%i/smaps_rollup", pid);
+	if (!(f = fopen(path, "r")))
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "Rss: %lu kB", &v) == 1)
+			fp->rss = v;
+		else if (sscanf(line, "Pss: %lu kB", &v) == 1)
+			fp->pss = v;
+	}
+	fclose(f);
+
+	/* BSS follows mappings of the binary, with no gaps and no name */
+	snprintf(path, sizeof(path), "/proc/%i/smaps", pid);
+	if (!(f = fopen(path, "r")))
+		return -1;
+
+	fp->bss = 0;
+	while (fgets(line, sizeof(line), f)) {
+		int name;
+
+		if (sscanf(line, "%lx-%lx %*s %*s %*s %*s %n",
+			   &start, &end, &name) >= 2) {
+			line[strcspn(line, "\n")] = 0;
+
+			if (!strcmp(line + name, exe))
+				last = end;
+			else if (!line[name] && last && start == last)
+				last = end;
+			else
+				last = 0;
+
+			bss = last && !line[name];
+		} else if (bss && sscanf(line, "Rss: %lu kB", &v) == 1) {
+			fp->bss += v;
+		}
+	}
+	fclose(f);
+
+	return 0;
+}
+
+/**
+ * fp_fds() - Count file descriptors of process by type
+ * @pid:	Process
+ * @fp:	Footprint, counts updated on return
+ */
+static void fp_fds(pid_t pid, struct fp *fp)
+{
+	char path[PATH_MAX], target[PATH_MAX];
+	struct dirent *d;
+	DIR *dir;
+
+	fp->sockets = fp->pipes = fp->timerfds = fp->other = 0;
+
+	snprintf(path, sizeof(path), "/proc/%i/fd", pid);
+	if (!(dir = opendir(path)))
+		return;
+
+	while ((d = readdir(dir))) {
+		ssize_t n;
+
+		if (*d->d_name == '.')
+			continue;
+
+		snprintf(path, sizeof(path), "/proc/%i/fd/%s", pid, d->d_name);
+		if ((n = readlink(path, target, sizeof(target) - 1)) < 0)
+			continue;
+		target[n] = 0;
+
+		if (!strncmp(target, "socket:", strlen("socket:")))
+			fp->sockets++;
+		else if (!strncmp(target, "pipe:", strlen("pipe:")))
+			fp->pipes++;
+		else if (!strcmp(target, "anon_inode:[timerfd]"))
+			fp->timerfds++;
+		else
+			fp->other++;
+	}
+
+	closedir(dir);
+}
+
+/**
+ * fp_add() - Add footprint of process, or difference between two, scaled
+ * @sum:	Sum, updated on return
+ * @a:		Footprint to add
+ * @b:		Footprint to subtract, can be NULL
+ * @scale:	Factor for difference
+ */
+static void fp_add(struct fp *sum, const struct fp *a, const struct fp *b,
+		   double scale)
+{
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(fp_fields); i++) {
+		size_t off = fp_fields[i].off;
+		double v = *(const double *)((const char *)a + off);
+
+		if (b)
+			v -= *(const double *)((const char *)b + off);
+
+		*(double *)((char *)sum + off) += v * scale;
+	}
+}
+
+/**
+ * fp_measure() - Measure footprint of a process
+ * @pid:	Process
+ * @fp:	Footprint, set on return
+ *
+ * Return: 0 on success, -1 if the process is gone
+ */
+static int fp_measure(pid_t pid, struct fp *fp)
+{
+	memset(fp, 0, sizeof(*fp));
+
+	if (fp_smaps(pid, fp))
+		return -1;
+
+	fp_fds(pid, fp);
+	return 0;
+}
+
+/**
+ * fp_report() - Print footprint, check it against thresholds
+ * @name:	Name of configuration or flow type
+ * @n:		Number of instances or flows
+ * @unit:	"inst" or "flows"
+ * @fp:		Footprint per instance or flow
+ * @max:	Thresholds, fields set to zero aren't checked
+ *
+ * Return: number of thresholds exceeded
+ */
+static int fp_report(const char *name, unsigned n, const char *unit,
+		     const struct fp *fp, const struct fp *max)
+{
+	char over[BUFSIZ] = "";
+	unsigned i;
+	int ret = 0;
+
+	printf("footprint %-16s %5u %-5s", name, n, unit);
+
+	for (i = 0; i < ARRAY_SIZE(fp_fields); i++) {
+		size_t off = fp_fields[i].off;
+		double v = *(const double *)((const char *)fp + off);
+		double m = *(const double *)((const char *)max + off);
+		bool kib = off < offsetof(struct fp, sockets);
+
+		printf(" %s %*.2f%s", fp_fields[i].name, kib ? 9 : 6, v,
+		       kib ? " KiB" : "");
+
+		if (m > 0 && v > m) {
+			size_t len = strlen(over);
+
+			snprintf(over + len, sizeof(over) - len, " %s > %g",
+				 fp_fields[i].name, m);
+			ret++;
+		}
+	}
+
+	if (ret)
+		printf("  FAIL:%s\n", over);
+	else
+		printf("  ok\n");
+
+	fflush(stdout);
+	return ret;
+}
+
+/**
+ * pasta_start() - Start pasta in foreground, in its own process group
+ * @pasta:	Path to pasta binary
+ * @args:	Further options for pasta, NULL-terminated
+ * @pid:	PID of pasta, set on return
+ *
+ * Return: 0 on success, -1 on failure
+ */
+static int pasta_start(const char *pasta, const char *const *args, pid_t *pid)
+{
+	const char *argv[64] = { pasta, "-f", "-q", "--config-net" };
+	int n;
+
+	for (n = 0; argv[n]; n++)
+		;
+	while (*args && n < (int)ARRAY_SIZE(argv) - 4)
+		argv[n++] = *args++;
+	argv[n++] = "--";
+	argv[n++] = "sleep";
+	argv[n++] = "3600";
+
+	if (!(*pid = fork())) {
+		int fd = open("/dev/null", O_WRONLY);
+
+		setpgid(0, 0);
+		dup2(fd, STDOUT_FILENO);
+		dup2(fd, STDERR_FILENO);
+		execv(pasta, (char *const *)argv);
+		_exit(EXIT_FAILURE);
+	}
+
+	return *pid < 0 ? -1 : 0;
+}
+
+/**
+ * pasta_usable() - Check if pasta can create and join namespaces here
+ * @pasta:	Path to pasta binary
+ *
+ * Return: true if a pasta instance without further options starts and stays
+ */
+static bool pasta_usable(const char *pasta)
+{
+	static const char *const args[] = { NULL };
+	bool alive;
+	pid_t pid;
+
+	if (pasta_start(pasta, args, &pid))
+		return false;
+
+	usleep(FP_SETTLE_MS * 1000);
+	alive = !waitpid(pid, NULL, WNOHANG);
+
+	kill(-pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+
+	return alive;
+}
+
+/**
+ * pcap_unlink() - Remove capture file for instance, and rotated ones
+ * @path:	Path of capture file
+ */
+static void pcap_unlink(const char *path)
+{
+	char rotated[PATH_MAX + sizeof(".0")];
+	unsigned i;
+
+	unlink(path);
+	for (i = 0; i < 2; i++) {
+		snprintf(rotated, sizeof(rotated), "%s.%u", path, i);
+		unlink(rotated);
+	}
+}
+
+/**
+ * run_config() - Measure footprint of instances in a given configuration
+ * @cfg:	Configuration
+ * @passt:	Path to passt binary
+ * @pasta:	Path to pasta binary, NULL if pasta can't run here
+ *
+ * Return: number of thresholds exceeded, 1 if instances failed or exited
+ */
+static int run_config(const struct fp_config *cfg, const char *passt,
+		      const char *pasta)
+{
+	int s[FP_INSTANCES], ret = 0;
+	pid_t pid[FP_INSTANCES];
+	struct fp sum = { 0 };
+	struct rlimit limit;
+	unsigned i, n;
+
+	if (cfg->pasta && !pasta) {
+		printf("footprint %-16s skipped: pasta can't create namespaces "
+		       "here\n", cfg->name);
+		return 0;
+	}
+
+	if (cfg->nofile && !getrlimit(RLIMIT_NOFILE, &limit) &&
+	    limit.rlim_max < cfg->nofile) {
+		printf("footprint %-16s skipped: needs %lu open files, hard "
+		       "limit is %lu\n", cfg->name, cfg->nofile,
+		       (unsigned long)limit.rlim_max);
+		return 0;
+	}
+
+	for (n = 0; n < cfg->instances; n++) {
+		const char *argv[ARRAY_SIZE(cfg->args) + 2];
+		unsigned a = 0, j;
+		char pcap[PATH_MAX];
+
+		snprintf(pcap, sizeof(pcap), "/tmp/passt_bench_%i_%u.pcap",
+			 getpid(), n);
+		if (cfg->pcap) {
+			argv[a++] = "--pcap";
+			argv[a++] = pcap;
+		}
+		for (j = 0; cfg->args[j]; j++)
+			argv[a++] = cfg->args[j];
+		argv[a] = NULL;
+
+		s[n] = -1;
+		if (cfg->pasta) {
+			if (pasta_start(pasta, argv, &pid[n]))
+				break;
+		} else if ((s[n] = passt_start(passt, argv, &pid[n])) < 0) {
+			break;
+		}
+	}
+
+	usleep(FP_SETTLE_MS * 1000);
+
+	for (i = 0; i < n; i++) {
+		struct fp fp;
+
+		if (waitpid(pid[i], NULL, WNOHANG) || fp_measure(pid[i], &fp))
+			break;
+
+		fp_add(&sum, &fp, NULL, 1.0 / n);
+	}
+
+	if (n < cfg->instances) {
+		printf("footprint %-16s FAIL: started %u instances out of %u\n",
+		       cfg->name, n, cfg->instances);
+		ret = 1;
+	} else if (i < n) {
+		printf("footprint %-16s FAIL: instance %u exited\n",
+		       cfg->name, i);
+		ret = 1;
+	} else {
+		ret = fp_report(cfg->name, n, "inst", &sum, &cfg->max);
+	}
+
+	for (i = 0; i < n; i++) {
+		char pcap[PATH_MAX];
+
+		if (cfg->pasta) {
+			kill(-pid[i], SIGTERM);
+			waitpid(pid[i], NULL, 0);
+		} else {
+			passt_stop(s[i], pid[i]);
+		}
+
+		snprintf(pcap, sizeof(pcap), "/tmp/passt_bench_%i_%u.pcap",
+			 getpid(), i);
+		pcap_unlink(pcap);
+	}
+
+	return ret;
+}
+
+/**
+ * tcp_frame() - Handle frame from passt, complete handshakes
+ * @frame:	Frame
+ * @len:	Length of frame
+ * @arg:	Output queue
+ */
+static void tcp_frame(const uint8_t *frame, size_t len, void *arg)
+{
+	const struct tcphdr *th;
+	size_t l4len;
+
+	th = (const struct tcphdr *)frame_l4(frame, len, IPPROTO_TCP, &l4len);
+	if (!th || l4len < sizeof(*th) || !th->syn || !th->ack)
+		return;
+
+	tcp_send(arg, ntohs(th->dest), ntohs(th->source), GUEST_ISN + 1,
+		 ntohl(th->seq) + 1, TH_ACK, NULL, 0);
+}
+
+/**
+ * flows_open() - Open flows from guest to sink, wait until sink sees them
+ * @s:		Socket connected to passt
+ * @type:	SOCK_STREAM or SOCK_DGRAM
+ * @sink:	Listening or bound socket on host
+ * @port:	Port of sink
+ * @fds:	Accepted sockets, SOCK_STREAM only, set on return
+ *
+ * Return: number of flows the sink saw
+ */
+static unsigned flows_open(int s, int type, int sink, in_port_t port,
+			   int *fds)
+{
+	struct out o = { 0 };
+	uint64_t start = now_ns();
+	unsigned i, seen = 0;
+
+	for (i = 0; i < FP_FLOWS; i++) {
+		struct udphdr *uh;
+
+		if (type == SOCK_STREAM) {
+			tcp_send(&o, PORT_MIN + i, port, GUEST_ISN, 0, TH_SYN,
+				 NULL, 0);
+			continue;
+		}
+
+		if (!(uh = (struct udphdr *)frame_ip4(&o, IPPROTO_UDP,
+						      sizeof(*uh) + 1)))
+			break;
+
+		uh->source = htons(PORT_MIN + i);
+		uh->dest = htons(port);
+		uh->len = htons(sizeof(*uh) + 1);
+		uh->check = 0;
+		*(uint8_t *)(uh + 1) = 0;
+	}
+
+	while (seen < FP_FLOWS &&
+	       now_ns() - start < FP_FLOWS_MS * 1000000ULL) {
+		char buf[BUFSIZ];
+		int fd;
+
+		if (out_write(s, &o) || in_read(s, tcp_frame, &o))
+			break;
+
+		if (type == SOCK_STREAM) {
+			while (seen < FP_FLOWS &&
+			       (fd = accept4(sink, NULL, NULL,
+					     SOCK_NONBLOCK)) >= 0)
+				fds[seen++] = fd;
+		} else {
+			while (recv(sink, buf, sizeof(buf), 0) > 0)
+				seen++;
+		}
+
+		usleep(1000);
+	}
+
+	return seen;
+}
+
+/**
+ * run_flows() - Measure footprint of TCP connections and UDP flows from guest
+ * @passt:	Path to passt binary
+ *
+ * Return: number of thresholds exceeded, or 1 on failure
+ */
+static int run_flows(const char *passt)
+{
+	static const char *const args[] = { "-t", "none", "-u", "none", "-4",
+					    NULL };
+	int s, l, u, ret = 0, fds[FP_FLOWS];
+	struct fp base, tcp, udp, d;
+	in_port_t lport, uport;
+	unsigned n, i, ntcp;
+	pid_t pid;
+
+	if ((l = sink_open(SOCK_STREAM, &lport)) < 0 ||
+	    (u = sink_open(SOCK_DGRAM, &uport)) < 0) {
+		fprintf(stderr, "Failed to open sinks\n");
+		return 1;
+	}
+
+	if ((s = passt_start(passt, args, &pid)) < 0) {
+		close(l);
+		close(u);
+		return 1;
+	}
+
+	usleep(FP_SETTLE_MS * 1000);
+	ntcp = 0;
+	if (fp_measure(pid, &base))
+		goto fail;
+
+	n = ntcp = flows_open(s, SOCK_STREAM, l, lport, fds);
+	usleep(FP_SETTLE_MS * 1000);
+	if (n < FP_FLOWS || fp_measure(pid, &tcp)) {
+		fprintf(stderr, "Only %u TCP connections out of %u\n",
+			n, FP_FLOWS);
+		goto fail;
+	}
+
+	memset(&d, 0, sizeof(d));
+	fp_add(&d, &tcp, &base, 1.0 / n);
+	ret += fp_report("flow tcp", n, "flows", &d, &fp_max_tcp);
+
+	n = flows_open(s, SOCK_DGRAM, u, uport, NULL);
+	usleep(FP_SETTLE_MS * 1000);
+	if (n < FP_FLOWS || fp_measure(pid, &udp)) {
+		fprintf(stderr, "Only %u UDP datagrams out of %u\n",
+			n, FP_FLOWS);
+		goto fail;
+	}
+
+	memset(&d, 0, sizeof(d));
+	fp_add(&d, &udp, &tcp, 1.0 / n);
+	ret += fp_report("flow udp", n, "flows", &d, &fp_max_udp);
+
+out:
+	for (i = 0; i < ntcp; i++)
+		close(fds[i]);
+	passt_stop(s, pid);
+	close(l);
+	close(u);
+	return ret;
+
+fail:
+	ret = 1;
+	goto out;
+}
+
+/**
+ * main() - Entry point
+ * @argc:	Argument count
+ * @argv:	Paths to passt and pasta, default: ./passt, ./pasta
+ *
+ * Return: 0 on success, 1 on failure or if any threshold is exceeded
+ */
+int main(int argc, char **argv)
+{
+	const char *passt = argc > 1 ? argv[1] : "./passt";
+	const char *pasta = argc > 2 ? argv[2] : "./pasta";
+	unsigned i;
+	int fail;
+
+	if (argc > 3) {
+		fprintf(stderr, "Usage: %s [PASST [PASTA]]\n", argv[0]);
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	if (!pasta_usable(pasta))
+		pasta = NULL;
+
+	for (i = 0, fail = 0; i < ARRAY_SIZE(configs); i++)
+		fail += run_config(&configs[i], passt, pasta);
+
+	fail += run_flows(passt);
+
+	return !!fail;
+}
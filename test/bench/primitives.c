@@ -0,0 +1,443 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* primitives - Measure cost of primitives used on every packet or flow
+ *
+ * Copyright Red Hat
+ *
+ * Links all the objects passt is built from, except for passt.c, and measures,
+ * in a loop:
+ *
+ * - checksums: csum_unfolded() and csum_iov(), for a few sizes and alignments,
+ *   and with frames split across a number of buffers for csum_iov()
+ * - flow table: flow_hash_insert() and flow_hash_remove(), and flow_lookup_af()
+ *   for flows in the table and not, with a few numbers of flows in the table
+ * - iovec helpers: iov_skip_bytes() and iov_to_buf() on split frames
+ * - packet pools: packet_add() of a full pool, packet_get() of each header
+ * - lineread_get() on a file with lines of given length, as we read /proc
+ *
+ * Output is one line for each case, with space-separated fields, preceded by
+ * a header line starting with '#', so that results can be compared with awk:
+ *
+ *   # name size align ns/op bytes/cycle
+ *   csum_unfolded 1500 0 37.52 11.85
+ *
+ * where size is the number of bytes, flows, or line length, depending on the
+ * case, and bytes/cycle is '-' if not applicable or not available. CPU cycles
+ * are read from perf events, if available, otherwise estimated from the CPU
+ * time clock of the process and the nominal clock frequency, as reported in
+ * the header, using the meter from client.c.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+#include <syslog.h>
+
+#include "checksum.h"
+#include "util.h"
+#include "ip.h"
+#include "iov.h"
+#include "passt.h"
+#include "siphash.h"
+#include "inany.h"
+#include "flow.h"
+#include "flow_table.h"
+#include "packet.h"
+#include "lineread.h"
+#include "log.h"
+#include "client.h"
+
+#define BYTES_PER_CASE		(64UL << 20)	/* Bytes processed per case */
+#define OPS_PER_CASE		(1000 * 1000)	/* Or operations, at least */
+#define BUF_BYTES		(ETH_MAX_MTU + 64)
+#define POOL_PACKETS		128
+#define LINES			1024
+#define LOOKUP_FLOWS_MAX	(FLOW_MAX / 2)
+
+/* Normally defined by passt.c, not linked here */
+char pkt_buf[PKT_BUF_BYTES]	__attribute__ ((aligned(PAGE_SIZE)));
+char *epoll_type_str[EPOLL_NUM_TYPES];
+
+/**
+ * proto_update_l2_buf() - Stub: no protocol buffers to update here
+ * @eth_d:	Ethernet destination address, unused
+ * @eth_s:	Ethernet source address, unused
+ */
+void proto_update_l2_buf(const unsigned char *eth_d, const unsigned char *eth_s)
+{
+	(void)eth_d;
+	(void)eth_s;
+}
+
+/**
+ * passt_exit() - Stub: no main loop to defer to, exit right away
+ * @status:	Exit status
+ */
+void passt_exit(int status)
+{
+	exit(status);
+}
+
+static const size_t sizes[] = { 64, 576, 1500, 9000, 65520 };
+static const size_t aligns[] = { 0, 1, 2, 4 };
+static const size_t splits[] = { 1, 2, 4, 16 };
+static const size_t flows[] = { 256, 4096, LOOKUP_FLOWS_MAX };
+
+static uint8_t buf[BUF_BYTES] __attribute__ ((aligned(64)));
+static uint8_t out[BUF_BYTES] __attribute__ ((aligned(64)));
+
+static struct ctx c;
+static volatile uint64_t sink;		/* Keep results from being discarded */
+
+static uint64_t case_ns;		/* Start of current case, monotonic clock */
+static bool case_cycles;		/* Cycles available, as reported in header */
+
+/**
+ * case_start() - Start measurement of wall-clock time and CPU cycles
+ * @m:		Meter for CPU cycles of this process
+ */
+static void case_start(struct meter *m)
+{
+	meter_start(m, getpid());
+	case_ns = now_ns();
+}
+
+/**
+ * case_report() - Stop measurement, print results
+ * @m:		Meter started with case_start()
+ * @name:	Name of case
+ * @size:	Size: bytes, flows or line length, depending on case
+ * @align:	Offset from 64-byte aligned address
+ * @ops:	Operations done
+ * @bytes:	Bytes processed, 0 if not applicable
+ */
+static void case_report(struct meter *m, const char *name, size_t size,
+			size_t align, uint64_t ops, uint64_t bytes)
+{
+	double ns = now_ns() - case_ns, cycles;
+	char bpc[BUFSIZ] = "-";
+	bool estimated;
+
+	cycles = meter_stop(m, &estimated);
+	if (bytes && case_cycles && cycles > 0)
+		snprintf(bpc, sizeof(bpc), "%.2f", bytes / cycles);
+
+	printf("%s %zu %zu %.2f %s\n", name, size, align, ns / ops, bpc);
+	fflush(stdout);
+}
+
+/**
+ * rounds() - Get number of rounds for given case
+ * @bytes:	Bytes processed in each round, 0 if not applicable
+ * @ops:	Operations done in each round
+ *
+ * Return: number of rounds to process BYTES_PER_CASE, or, if @bytes is 0, to
+ *	   do OPS_PER_CASE operations, at least one
+ */
+static uint64_t rounds(size_t bytes, size_t ops)
+{
+	if (bytes)
+		return MAX(BYTES_PER_CASE / bytes, 1);
+
+	return MAX(OPS_PER_CASE / ops, 1);
+}
+
+/**
+ * split() - Split buffer into vector of buffers of about the same size
+ * @iov:	Vector to fill
+ * @n:		Number of buffers
+ * @base:	Start of buffer
+ * @size:	Size of buffer
+ */
+static void split(struct iovec *iov, size_t n, uint8_t *base, size_t size)
+{
+	size_t i, off = 0;
+
+	for (i = 0; i < n; i++) {
+		iov[i].iov_base = base + off;
+		iov[i].iov_len = size / n + (i < size % n);
+		off += iov[i].iov_len;
+	}
+}
+
+/**
+ * bench_csum() - Measure checksum functions
+ */
+static void bench_csum(void)
+{
+	struct iovec iov[16];
+	struct meter m;
+	uint64_t r, n;
+	size_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(aligns); j++) {
+			const uint8_t *p = buf + aligns[j];
+
+			n = rounds(sizes[i], 1);
+			case_start(&m);
+			for (r = 0; r < n; r++)
+				sink += csum_unfolded(p, sizes[i], r);
+			case_report(&m, "csum_unfolded", sizes[i], aligns[j],
+				    n, n * sizes[i]);
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (j = 0; j < ARRAY_SIZE(splits); j++) {
+			char name[BUFSIZ];
+
+			split(iov, splits[j], buf, sizes[i]);
+			snprintf(name, sizeof(name), "csum_iov/%zu", splits[j]);
+
+			n = rounds(sizes[i], 1);
+			case_start(&m);
+			for (r = 0; r < n; r++)
+				sink += csum_iov(iov, splits[j], 0, r);
+			case_report(&m, name, sizes[i], 0, n, n * sizes[i]);
+		}
+	}
+}
+
+/**
+ * bench_iov() - Measure iovec helpers
+ */
+static void bench_iov(void)
+{
+	struct iovec iov[16];
+	struct meter m;
+	uint64_t r, n;
+	size_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		for (j = 1; j < ARRAY_SIZE(splits); j++) {
+			size_t s = splits[j], off;
+			char name[BUFSIZ];
+
+			split(iov, s, buf, sizes[i]);
+
+			snprintf(name, sizeof(name), "iov_skip_bytes/%zu", s);
+			n = rounds(0, 1);
+			case_start(&m);
+			for (r = 0; r < n; r++)
+				sink += iov_skip_bytes(iov, s, sizes[i] - 1 - r % 2,
+						       &off) + off;
+			case_report(&m, name, sizes[i], 0, n, 0);
+
+			snprintf(name, sizeof(name), "iov_to_buf/%zu", s);
+			n = rounds(sizes[i], 1);
+			case_start(&m);
+			for (r = 0; r < n; r++)
+				sink += iov_to_buf(iov, s, 0, out, sizes[i]);
+			case_report(&m, name, sizes[i], 0, n, n * sizes[i]);
+		}
+	}
+}
+
+/**
+ * flows_add() - Allocate flows from tap to host, UDP, IPv4, not hashed yet
+ * @sidx:	Guest side of flows, set on return
+ * @n:		Number of flows
+ */
+static void flows_add(flow_sidx_t *sidx, size_t n)
+{
+	struct in_addr guest = { htonl(0xc0000202) };	/* 192.0.2.2 */
+	struct in_addr host = { htonl(0xc6336401) };	/* 198.51.100.1 */
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		in_port_t eport = 1024 + i % 60000, oport = 53 + i / 60000;
+		union flow *flow = flow_alloc();
+
+		flow_initiate_af(flow, PIF_TAP, AF_INET,
+				 &guest, eport, &host, oport);
+		flow_target(&c, flow, IPPROTO_UDP);
+		FLOW_ACTIVATE(flow_set_type(flow, FLOW_UDP));
+
+		sidx[i] = FLOW_SIDX(flow, INISIDE);
+	}
+}
+
+/**
+ * bench_flow() - Measure flow hash table insertion, removal and lookup
+ */
+static void bench_flow(void)
+{
+	static flow_sidx_t sidx[LOOKUP_FLOWS_MAX];
+	struct in_addr guest = { htonl(0xc0000202) };
+	struct in_addr host = { htonl(0xc6336401) };
+	struct meter m;
+	uint64_t r, n;
+	size_t i, j;
+
+	flow_init();
+	flows_add(sidx, LOOKUP_FLOWS_MAX);
+
+	for (i = 0; i < ARRAY_SIZE(flows); i++) {
+		size_t f = flows[i];
+
+		n = rounds(0, f);
+		case_start(&m);
+		for (r = 0; r < n; r++) {
+			for (j = 0; j < f; j++)
+				sink += flow_hash_insert(&c, sidx[j]);
+			for (j = 0; j < f; j++)
+				flow_hash_remove(&c, sidx[j]);
+		}
+		case_report(&m, "flow_hash_insert+remove", f, 0, n * f, 0);
+
+		for (j = 0; j < f; j++)
+			flow_hash_insert(&c, sidx[j]);
+
+		case_start(&m);
+		for (r = 0; r < n; r++) {
+			for (j = 0; j < f; j++) {
+				in_port_t eport = 1024 + j % 60000;
+				in_port_t oport = 53 + j / 60000;
+
+				sink += flow_lookup_af(&c, IPPROTO_UDP, PIF_TAP,
+						       AF_INET, &guest, &host,
+						       eport, oport).flowi;
+			}
+		}
+		case_report(&m, "flow_lookup_af/hit", f, 0, n * f, 0);
+
+		case_start(&m);
+		for (r = 0; r < n; r++) {
+			for (j = 0; j < f; j++) {
+				sink += flow_lookup_af(&c, IPPROTO_UDP, PIF_TAP,
+						       AF_INET, &guest, &host,
+						       j, 1).flowi;
+			}
+		}
+		case_report(&m, "flow_lookup_af/miss", f, 0, n * f, 0);
+
+		for (j = 0; j < f; j++)
+			flow_hash_remove(&c, sidx[j]);
+	}
+}
+
+/**
+ * bench_packet() - Measure filling packet pools, and getting headers back
+ */
+static void bench_packet(void)
+{
+	PACKET_POOL_P(pool, POOL_PACKETS, pkt_buf, sizeof(pkt_buf));
+	struct meter m;
+	uint64_t r, n;
+	size_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		size_t s = sizes[i], count = MIN(POOL_PACKETS,
+						 sizeof(pkt_buf) / s);
+
+		n = rounds(0, count);
+		case_start(&m);
+		for (r = 0; r < n; r++) {
+			pool_flush(pool);
+			for (j = 0; j < count; j++)
+				packet_add(pool, s, pkt_buf + j * s);
+		}
+		case_report(&m, "packet_add", s, 0, n * count, 0);
+
+		case_start(&m);
+		for (r = 0; r < n; r++) {
+			for (j = 0; j < count; j++) {
+				size_t left;
+
+				sink += (uintptr_t)packet_get(pool, j, r % 2,
+							      sizeof(uint32_t),
+							      &left) + left;
+			}
+		}
+		case_report(&m, "packet_get", s, 0, n * count, 0);
+	}
+}
+
+/**
+ * bench_lineread() - Measure reading lines from file
+ */
+static void bench_lineread(void)
+{
+	static const size_t lens[] = { 32, 150, 1024 };
+	struct lineread lr;
+	struct meter m;
+	uint64_t r, n;
+	size_t i, j;
+
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		FILE *f = tmpfile();
+		char *line;
+		ssize_t len;
+
+		if (!f) {
+			perror("tmpfile");
+			exit(EXIT_FAILURE);
+		}
+
+		memset(out, 'x', lens[i] - 1);
+		out[lens[i] - 1] = '\n';
+		for (j = 0; j < LINES; j++)
+			fwrite(out, lens[i], 1, f);
+		fflush(f);
+
+		n = rounds(LINES * lens[i], LINES);
+		case_start(&m);
+		for (r = 0; r < n; r++) {
+			lseek(fileno(f), 0, SEEK_SET);
+			lineread_init(&lr, fileno(f));
+			while ((len = lineread_get(&lr, &line)) > 0)
+				sink += len;
+		}
+		case_report(&m, "lineread_get", lens[i], 0, n * LINES,
+			    n * LINES * lens[i]);
+
+		fclose(f);
+	}
+}
+
+/**
+ * main() - Entry point
+ *
+ * Return: 0 on success
+ */
+int main(void)
+{
+	struct meter m;
+	bool estimated;
+	size_t i;
+
+	__setlogmask(LOG_UPTO(LOG_ERR));
+	log_conf_parsed = true;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 7;
+	c.hash_secret[0] = 0x0123456789abcdef;
+	c.hash_secret[1] = 0xfedcba9876543210;
+
+	case_start(&m);
+	case_cycles = meter_stop(&m, &estimated) >= 0;
+	if (!case_cycles)
+		printf("# cycles not available\n");
+	else if (estimated)
+		printf("# cycles estimated from process CPU time at %.0f MHz\n",
+		       m.mhz);
+	else
+		printf("# cycles from perf events\n");
+	printf("# name size align ns/op bytes/cycle\n");
+
+	bench_csum();
+	bench_iov();
+	bench_flow();
+	bench_packet();
+	bench_lineread();
+
+	return 0;
+}
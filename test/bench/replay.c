@@ -0,0 +1,664 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* replay - Measure passt throughput and cost per packet, without guests
+ *
+ * Copyright Red Hat
+ *
+ * Starts passt in foreground, connects to its UNIX domain socket as qemu would,
+ * and sends frames as fast as passt takes them, for a given time, with each
+ * protocol and a few MTUs. There's no need for guests, iperf3 or neper:
+ *
+ * - UDP: datagrams to the gateway address, which passt maps to the loopback
+ *   address of the host, where a sink socket receives them
+ * - TCP: a minimal sender opens a connection to a sink listening on loopback,
+ *   and sends segments as the window advertised by passt allows
+ * - ICMP: echo requests, up to ICMP_OUTSTANDING at a time, answered by the
+ *   host kernel via passt's ping socket, so this needs ping_group_range set,
+ *   and it's skipped otherwise
+ *
+ * or, if a capture file is given, frames from the guest found there are
+ * replayed in a loop.
+ *
+ * For each case, we report packets per second and throughput as received on
+ * the other side (or as sent, for captures), and CPU cycles used by passt for
+ * each packet, from perf events if available, otherwise estimated from its CPU
+ * time and nominal clock frequency, marked with '~'.
+ *
+ * Usage: replay [PASST [PCAP_FILE]]
+ *
+ * pasta isn't covered, as a fake tap device would need its own namespaces.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+
+#include "util.h"
+#include "checksum.h"
+#include "client.h"
+
+#define DURATION_MS		500	/* Duration of each case */
+#define OUT_BUF_FILL		(512UL << 10)	/* Queue up to this much */
+#define SINK_BUF_BYTES		(4UL << 20)
+#define PCAP_MAX_BYTES		(64UL << 20)
+#define ICMP_OUTSTANDING	64
+#define GUEST_PORT		40000
+#define ECHO_ID			0x9a55
+
+static const size_t mtus[] = { 1500, 9000, 65520 };
+
+static uint8_t sink_buf[SINK_BUF_BYTES];
+static uint8_t payload[ETH_MAX_MTU];
+
+/**
+ * struct result - Results for a single case
+ * @pkts:	Packets received on the other side, or sent, for captures
+ * @bytes:	Bytes of payload, or frames, for captures
+ * @ns:		Duration, nanoseconds
+ * @cycles:	CPU cycles used by passt, negative if not available
+ * @estimated:	@cycles were estimated from CPU time
+ */
+struct result {
+	uint64_t pkts;
+	uint64_t bytes;
+	uint64_t ns;
+	double cycles;
+	bool estimated;
+};
+
+/**
+ * l4_psum() - Partial checksum for layer 4 header and constant payload
+ * @proto:	Layer 4 protocol
+ * @l4len:	Length of layer 4 header and payload
+ * @plen:	Length of payload
+ *
+ * Return: partial checksum, pseudo-header for TCP, plus payload, folded
+ */
+static uint32_t l4_psum(uint8_t proto, size_t l4len, size_t plen)
+{
+	struct in_addr saddr, daddr;
+	uint32_t sum = 0;
+
+	if (proto == IPPROTO_TCP) {
+		inet_pton(AF_INET, GUEST_ADDR, &saddr);
+		inet_pton(AF_INET, GW_ADDR, &daddr);
+		sum = proto_ipv4_header_psum(l4len, proto, saddr, daddr);
+	}
+
+	return csum_fold(csum_unfolded(payload, plen, sum));
+}
+
+/**
+ * run_udp() - Send UDP datagrams to sink on host
+ * @s:		Socket connected to passt
+ * @mtu:	MTU: size of IPv4 packets
+ * @r:		Results, filled on return
+ *
+ * Return: 0 on success, -1 on failure
+ */
+static int run_udp(int s, size_t mtu, struct result *r)
+{
+	size_t plen = mtu - sizeof(struct iphdr) - sizeof(struct udphdr);
+	struct out o = { 0 };
+	size_t len;
+	uint64_t start, end;
+	in_port_t port;
+	int sink, ret = -1;
+
+	if ((sink = sink_open(SOCK_DGRAM, &port)) < 0)
+		return -1;
+
+	/* Checksums are optional for UDP over IPv4, leave them out */
+	do {
+		struct udphdr *uh;
+
+		if (!(uh = (struct udphdr *)frame_ip4(&o, IPPROTO_UDP,
+						      sizeof(*uh) + plen)))
+			break;
+
+		uh->source = htons(GUEST_PORT);
+		uh->dest = htons(port);
+		uh->len = htons(sizeof(*uh) + plen);
+		uh->check = 0;
+		memcpy(uh + 1, payload, plen);
+	} while (o.len < OUT_BUF_FILL);
+	len = o.len;
+
+	start = now_ns();
+	end = start + DURATION_MS * 1000000ULL;
+
+	while (now_ns() < end) {
+		struct pollfd pfd[] = { { s, POLLIN | POLLOUT, 0 },
+					{ sink, POLLIN, 0 } };
+		ssize_t n;
+
+		poll(pfd, ARRAY_SIZE(pfd), 1);
+
+		if (!o.len)
+			o.len = len;	/* Same frames again */
+
+		if (out_write(s, &o) || in_read(s, NULL, NULL))
+			goto out;
+
+		while ((n = recv(sink, sink_buf, sizeof(sink_buf), 0)) >= 0) {
+			r->pkts++;
+			r->bytes += n;
+		}
+	}
+
+	r->ns = now_ns() - start;
+	ret = 0;
+out:
+	close(sink);
+	return ret;
+}
+
+/**
+ * struct tcp_state - State of minimal TCP sender
+ * @established:	Handshake completed
+ * @failed:		Connection reset or closed by passt
+ * @wscale:		Window scaling factor from passt
+ * @snd_una:		Oldest unacknowledged sequence number
+ * @snd_nxt:		Next sequence number to send
+ * @rcv_nxt:		Next sequence number expected from passt
+ * @wnd:		Window advertised by passt, scaled
+ */
+struct tcp_state {
+	bool established;
+	bool failed;
+	unsigned wscale;
+	uint32_t snd_una;
+	uint32_t snd_nxt;
+	uint32_t rcv_nxt;
+	uint32_t wnd;
+};
+
+/**
+ * tcp_frame() - Handle frame from passt for TCP connection
+ * @frame:	Frame
+ * @len:	Length of frame
+ * @arg:	TCP state
+ */
+static void tcp_frame(const uint8_t *frame, size_t len, void *arg)
+{
+	struct tcp_state *t = (struct tcp_state *)arg;
+	const struct tcphdr *th;
+	size_t l4len;
+
+	th = (const struct tcphdr *)frame_l4(frame, len, IPPROTO_TCP, &l4len);
+	if (!th || l4len < sizeof(*th) || th->dest != htons(GUEST_PORT))
+		return;
+
+	if (th->rst || th->fin) {
+		t->failed = true;
+		return;
+	}
+
+	if (th->syn && th->ack) {
+		const uint8_t *opt = (const uint8_t *)(th + 1);
+		const uint8_t *end = (const uint8_t *)th + th->doff * 4;
+
+		while (opt < end && *opt != TCPOPT_EOL) {
+			if (*opt == TCPOPT_NOP) {
+				opt++;
+				continue;
+			}
+			if (opt + 1 >= end || opt[1] < 2)
+				break;
+			if (*opt == TCPOPT_WINDOW && opt[1] == TCPOLEN_WINDOW)
+				t->wscale = opt[2];
+			opt += opt[1];
+		}
+
+		t->rcv_nxt = ntohl(th->seq) + 1;
+		t->snd_una = ntohl(th->ack_seq);
+		t->wnd = ntohs(th->window);
+		t->established = true;
+		return;
+	}
+
+	if (th->ack && (int32_t)(ntohl(th->ack_seq) - t->snd_una) >= 0) {
+		t->snd_una = ntohl(th->ack_seq);
+		t->wnd = (uint32_t)ntohs(th->window) << t->wscale;
+	}
+}
+
+/**
+ * tcp_segment() - Queue TCP segment to passt
+ * @o:		Output queue
+ * @t:		TCP state
+ * @flags:	TCP flags, as in byte 13 of the header
+ * @plen:	Length of payload, or MSS to advertise, for SYN segments
+ * @psum:	Partial checksum from l4_psum()
+ * @port:	Destination port, host order
+ *
+ * Return: 0 on success, -1 if output buffer is full
+ */
+static int tcp_segment(struct out *o, struct tcp_state *t, uint8_t flags,
+		       size_t plen, uint32_t psum, in_port_t port)
+{
+	size_t hlen = sizeof(struct tcphdr) + ((flags & TH_SYN) ? 8 : 0);
+	size_t dlen = (flags & TH_SYN) ? 0 : plen;
+	struct tcphdr *th;
+	uint8_t *opt;
+
+	if (!(th = (struct tcphdr *)frame_ip4(o, IPPROTO_TCP, hlen + dlen)))
+		return -1;
+
+	memset(th, 0, hlen);
+	th->source = htons(GUEST_PORT);
+	th->dest = htons(port);
+	th->seq = htonl(t->snd_nxt);
+	th->ack_seq = htonl(t->rcv_nxt);
+	th->doff = hlen / 4;
+	((uint8_t *)th)[13] = flags;
+	th->window = htons(USHRT_MAX);
+
+	if (flags & TH_SYN) {
+		uint16_t mss = htons(plen ? plen : USHRT_MAX);
+
+		opt = (uint8_t *)(th + 1);
+		opt[0] = TCPOPT_MAXSEG;
+		opt[1] = TCPOLEN_MAXSEG;
+		memcpy(opt + 2, &mss, sizeof(mss));
+		opt[4] = TCPOPT_NOP;
+		opt[5] = TCPOPT_WINDOW;
+		opt[6] = TCPOLEN_WINDOW;
+		opt[7] = 7;
+		t->snd_nxt++;
+	} else {
+		memcpy((uint8_t *)th + hlen, payload, plen);
+		t->snd_nxt += plen;
+	}
+
+	th->check = csum(th, hlen, psum);
+	return 0;
+}
+
+/**
+ * run_tcp() - Open TCP connection to sink on host, send data
+ * @s:		Socket connected to passt
+ * @mtu:	MTU: size of IPv4 packets
+ * @r:		Results, filled on return
+ *
+ * Return: 0 on success, -1 on failure
+ */
+static int run_tcp(int s, size_t mtu, struct result *r)
+{
+	size_t mss = mtu - sizeof(struct iphdr) - sizeof(struct tcphdr);
+	struct tcp_state t = { .snd_nxt = 1 };
+	int sink, conn = -1, ret = -1;
+	uint32_t psum_syn, psum_data;
+	uint64_t start = 0, end;
+	struct out o = { 0 };
+	in_port_t port;
+
+	/* Real MTU limit for TCP over IPv4 is lower than 65535 - 40 */
+	mss = MIN(mss, USHRT_MAX - sizeof(struct iphdr) -
+		       sizeof(struct tcphdr) - 4);
+
+	if ((sink = sink_open(SOCK_STREAM, &port)) < 0)
+		return -1;
+
+	psum_syn = l4_psum(IPPROTO_TCP, sizeof(struct tcphdr) + 8, 0);
+	psum_data = l4_psum(IPPROTO_TCP, sizeof(struct tcphdr) + mss, mss);
+
+	tcp_segment(&o, &t, TH_SYN, mss, psum_syn, port);
+
+	end = now_ns() + 1000 * 1000000ULL;	/* Handshake timeout */
+
+	while (!t.failed && now_ns() < end) {
+		struct pollfd pfd[] = { { s, POLLIN | POLLOUT, 0 },
+					{ conn < 0 ? sink : conn, POLLIN, 0 } };
+
+		poll(pfd, ARRAY_SIZE(pfd), 1);
+
+		if (out_write(s, &o) || in_read(s, tcp_frame, &t))
+			goto out;
+
+		if (conn < 0) {
+			conn = accept4(sink, NULL, NULL, SOCK_NONBLOCK);
+		} else {
+			ssize_t n;
+
+			while ((n = recv(conn, sink_buf,
+					 sizeof(sink_buf), 0)) > 0) {
+				if (start)
+					r->bytes += n;
+			}
+		}
+
+		if (!t.established)
+			continue;
+
+		if (!start) {
+			/* ACK for SYN, ACK: handshake done, start measuring */
+			tcp_segment(&o, &t, TH_ACK, 0, l4_psum(IPPROTO_TCP,
+				    sizeof(struct tcphdr), 0), port);
+			start = now_ns();
+			end = start + DURATION_MS * 1000000ULL;
+		}
+
+		while (o.len < OUT_BUF_FILL &&
+		       t.snd_nxt - t.snd_una + mss <= t.wnd) {
+			if (tcp_segment(&o, &t, TH_ACK, mss, psum_data, port))
+				break;
+		}
+	}
+
+	if (!start || t.failed) {
+		fprintf(stderr, "TCP connection %s\n",
+			start ? "reset by passt" : "not established");
+		goto out;
+	}
+
+	r->ns = now_ns() - start;
+	r->pkts = r->bytes / mss;
+	ret = 0;
+out:
+	if (conn >= 0)
+		close(conn);
+	close(sink);
+	return ret;
+}
+
+/**
+ * icmp_frame() - Handle frame from passt, count echo replies
+ * @frame:	Frame
+ * @len:	Length of frame
+ * @arg:	Results to update
+ */
+static void icmp_frame(const uint8_t *frame, size_t len, void *arg)
+{
+	struct result *r = (struct result *)arg;
+	const struct icmphdr *ih;
+	size_t l4len;
+
+	ih = (const struct icmphdr *)frame_l4(frame, len, IPPROTO_ICMP, &l4len);
+	if (!ih || ih->type != ICMP_ECHOREPLY)
+		return;
+
+	r->pkts++;
+	r->bytes += l4len - sizeof(*ih);
+}
+
+/**
+ * ping_enabled() - Check if ping_group_range allows ping sockets at all
+ *
+ * Return: false if ping sockets are disabled, true otherwise or if unknown
+ */
+static bool ping_enabled(void)
+{
+	unsigned long lo, hi;
+	bool ret = true;
+	FILE *f;
+
+	if (!(f = fopen("/proc/sys/net/ipv4/ping_group_range", "r")))
+		return true;
+
+	if (fscanf(f, "%lu %lu", &lo, &hi) == 2)
+		ret = lo <= hi;
+
+	fclose(f);
+	return ret;
+}
+
+/**
+ * run_icmp() - Send echo requests to host, count replies
+ * @s:		Socket connected to passt
+ * @mtu:	MTU: size of IPv4 packets
+ * @r:		Results, filled on return
+ *
+ * Return: 0 on success, -1 on failure, including if no replies came back
+ */
+static int run_icmp(int s, size_t mtu, struct result *r)
+{
+	size_t plen = mtu - sizeof(struct iphdr) - sizeof(struct icmphdr);
+	uint32_t psum = l4_psum(IPPROTO_ICMP, 0, plen);
+	struct out o = { 0 };
+	uint64_t start, end;
+	uint16_t seq = 0;
+
+	start = now_ns();
+	end = start + DURATION_MS * 1000000ULL;
+
+	while (now_ns() < end) {
+		struct pollfd pfd = { s, POLLIN | POLLOUT, 0 };
+
+		while ((uint16_t)(seq - r->pkts) < ICMP_OUTSTANDING) {
+			struct icmphdr *ih;
+
+			ih = (struct icmphdr *)frame_ip4(&o, IPPROTO_ICMP,
+							 sizeof(*ih) + plen);
+			if (!ih)
+				break;
+
+			*ih = (struct icmphdr){ .type = ICMP_ECHO };
+			ih->un.echo.id = htons(ECHO_ID);
+			ih->un.echo.sequence = htons(seq++);
+			memcpy(ih + 1, payload, plen);
+			ih->checksum = csum(ih, sizeof(*ih), psum);
+		}
+
+		poll(&pfd, 1, 1);
+
+		if (out_write(s, &o) || in_read(s, icmp_frame, r))
+			return -1;
+	}
+
+	r->ns = now_ns() - start;
+
+	if (!r->pkts) {
+		fprintf(stderr, "No echo replies from host\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * pcap_load() - Queue frames from guest found in capture file
+ * @path:	Path to capture file, classic pcap format, Ethernet frames
+ * @o:		Output queue
+ *
+ * Return: number of frames queued, -1 on failure
+ */
+static int pcap_load(const char *path, struct out *o)
+{
+	struct {
+		uint32_t magic;
+		uint16_t major, minor;
+		int32_t thiszone;
+		uint32_t sigfigs, snaplen, linktype;
+	} hdr;
+	struct {
+		uint32_t sec, usec, caplen, len;
+	} rec;
+	int n = 0;
+	FILE *f;
+
+	if (!(f = fopen(path, "r"))) {
+		perror(path);
+		return -1;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    (hdr.magic != 0xa1b2c3d4 && hdr.magic != 0xa1b23c4d) ||
+	    hdr.linktype != 1 /* Ethernet */) {
+		fprintf(stderr, "%s: not a pcap file with Ethernet frames\n",
+			path);
+		fclose(f);
+		return -1;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, f) == 1) {
+		uint32_t vnet_len = htonl(rec.caplen);
+		uint8_t *p = out_buf + o->len;
+
+		if (o->len + sizeof(vnet_len) + rec.caplen > PCAP_MAX_BYTES ||
+		    o->len + sizeof(vnet_len) + rec.caplen > sizeof(out_buf))
+			break;
+
+		if (fread(p + sizeof(vnet_len), rec.caplen, 1, f) != 1)
+			break;
+
+		/* Skip truncated frames, and frames passt sent to the guest */
+		if (rec.caplen != rec.len || rec.caplen < ETH_HLEN ||
+		    !memcmp(p + sizeof(vnet_len) + ETH_ALEN, passt_mac,
+			    ETH_ALEN))
+			continue;
+
+		memcpy(p, &vnet_len, sizeof(vnet_len));
+		o->len += sizeof(vnet_len) + rec.caplen;
+		n++;
+	}
+
+	fclose(f);
+	return n;
+}
+
+/**
+ * run_pcap() - Replay frames from capture file in a loop
+ * @s:		Socket connected to passt
+ * @path:	Path to capture file
+ * @r:		Results, filled on return
+ *
+ * Return: 0 on success, -1 on failure
+ */
+static int run_pcap(int s, const char *path, struct result *r)
+{
+	struct out o = { 0 };
+	uint64_t start, end;
+	size_t len;
+	int frames;
+
+	if ((frames = pcap_load(path, &o)) <= 0)
+		return -1;
+
+	len = o.len;
+	start = now_ns();
+	end = start + DURATION_MS * 1000000ULL;
+
+	while (now_ns() < end) {
+		struct pollfd pfd = { s, POLLIN | POLLOUT, 0 };
+
+		poll(&pfd, 1, 1);
+
+		if (out_write(s, &o) || in_read(s, NULL, NULL))
+			return -1;
+
+		if (!o.len) {
+			r->pkts += frames;
+			r->bytes += len - frames * sizeof(uint32_t);
+			o.len = len;
+		}
+	}
+
+	r->ns = now_ns() - start;
+	return 0;
+}
+
+/**
+ * report() - Print results for a single case
+ * @name:	Name of case
+ * @mtu:	MTU, 0 if not applicable
+ * @r:		Results
+ */
+static void report(const char *name, size_t mtu, const struct result *r)
+{
+	char cycles[BUFSIZ], size[BUFSIZ] = "(file)   ";
+	double secs = r->ns / 1e9;
+
+	if (mtu)
+		snprintf(size, sizeof(size), "mtu %5zu", mtu);
+
+	if (r->cycles < 0 || !r->pkts)
+		snprintf(cycles, sizeof(cycles), "n/a");
+	else
+		snprintf(cycles, sizeof(cycles), "%s%.0f",
+			 r->estimated ? "~" : "", r->cycles / r->pkts);
+
+	printf("replay %-4s %s: %10.0f pkt/s %7.2f Gbps %8s cycles/pkt\n",
+	       name, size, r->pkts / secs, r->bytes * 8 / secs / 1e9, cycles);
+}
+
+/**
+ * main() - Entry point
+ * @argc:	Argument count
+ * @argv:	Path to passt, default: ./passt, then optional capture file
+ *
+ * Return: 0 on success, 1 on failure
+ */
+int main(int argc, char **argv)
+{
+	static const struct {
+		const char *name;
+		int (*run)(int s, size_t mtu, struct result *r);
+	} cases[] = {
+		{ "udp",	run_udp },
+		{ "tcp",	run_tcp },
+		{ "icmp",	run_icmp },
+	};
+	static const char *const args[] = { "-t", "none", "-u", "none", "-4",
+					    NULL };
+	const char *passt = argc > 1 ? argv[1] : "./passt";
+	unsigned i, j;
+	size_t k;
+
+	signal(SIGPIPE, SIG_IGN);
+
+	for (k = 0; k < sizeof(payload); k++)
+		payload[k] = k;
+
+	for (i = 0; i < (argc > 2 ? 1 : ARRAY_SIZE(cases)); i++) {
+		if (argc <= 2 && cases[i].run == run_icmp && !ping_enabled()) {
+			printf("replay icmp: ping sockets disabled by "
+			       "ping_group_range, skipped\n");
+			continue;
+		}
+
+		for (j = 0; j < (argc > 2 ? 1 : ARRAY_SIZE(mtus)); j++) {
+			struct result r = { 0 };
+			struct meter m;
+			pid_t pid;
+			int s, ret;
+
+			if ((s = passt_start(passt, args, &pid)) < 0)
+				return 1;
+
+			meter_start(&m, pid);
+			if (argc > 2)
+				ret = run_pcap(s, argv[2], &r);
+			else
+				ret = cases[i].run(s, mtus[j], &r);
+			r.cycles = meter_stop(&m, &r.estimated);
+
+			passt_stop(s, pid);
+
+			if (ret) {
+				fprintf(stderr, "Failed to run %s\n",
+					argc > 2 ? argv[2] : cases[i].name);
+				return 1;
+			}
+
+			report(argc > 2 ? "pcap" : cases[i].name,
+			       argc > 2 ? 0 : mtus[j], &r);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,689 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* PASST - Plug A Simple Socket Transport
+ *  for qemu/UNIX domain socket mode
+ *
+ * PASTA - Pack A Subtle Tap Abstraction
+ *  for network namespace/tap device mode
+ *
+ * trace_ring.c - Binary ring of debug and trace messages, formatted on dump
+ *
+ * Copyright Red Hat
+ *
+ * Formatting debug messages with vsnprintf(), and writing them out one by one,
+ * slows down the data path several times, so debug logging can't be used on
+ * busy instances. With --trace-ring, debug and trace messages are stored
+ * instead in a ring of fixed-size entries: a timestamp, a pointer to the format
+ * string, which is always a string literal, and arguments in binary form, as
+ * taken from the va_list according to conversion specifications in the format.
+ * Strings are copied, as they might be temporary buffers. Arguments not fitting
+ * an entry continue in the following ones, up to TRACE_RING_SPAN_MAX entries
+ * for a single message, so that messages with IPv6 addresses, for example, are
+ * complete. Beyond that, arguments are truncated.
+ *
+ * Formatting is deferred until we write the ring out, oldest entries first, to
+ * the file given by --trace-ring, whenever we receive SIGUSR1. We're
+ * single-threaded, and the signal handler only sets a flag, so that the ring is
+ * read from the main loop, like statistics are: no locking is needed.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+#include "util.h"
+#include "ip.h"
+#include "passt.h"
+#include "log.h"
+#include "trace_ring.h"
+
+#define TRACE_RING_BUF		65536	/* Output buffer for writes */
+#define TRACE_RING_LINE_MAX	1024	/* Maximum length of formatted entry */
+#define TRACE_RING_SPEC_MAX	32	/* Maximum conversion specification */
+#define TRACE_RING_ARGS		90	/* Argument bytes in a single entry */
+#define TRACE_RING_SPAN_MAX	4	/* Entries a single message can span */
+
+/* Entry only holds further arguments for the message in the previous one */
+#define TRACE_RING_EXT		BIT(7)
+
+/**
+ * struct trace_entry - Entry in trace ring
+ * @ts:		Timestamp, CLOCK_MONOTONIC
+ * @fmt:	Format string, string literal
+ * @flow_type:	Type or state of flow, string literal, NULL if not flow-related
+ * @flow:	Flow index, if @flow_type is set
+ * @flags:	TRACE_RING_* flags
+ * @len:	Bytes used in @args
+ * @args:	Arguments for @fmt, packed, sized for 128-byte entries on 64-bit
+ */
+struct trace_entry {
+	struct timespec ts;
+	const char *fmt;
+	const char *flow_type;
+	uint32_t flow;
+	uint8_t flags;
+	uint8_t len;
+	uint8_t args[TRACE_RING_ARGS];
+};
+
+/**
+ * struct trace_args - Arguments of a message, gathered from all its entries
+ * @len:	Bytes used in @buf
+ * @buf:	Arguments for format string, packed
+ */
+struct trace_args {
+	size_t len;
+	uint8_t buf[TRACE_RING_ARGS * TRACE_RING_SPAN_MAX];
+};
+
+/**
+ * enum trace_arg - Types of arguments for conversion specifications
+ * @TRACE_ARG_NONE:	No argument, "%%"
+ * @TRACE_ARG_INT:	int, or smaller integer types, promoted
+ * @TRACE_ARG_LONG:	long, also size_t and ptrdiff_t, as they're long-sized
+ * @TRACE_ARG_LLONG:	long long, also intmax_t
+ * @TRACE_ARG_PTR:	Pointer, printed as such
+ * @TRACE_ARG_DOUBLE:	double
+ * @TRACE_ARG_STR:	String, copied
+ * @TRACE_ARG_BAD:	Unsupported conversion, stop there
+ */
+enum trace_arg {
+	TRACE_ARG_NONE,
+	TRACE_ARG_INT,
+	TRACE_ARG_LONG,
+	TRACE_ARG_LLONG,
+	TRACE_ARG_PTR,
+	TRACE_ARG_DOUBLE,
+	TRACE_ARG_STR,
+	TRACE_ARG_BAD,
+};
+
+/**
+ * struct trace_spec - Parsed conversion specification
+ * @len:	Length of specification, including '%'
+ * @width:	Width is given as argument ('*')
+ * @prec:	Precision is given as argument ('*')
+ * @arg:	Type of argument
+ */
+struct trace_spec {
+	size_t len;
+	bool width;
+	bool prec;
+	enum trace_arg arg;
+};
+
+static struct trace_entry trace_ring[TRACE_RING_ENTRIES];
+static unsigned long trace_ring_head;	/* Free-running count of entries */
+static unsigned long trace_ring_msgs;	/* Free-running count of messages */
+static int trace_ring_fd = -1;		/* File we write the ring to */
+static volatile sig_atomic_t trace_ring_pending;
+
+bool trace_ring_on;			/* Debug messages go to ring */
+
+/**
+ * trace_spec_parse() - Parse printf() conversion specification
+ * @p:		Start of specification, pointing to '%'
+ * @s:		Parsed specification, filled on return
+ */
+static void trace_spec_parse(const char *p, struct trace_spec *s)
+{
+	static const char *digits = "0123456789";
+	const char *start = p++;
+	unsigned l = 0;
+
+	s->width = s->prec = false;
+
+	p += strspn(p, "-+ #0");
+
+	if (*p == '*') {
+		s->width = true;
+		p++;
+	} else {
+		p += strspn(p, digits);
+	}
+
+	if (*p == '.') {
+		if (*++p == '*') {
+			s->prec = true;
+			p++;
+		} else {
+			p += strspn(p, digits);
+		}
+	}
+
+	/* Only 'l', 'z', 't' and 'j' change the size of integer arguments */
+	for (; *p && strchr("hlzjt", *p); p++) {
+		if (*p == 'j')
+			l = 2;
+		else if (*p != 'h')
+			l++;
+	}
+
+	switch (*p) {
+	case '%':
+		s->arg = TRACE_ARG_NONE;
+		break;
+	case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+		if (l >= 2)
+			s->arg = TRACE_ARG_LLONG;
+		else
+			s->arg = l ? TRACE_ARG_LONG : TRACE_ARG_INT;
+		break;
+	case 'p':
+		s->arg = TRACE_ARG_PTR;
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+	case 'a': case 'A':
+		s->arg = TRACE_ARG_DOUBLE;
+		break;
+	case 's':
+		s->arg = TRACE_ARG_STR;
+		break;
+	default:
+		s->arg = TRACE_ARG_BAD;
+		s->len = p - start;
+		return;
+	}
+
+	s->len = p + 1 - start;
+	if (s->len >= TRACE_RING_SPEC_MAX)
+		s->arg = TRACE_ARG_BAD;
+}
+
+/**
+ * trace_ring_room() - Make room for argument, in next entry if needed
+ * @e:		Current entry for message, updated on return
+ * @span:	Entries used by message, updated on return
+ * @len:	Length of argument
+ *
+ * Arguments are never split across entries, so that, gathered back, they're
+ * packed as if the entry was a single, larger one.
+ *
+ * Return: 0 on success, -1 if the message can't take further arguments
+ */
+static int trace_ring_room(struct trace_entry **e, unsigned *span, size_t len)
+{
+	struct trace_entry *ext;
+
+	if ((*e)->len + len <= sizeof((*e)->args))
+		return 0;
+
+	if (*span >= TRACE_RING_SPAN_MAX || len > sizeof((*e)->args))
+		return -1;
+
+	ext = &trace_ring[trace_ring_head++ % TRACE_RING_ENTRIES];
+	ext->ts = (*e)->ts;
+	ext->fmt = NULL;
+	ext->flow_type = NULL;
+	ext->flags = TRACE_RING_EXT;
+	ext->len = 0;
+
+	(*span)++;
+	*e = ext;
+	return 0;
+}
+
+/**
+ * trace_ring_put() - Append argument to message
+ * @e:		Current entry for message, updated on return
+ * @span:	Entries used by message, updated on return
+ * @v:		Argument, in binary form
+ * @len:	Length of argument
+ *
+ * Return: 0 on success, -1 if it doesn't fit
+ */
+static int trace_ring_put(struct trace_entry **e, unsigned *span,
+			  const void *v, size_t len)
+{
+	if (trace_ring_room(e, span, len))
+		return -1;
+
+	memcpy((*e)->args + (*e)->len, v, len);
+	(*e)->len += len;
+	return 0;
+}
+
+/**
+ * trace_ring_get() - Fetch next argument of message
+ * @a:		Arguments of message
+ * @off:	Offset of argument, updated on return
+ * @v:		Argument, in binary form, filled on return
+ * @len:	Length of argument
+ *
+ * Return: 0 on success, -1 if message has no more arguments
+ */
+static int trace_ring_get(const struct trace_args *a, size_t *off, void *v,
+			  size_t len)
+{
+	if (*off + len > a->len)
+		return -1;
+
+	memcpy(v, a->buf + *off, len);
+	*off += len;
+	return 0;
+}
+
+/**
+ * trace_ring_vadd() - Add message to ring, storing arguments in binary form
+ * @flow_type:	Type or state of flow, string literal, NULL if not flow-related
+ * @flow:	Flow index, if @flow_type is given
+ * @flags:	TRACE_RING_NEWLINE, TRACE_RING_CONT
+ * @fmt:	Format string, needs to be a string literal
+ * @ap:		Arguments for @fmt, consumed
+ *
+ * If arguments don't fit in TRACE_RING_SPAN_MAX entries, we stop storing them,
+ * and the message is shown as truncated once formatted.
+ */
+void trace_ring_vadd(const char *flow_type, unsigned flow, unsigned flags,
+		     const char *fmt, va_list ap)
+{
+	struct trace_entry *e;
+	struct trace_spec s;
+	unsigned span = 1;
+	const char *p;
+
+	e = &trace_ring[trace_ring_head++ % TRACE_RING_ENTRIES];
+	trace_ring_msgs++;
+
+	(void)clock_gettime(CLOCK_MONOTONIC, &e->ts);
+	e->fmt = fmt;
+	e->flow_type = flow_type;
+	e->flow = flow;
+	e->flags = flags;
+	e->len = 0;
+
+	for (p = fmt; (p = strchr(p, '%')); p += s.len) {
+		int star;
+
+		trace_spec_parse(p, &s);
+
+		if (s.width) {
+			star = va_arg(ap, int);
+			if (trace_ring_put(&e, &span, &star, sizeof(star)))
+				return;
+		}
+
+		if (s.prec) {
+			star = va_arg(ap, int);
+			if (trace_ring_put(&e, &span, &star, sizeof(star)))
+				return;
+		}
+
+		switch (s.arg) {
+		case TRACE_ARG_NONE:
+			break;
+		case TRACE_ARG_INT: {
+			int v = va_arg(ap, int);
+
+			if (trace_ring_put(&e, &span, &v, sizeof(v)))
+				return;
+			break;
+		}
+		case TRACE_ARG_LONG: {
+			long v = va_arg(ap, long);
+
+			if (trace_ring_put(&e, &span, &v, sizeof(v)))
+				return;
+			break;
+		}
+		case TRACE_ARG_LLONG: {
+			long long v = va_arg(ap, long long);
+
+			if (trace_ring_put(&e, &span, &v, sizeof(v)))
+				return;
+			break;
+		}
+		case TRACE_ARG_PTR: {
+			const void *v = va_arg(ap, const void *);
+
+			if (trace_ring_put(&e, &span, &v, sizeof(v)))
+				return;
+			break;
+		}
+		case TRACE_ARG_DOUBLE: {
+			double v = va_arg(ap, double);
+
+			if (trace_ring_put(&e, &span, &v, sizeof(v)))
+				return;
+			break;
+		}
+		case TRACE_ARG_STR: {
+			const char *v = va_arg(ap, const char *);
+			size_t n;
+
+			if (!v)
+				v = "(null)";
+
+			/* Truncate strings only if they don't fit any entry */
+			n = strnlen(v, sizeof(e->args) - 1);
+			if (trace_ring_room(&e, &span, n + 1))
+				return;
+
+			memcpy(e->args + e->len, v, n);
+			e->args[e->len + n] = '\0';
+			e->len += n + 1;
+			break;
+		}
+		case TRACE_ARG_BAD:
+			return;
+		}
+	}
+}
+
+/**
+ * trace_spec_fill() - Copy conversion specification, replacing '*' by values
+ * @a:		Arguments of message
+ * @off:	Offset of next argument, updated on return
+ * @spec:	Buffer for specification, TRACE_RING_SPEC_MAX * 2 bytes
+ * @p:		Specification in format string
+ * @s:		Parsed specification
+ *
+ * Return: 0 on success, -1 if message has no more arguments
+ */
+static int trace_spec_fill(const struct trace_args *a, size_t *off,
+			   char *spec, const char *p, const struct trace_spec *s)
+{
+	const char *end = p + s->len;
+	int n = 0, star;
+
+	for (; p < end; p++) {
+		if (*p != '*') {
+			spec[n++] = *p;
+			continue;
+		}
+
+		if (trace_ring_get(a, off, &star, sizeof(star)))
+			return -1;
+
+		/* Negative precision is the same as no precision at all */
+		if (star < 0 && n && spec[n - 1] == '.')
+			n--;
+		else
+			n += sprintf(spec + n, "%i", star);
+	}
+
+	spec[n] = '\0';
+	return 0;
+}
+
+/**
+ * trace_ring_fmt() - Format message from entry, without timestamp
+ * @buf:	Output buffer
+ * @size:	Size of @buf, at least one byte
+ * @e:		Ring entry
+ * @a:		Arguments of message, gathered from @e and its extensions
+ *
+ * Return: length of formatted message, excluding terminator
+ */
+static size_t trace_ring_fmt(char *buf, size_t size,
+			     const struct trace_entry *e,
+			     const struct trace_args *a)
+{
+	const char *p = e->fmt, *next;
+	size_t o = 0, off = 0;
+
+	for (; *p; p = next) {
+		char spec[TRACE_RING_SPEC_MAX * 2];
+		struct trace_spec s;
+		int n = 0;
+
+		if (*p != '%') {
+			if (!(next = strchr(p, '%')))
+				next = p + strlen(p);
+			n = MIN((size_t)(next - p), size - 1 - o);
+			memcpy(buf + o, p, n);
+			o += n;
+			continue;
+		}
+
+		trace_spec_parse(p, &s);
+		next = p + s.len;
+
+		if (s.arg == TRACE_ARG_BAD ||
+		    trace_spec_fill(a, &off, spec, p, &s))
+			goto trunc;
+
+		/* Formats were checked by the compiler when we stored them,
+		 * and arguments have the types they were checked against
+		 */
+		switch (s.arg) {
+		case TRACE_ARG_NONE:
+			n = snprintf(buf + o, size - o, "%%");
+			break;
+		case TRACE_ARG_INT: {
+			int v;
+
+			if (trace_ring_get(a, &off, &v, sizeof(v)))
+				goto trunc;
+			n = snprintf(buf + o, size - o, spec, v);
+			break;
+		}
+		case TRACE_ARG_LONG: {
+			long v;
+
+			if (trace_ring_get(a, &off, &v, sizeof(v)))
+				goto trunc;
+			n = snprintf(buf + o, size - o, spec, v);
+			break;
+		}
+		case TRACE_ARG_LLONG: {
+			long long v;
+
+			if (trace_ring_get(a, &off, &v, sizeof(v)))
+				goto trunc;
+			n = snprintf(buf + o, size - o, spec, v);
+			break;
+		}
+		case TRACE_ARG_PTR: {
+			const void *v;
+
+			if (trace_ring_get(a, &off, &v, sizeof(v)))
+				goto trunc;
+			n = snprintf(buf + o, size - o, spec, v);
+			break;
+		}
+		case TRACE_ARG_DOUBLE: {
+			double v;
+
+			if (trace_ring_get(a, &off, &v, sizeof(v)))
+				goto trunc;
+			n = snprintf(buf + o, size - o, spec, v);
+			break;
+		}
+		case TRACE_ARG_STR: {
+			const char *v = (const char *)a->buf + off;
+
+			if (off >= a->len)
+				goto trunc;
+			off += strlen(v) + 1;
+			n = snprintf(buf + o, size - o, spec, v);
+			break;
+		}
+		case TRACE_ARG_BAD:
+			break;
+		}
+
+		if (n > 0)
+			o = MIN(o + n, size - 1);
+	}
+
+	buf[o] = '\0';
+	return o;
+
+trunc:
+	/* Arguments didn't fit in the entries, see trace_ring_vadd() */
+	o += snprintf(buf + o, size - o, " [...]");
+	o = MIN(o, size - 1);
+	buf[o] = '\0';
+	return o;
+}
+
+/**
+ * trace_ring_line() - Format entry as a line for output, like log files
+ * @buf:	Output buffer
+ * @size:	Size of @buf, at least one byte
+ * @e:		Ring entry
+ * @a:		Arguments of message, gathered from @e and its extensions
+ *
+ * Return: length of formatted line, excluding terminator
+ */
+static size_t trace_ring_line(char *buf, size_t size,
+			      const struct trace_entry *e,
+			      const struct trace_args *a)
+{
+	size_t o = 0;
+	int n = 0;
+
+	if (!(e->flags & TRACE_RING_CONT)) {
+		int64_t delta = timespec_diff_us(&e->ts, &log_start);
+
+		n = snprintf(buf, size, "%lli.%04lli: ", delta / 1000000LL,
+			     (delta / 100LL) % 10000);
+	}
+
+	if (e->flow_type && n >= 0 && (size_t)n < size) {
+		n += snprintf(buf + n, size - n, "Flow %u (%s): ", e->flow,
+			      e->flow_type);
+	}
+
+	if (n > 0)
+		o = MIN((size_t)n, size - 1);
+
+	o += trace_ring_fmt(buf + o, size - o, e, a);
+
+	if ((e->flags & TRACE_RING_NEWLINE) && (!o || buf[o - 1] != '\n') &&
+	    o < size - 1) {
+		buf[o++] = '\n';
+		buf[o] = '\0';
+	}
+
+	return o;
+}
+
+/**
+ * trace_ring_sigusr1() - Signal handler for SIGUSR1: request dump to file
+ * @signal:	Unused, handler deals with SIGUSR1 only
+ *
+ * #syscalls rt_sigreturn|sigreturn
+ * #syscalls arm:sigreturn ppc64:sigreturn s390x:sigreturn i686:sigreturn
+ */
+static void trace_ring_sigusr1(int signal)
+{
+	(void)signal;
+
+	trace_ring_pending = 1;
+}
+
+/**
+ * trace_ring_handler() - Write out formatted ring, if requested via SIGUSR1
+ *
+ * #syscalls ftruncate pwrite64
+ */
+void trace_ring_handler(void)
+{
+	static char buf[TRACE_RING_BUF];
+	unsigned long i = 0, first, msgs = 0;
+	off_t off = 0;
+	size_t n;
+
+	if (!trace_ring_pending)
+		return;
+
+	trace_ring_pending = 0;
+
+	if (trace_ring_head > TRACE_RING_ENTRIES)
+		i = trace_ring_head - TRACE_RING_ENTRIES;
+
+	for (first = i; i < trace_ring_head; i++) {
+		if (!(trace_ring[i % TRACE_RING_ENTRIES].flags & TRACE_RING_EXT))
+			msgs++;
+	}
+
+	n = snprintf(buf, sizeof(buf), "Trace ring: %lu messages, %lu overwritten\n",
+		     msgs, trace_ring_msgs - msgs);
+
+	if (ftruncate(trace_ring_fd, 0))
+		goto err;
+
+	for (i = first; i < trace_ring_head; i++) {
+		const struct trace_entry *e, *ext;
+		struct trace_args a;
+
+		e = &trace_ring[i % TRACE_RING_ENTRIES];
+
+		/* Further arguments of a message we already overwrote */
+		if (e->flags & TRACE_RING_EXT)
+			continue;
+
+		memcpy(a.buf, e->args, e->len);
+		a.len = e->len;
+
+		for (; i + 1 < trace_ring_head; i++) {
+			ext = &trace_ring[(i + 1) % TRACE_RING_ENTRIES];
+			if (!(ext->flags & TRACE_RING_EXT) ||
+			    a.len + ext->len > sizeof(a.buf))
+				break;
+
+			memcpy(a.buf + a.len, ext->args, ext->len);
+			a.len += ext->len;
+		}
+
+		if (sizeof(buf) - n < TRACE_RING_LINE_MAX) {
+			if (pwrite(trace_ring_fd, buf, n, off) < (ssize_t)n)
+				goto err;
+			off += n;
+			n = 0;
+		}
+
+		n += trace_ring_line(buf + n, TRACE_RING_LINE_MAX, e, &a);
+	}
+
+	if (pwrite(trace_ring_fd, buf, n, off) < (ssize_t)n)
+		goto err;
+
+	return;
+err:
+	warn_perror("Couldn't write trace ring to file");
+}
+
+/**
+ * trace_ring_init() - Open output file, set up ring if configured
+ * @c:		Execution context
+ */
+void trace_ring_init(const struct ctx *c)
+{
+	struct sigaction sa = { .sa_handler = trace_ring_sigusr1 };
+	sigset_t set;
+
+	if (!*c->trace_ring)
+		return;
+
+	trace_ring_fd = output_file_open(c->trace_ring, O_WRONLY);
+	if (trace_ring_fd < 0)
+		die_perror("Couldn't open trace ring file %s", c->trace_ring);
+
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGUSR1, &sa, NULL))
+		die_perror("Couldn't install handler for SIGUSR1");
+
+	/* pasta_start_ns() blocks SIGUSR1 so that the child inherits that */
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	if (sigprocmask(SIG_UNBLOCK, &set, NULL))
+		die_perror("Couldn't unblock SIGUSR1");
+
+	info("Recording debug messages, writing them to %s on SIGUSR1",
+	     c->trace_ring);
+
+	trace_ring_on = true;
+	trace_init(1);
+}
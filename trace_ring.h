@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Binary ring of debug and trace messages, formatted only when written out
+ */
+
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+
+#define TRACE_RING_ENTRIES	(1 << 15)	/* 128 bytes each: 4 MiB */
+
+/* Flags for entries */
+#define TRACE_RING_NEWLINE	BIT(0)	/* Append newline, if missing */
+#define TRACE_RING_CONT		BIT(1)	/* Continuation of previous entry */
+
+extern bool trace_ring_on;
+
+void trace_ring_vadd(const char *flow_type, unsigned flow, unsigned flags,
+		     const char *fmt, va_list ap);
+void trace_ring_init(const struct ctx *c);
+void trace_ring_handler(void);
+
+#endif /* TRACE_RING_H */
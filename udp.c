@@ -109,6 +109,10 @@
 #include "pcap.h"
 #include "log.h"
 #include "flow_table.h"
+#include "rate.h"
+#include "zerocopy.h"
+#include "stats.h"
+#include "usdt.h"
 
 #define UDP_MAX_FRAMES		32  /* max # of frames to receive at once */
 
@@ -289,7 +293,8 @@ static void udp_splice_send(const struct ctx *c, size_t start, size_t n,
 	pif_sockaddr(c, &udp_splice_to, &sl, topif,
 		     &toside->eaddr, toside->eport);
 
-	sendmmsg(s, udp_mh_splice + start, n, MSG_NOSIGNAL);
+	if (sendmmsg(s, udp_mh_splice + start, n, MSG_NOSIGNAL) > 0)
+		stats_latency(STATS_TO_SOCK, STATS_UDP, n);
 }
 
 /**
@@ -462,9 +467,12 @@ static int udp_sock_recverr(int s)
 
 	ee = (const struct sock_extended_err *)CMSG_DATA(hdr);
 
+	if (zerocopy_complete(s, ee))
+		return 1;
+
 	/* TODO: When possible propagate and otherwise handle errors */
-	debug("%s error on UDP socket %i: %s",
-	      str_ee_origin(ee), s, strerror(ee->ee_errno));
+	debug_ratelimit("%s error on UDP socket %i: %s",
+			str_ee_origin(ee), s, strerror(ee->ee_errno));
 
 	return 1;
 }
@@ -516,6 +524,24 @@ static int udp_sock_errs(const struct ctx *c, int s, uint32_t events)
 	return n_err;
 }
 
+/**
+ * udp_sock_recv_max() - Maximum number of datagrams to receive in one go
+ * @c:		Execution context
+ *
+ * Return: batch size for udp_sock_recv()
+ */
+static int udp_sock_recv_max(const struct ctx *c)
+{
+	/* For not entirely clear reasons (data locality?) pasta gets better
+	 * throughput if we receive tap datagrams one at a atime.  For small
+	 * splice datagrams throughput is slightly better if we do batch, but
+	 * it's slightly worse for large splice datagrams.  Since we don't know
+	 * before we receive whether we'll use tap or splice, always go one at a
+	 * time for pasta mode.
+	 */
+	return c->mode == MODE_PASTA ? 1 : UDP_MAX_FRAMES;
+}
+
 /**
  * udp_sock_recv() - Receive datagrams from a socket
  * @c:		Execution context
@@ -530,14 +556,7 @@ static int udp_sock_errs(const struct ctx *c, int s, uint32_t events)
 static int udp_sock_recv(const struct ctx *c, int s, uint32_t events,
 			 struct mmsghdr *mmh)
 {
-	/* For not entirely clear reasons (data locality?) pasta gets better
-	 * throughput if we receive tap datagrams one at a atime.  For small
-	 * splice datagrams throughput is slightly better if we do batch, but
-	 * it's slightly worse for large splice datagrams.  Since we don't know
-	 * before we receive whether we'll use tap or splice, always go one at a
-	 * time for pasta mode.
-	 */
-	int n = (c->mode == MODE_PASTA ? 1 : UDP_MAX_FRAMES);
+	int n = udp_sock_recv_max(c);
 
 	ASSERT(!c->no_udp);
 
@@ -553,6 +572,43 @@ static int udp_sock_recv(const struct ctx *c, int s, uint32_t events,
 	return n;
 }
 
+/**
+ * udp_rate_limit() - Apply rate limits to a batch of received datagrams
+ * @c:		Execution context
+ * @tosidx:	Flow and side we're forwarding datagrams to
+ * @start:	Index of first datagram of the batch in udp_mh_recv
+ * @n:		Number of datagrams in the batch
+ *
+ * Return: number of datagrams, from the start of the batch, we can forward
+ */
+static int udp_rate_limit(const struct ctx *c, flow_sidx_t tosidx,
+			  int start, int n)
+{
+	uint8_t topif = pif_at_sidx(tosidx);
+	size_t avail;
+	int i;
+
+	if (!c->rate_flow && !c->rate_pif)
+		return n;
+
+	avail = rate_avail(c, topif, tosidx.flowi);
+	for (i = 0; i < n; i++) {
+		size_t len = udp_mh_recv[start + i].msg_len;
+
+		if (len > avail)
+			break;
+
+		avail -= len;
+		rate_consume(c, topif, tosidx.flowi, len);
+	}
+
+	if (i < n)
+		trace_ratelimit("UDP: rate limit exceeded, dropping %i datagrams",
+				n - i);
+
+	return i;
+}
+
 /**
  * udp_listen_sock_handler() - Handle new data from socket
  * @c:		Execution context
@@ -588,9 +644,12 @@ void udp_listen_sock_handler(const struct ctx *c, union epoll_ref ref,
 	for (i = 0; i < n; ) {
 		flow_sidx_t batchsidx = udp_meta[i].tosidx;
 		uint8_t batchpif = pif_at_sidx(batchsidx);
-		int batchstart = i;
+		int batchstart = i, batchn;
 
 		do {
+			stats_in(ref.udp.pif, STATS_UDP, 1,
+				 udp_mh_recv[i].msg_len);
+
 			if (pif_is_socket(batchpif)) {
 				udp_splice_prepare(udp_mh_recv, i);
 			} else if (batchpif == PIF_TAP) {
@@ -608,23 +667,29 @@ void udp_listen_sock_handler(const struct ctx *c, union epoll_ref ref,
 			udp_mh_recv[i].msg_hdr.msg_namelen = sasize;
 		} while (flow_sidx_eq(udp_meta[i].tosidx, batchsidx));
 
+		batchn = i - batchstart;
+		if (flow_sidx_valid(batchsidx))
+			batchn = udp_rate_limit(c, batchsidx, batchstart, batchn);
+
 		if (pif_is_socket(batchpif)) {
-			udp_splice_send(c, batchstart, i - batchstart,
-					batchsidx);
+			udp_splice_send(c, batchstart, batchn, batchsidx);
 		} else if (batchpif == PIF_TAP) {
-			tap_send_frames(c, &udp_l2_iov[batchstart][0],
-					UDP_NUM_IOVS, i - batchstart);
+			batchn = tap_send_frames(c, &udp_l2_iov[batchstart][0],
+						 UDP_NUM_IOVS, batchn);
+			stats_latency(STATS_TO_TAP, STATS_UDP, batchn);
 		} else if (flow_sidx_valid(batchsidx)) {
 			flow_sidx_t fromsidx = flow_sidx_opposite(batchsidx);
 			struct udp_flow *uflow = udp_at_sidx(batchsidx);
 
-			flow_err(uflow,
-				 "No support for forwarding UDP from %s to %s",
-				 pif_name(pif_at_sidx(fromsidx)),
-				 pif_name(batchpif));
+			flow_err_ratelimit(uflow,
+					   "No support for forwarding UDP from %s to %s",
+					   pif_name(pif_at_sidx(fromsidx)),
+					   pif_name(batchpif));
 		} else {
-			debug("Discarding %d datagrams without flow",
-			      i - batchstart);
+			debug_ratelimit("Discarding %d datagrams without flow",
+					i - batchstart);
+			stats.udp_no_flow += i - batchstart;
+			USDT1(udp_no_flow, i - batchstart);
 		}
 	}
 }
@@ -644,8 +709,10 @@ void udp_reply_sock_handler(const struct ctx *c, union epoll_ref ref,
 	flow_sidx_t tosidx = flow_sidx_opposite(ref.flowside);
 	const struct flowside *toside = flowside_at_sidx(tosidx);
 	struct udp_flow *uflow = udp_at_sidx(ref.flowside);
+	uint8_t frompif = pif_at_sidx(ref.flowside);
 	uint8_t topif = pif_at_sidx(tosidx);
-	int n, i, from_s;
+	int n, i, from_s, round;
+	bool more;
 
 	ASSERT(!c->no_udp && uflow);
 
@@ -658,31 +725,51 @@ void udp_reply_sock_handler(const struct ctx *c, union epoll_ref ref,
 		return;
 	}
 
-	if ((n = udp_sock_recv(c, from_s, events, udp_mh_recv)) <= 0)
-		return;
+	/* Edge-triggered: drain the socket, within budget, see flow_ready() */
+	for (round = 0; round < FLOW_BUDGET; round++) {
+		if ((n = udp_sock_recv(c, from_s, events, udp_mh_recv)) <= 0)
+			return;
 
-	flow_trace(uflow, "Received %d datagrams on reply socket", n);
-	uflow->ts = now->tv_sec;
+		flow_trace(uflow, "Received %d datagrams on reply socket", n);
+		uflow->ts = now->tv_sec;
+		more = n == udp_sock_recv_max(c);
 
-	for (i = 0; i < n; i++) {
-		if (pif_is_socket(topif))
-			udp_splice_prepare(udp_mh_recv, i);
-		else if (topif == PIF_TAP)
-			udp_tap_prepare(udp_mh_recv, i, toside, false);
-		/* Restore sockaddr length clobbered by recvmsg() */
-		udp_mh_recv[i].msg_hdr.msg_namelen = sizeof(udp_meta[i].s_in);
-	}
+		for (i = 0; i < n; i++) {
+			stats_in(frompif, STATS_UDP, 1, udp_mh_recv[i].msg_len);
 
-	if (pif_is_socket(topif)) {
-		udp_splice_send(c, 0, n, tosidx);
-	} else if (topif == PIF_TAP) {
-		tap_send_frames(c, &udp_l2_iov[0][0], UDP_NUM_IOVS, n);
-	} else {
-		uint8_t frompif = pif_at_sidx(ref.flowside);
+			if (pif_is_socket(topif))
+				udp_splice_prepare(udp_mh_recv, i);
+			else if (topif == PIF_TAP)
+				udp_tap_prepare(udp_mh_recv, i, toside, false);
+			/* Restore sockaddr length clobbered by recvmsg() */
+			udp_mh_recv[i].msg_hdr.msg_namelen =
+				sizeof(udp_meta[i].s_in);
+		}
+
+		n = udp_rate_limit(c, tosidx, 0, n);
 
-		flow_err(uflow, "No support for forwarding UDP from %s to %s",
-			 pif_name(frompif), pif_name(topif));
+		if (pif_is_socket(topif)) {
+			udp_splice_send(c, 0, n, tosidx);
+		} else if (topif == PIF_TAP) {
+			n = tap_send_frames(c, &udp_l2_iov[0][0],
+					    UDP_NUM_IOVS, n);
+			stats_latency(STATS_TO_TAP, STATS_UDP, n);
+		} else {
+			flow_err_ratelimit(uflow,
+					   "No support for forwarding UDP from %s to %s",
+					   pif_name(frompif), pif_name(topif));
+			/* Edge-triggered: datagrams left queued would never be
+			 * read again, and nothing we read can be forwarded
+			 */
+			udp_flow_close(c, uflow);
+			return;
+		}
+
+		if (!more)
+			return;
 	}
+
+	flow_ready(FLOW_IDX(uflow));
 }
 
 /**
@@ -708,9 +795,10 @@ int udp_tap_handler(const struct ctx *c, uint8_t pif,
 	struct mmsghdr mm[UIO_MAXIOV];
 	union sockaddr_inany to_sa;
 	struct iovec m[UIO_MAXIOV];
+	int i, s, ret, count = 0, dropped = 0, zc = 0;
+	size_t avail, minlen = SIZE_MAX;
 	const struct udphdr *uh;
 	struct udp_flow *uflow;
-	int i, s, count = 0;
 	flow_sidx_t tosidx;
 	in_port_t src, dst;
 	uint8_t topif;
@@ -732,10 +820,10 @@ int udp_tap_handler(const struct ctx *c, uint8_t pif,
 	if (!(uflow = udp_at_sidx(tosidx))) {
 		char sstr[INET6_ADDRSTRLEN], dstr[INET6_ADDRSTRLEN];
 
-		debug("Dropping datagram with no flow %s %s:%hu -> %s:%hu",
-		      pif_name(pif),
-		      inet_ntop(af, saddr, sstr, sizeof(sstr)), src,
-		      inet_ntop(af, daddr, dstr, sizeof(dstr)), dst);
+		debug_ratelimit("Dropping datagram with no flow %s %s:%hu -> %s:%hu",
+				pif_name(pif),
+				inet_ntop(af, saddr, sstr, sizeof(sstr)), src,
+				inet_ntop(af, daddr, dstr, sizeof(dstr)), dst);
 		return 1;
 	}
 
@@ -744,8 +832,9 @@ int udp_tap_handler(const struct ctx *c, uint8_t pif,
 		flow_sidx_t fromsidx = flow_sidx_opposite(tosidx);
 		uint8_t frompif = pif_at_sidx(fromsidx);
 
-		flow_err(uflow, "No support for forwarding UDP from %s to %s",
-			 pif_name(frompif), pif_name(topif));
+		flow_err_ratelimit(uflow,
+				   "No support for forwarding UDP from %s to %s",
+				   pif_name(frompif), pif_name(topif));
 		return 1;
 	}
 	toside = flowside_at_sidx(tosidx);
@@ -755,6 +844,7 @@ int udp_tap_handler(const struct ctx *c, uint8_t pif,
 
 	pif_sockaddr(c, &to_sa, &sl, topif, &toside->eaddr, toside->eport);
 
+	avail = rate_avail(c, topif, tosidx.flowi);
 	for (i = 0; i < (int)p->count - idx; i++) {
 		struct udphdr *uh_send;
 		size_t len;
@@ -763,6 +853,16 @@ int udp_tap_handler(const struct ctx *c, uint8_t pif,
 		if (!uh_send)
 			return p->count - idx;
 
+		if (len > avail) {
+			dropped = p->count - idx - i;
+			trace_ratelimit("UDP: rate limit exceeded, dropping %i datagrams",
+					dropped);
+			break;
+		}
+		avail -= len;
+		rate_consume(c, topif, tosidx.flowi, len);
+		minlen = MIN(minlen, len);
+
 		mm[i].msg_hdr.msg_name = &to_sa;
 		mm[i].msg_hdr.msg_namelen = sl;
 
@@ -784,11 +884,29 @@ int udp_tap_handler(const struct ctx *c, uint8_t pif,
 		count++;
 	}
 
-	count = sendmmsg(s, mm, count, MSG_NOSIGNAL);
-	if (count < 0)
+	if (!count)
+		return dropped;
+
+	/* Replies through listening sockets complete on their duplicates */
+	if (tosidx.sidei == TGTSIDE)
+		zc = zerocopy_flags(c, s, minlen);
+
+	ret = sendmmsg(s, mm, count, MSG_NOSIGNAL | zc);
+	if (ret < 0 && errno == ENOBUFS && zc) {
+		/* No memory for completion notifications: copy */
+		zc = 0;
+		ret = sendmmsg(s, mm, count, MSG_NOSIGNAL);
+	}
+	if (ret < 0)
 		return 1;
 
-	return count;
+	if (zc)
+		zerocopy_sent(s, ret);
+
+	stats_latency(STATS_TO_SOCK, STATS_UDP, ret);
+
+	/* Datagrams over the rate limit are consumed if we sent the rest */
+	return ret == count ? ret + dropped : ret;
 }
 
 /**
@@ -13,6 +13,7 @@
 #include "util.h"
 #include "passt.h"
 #include "flow_table.h"
+#include "zerocopy.h"
 
 #define UDP_CONN_TIMEOUT	180 /* s, timeout for ephemeral or local bind */
 
@@ -53,6 +54,7 @@ void udp_flow_close(const struct ctx *c, struct udp_flow *uflow)
 	if (uflow->s[TGTSIDE] >= 0) {
 		/* But the flow specific one needs to be removed */
 		epoll_ctl(c->epollfd, EPOLL_CTL_DEL, uflow->s[TGTSIDE], NULL);
+		zerocopy_close(uflow->s[TGTSIDE]);
 		close(uflow->s[TGTSIDE]);
 		uflow->s[TGTSIDE] = -1;
 	}
@@ -204,9 +206,9 @@ flow_sidx_t udp_flow_from_sock(const struct ctx *c, union epoll_ref ref,
 	if (!(flow = flow_alloc())) {
 		char sastr[SOCKADDR_STRLEN];
 
-		debug("Couldn't allocate flow for UDP datagram from %s %s",
-		      pif_name(ref.udp.pif),
-		      sockaddr_ntop(s_in, sastr, sizeof(sastr)));
+		debug_ratelimit("Couldn't allocate flow for UDP datagram from %s %s",
+				pif_name(ref.udp.pif),
+				sockaddr_ntop(s_in, sastr, sizeof(sastr)));
 		return FLOW_SIDX_NONE;
 	}
 
@@ -249,10 +251,12 @@ flow_sidx_t udp_flow_from_tap(const struct ctx *c,
 	if (!(flow = flow_alloc())) {
 		char sstr[INET6_ADDRSTRLEN], dstr[INET6_ADDRSTRLEN];
 
-		debug("Couldn't allocate flow for UDP datagram from %s %s:%hu -> %s:%hu",
-		      pif_name(pif),
-		      inet_ntop(af, saddr, sstr, sizeof(sstr)), srcport,
-		      inet_ntop(af, daddr, dstr, sizeof(dstr)), dstport);
+		debug_ratelimit("Couldn't allocate flow for UDP datagram from %s %s:%hu -> %s:%hu",
+				pif_name(pif),
+				inet_ntop(af, saddr, sstr, sizeof(sstr)),
+				srcport,
+				inet_ntop(af, daddr, dstr, sizeof(dstr)),
+				dstport);
 		return FLOW_SIDX_NONE;
 	}
 
@@ -272,6 +276,27 @@ bool udp_flow_defer(const struct udp_flow *uflow)
 	return uflow->closed;
 }
 
+/**
+ * udp_flow_resume() - Keep forwarding replies we left queued on the socket
+ * @c:		Execution context
+ * @uflow:	UDP flow, out of budget in the previous round
+ * @now:	Current timestamp
+ */
+void udp_flow_resume(const struct ctx *c, struct udp_flow *uflow,
+		     const struct timespec *now)
+{
+	union epoll_ref ref = {
+		.type = EPOLL_TYPE_UDP_REPLY,
+		.fd = uflow->s[TGTSIDE],
+		.flowside = FLOW_SIDX(uflow, TGTSIDE),
+	};
+
+	if (uflow->closed || ref.fd < 0)
+		return;
+
+	udp_reply_sock_handler(c, ref, EPOLLIN, now);
+}
+
 /**
  * udp_flow_timer() - Handler for timed events related to a given flow
  * @c:		Execution context
@@ -34,6 +34,8 @@ flow_sidx_t udp_flow_from_tap(const struct ctx *c,
 			      const struct timespec *now);
 void udp_flow_close(const struct ctx *c, struct udp_flow *uflow);
 bool udp_flow_defer(const struct udp_flow *uflow);
+void udp_flow_resume(const struct ctx *c, struct udp_flow *uflow,
+		     const struct timespec *now);
 bool udp_flow_timer(const struct ctx *c, struct udp_flow *uflow,
 		    const struct timespec *now);
 
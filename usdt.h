@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * Static user-space probes (USDT), compatible with sys/sdt.h from SystemTap
+ *
+ * Each probe is a single nop instruction, plus a note in the .note.stapsdt
+ * section of the binary describing its location and where its arguments can be
+ * found. Tools such as bpftrace, perf and SystemTap replace the nop with a
+ * breakpoint when they attach to a probe, so there's no overhead if nothing is
+ * attached, and no run-time dependency. For example:
+ *
+ *   bpftrace -e 'usdt:./passt:passt:tcp_event { printf("%d %x\n", arg0, arg1); }'
+ *
+ * Probe arguments are passed as signed 64-bit integers, to keep descriptors
+ * simple. This is implemented for x86_64 only, as operand syntax in argument
+ * descriptors depends on the architecture: elsewhere, probes compile to
+ * nothing, and so they do with -DNO_USDT.
+ */
+
+#ifndef USDT_H
+#define USDT_H
+
+#if defined(__x86_64__) && !defined(NO_USDT)
+
+/* Note layout, see https://sourceware.org/systemtap/wiki/UserSpaceProbeImplementation
+ * _.stapsdt.base is used by tools to adjust addresses for prelinking
+ */
+#define USDT_ASM_(name, args)						\
+	"990:	nop\n"							\
+	"	.pushsection .note.stapsdt,\"?\",\"note\"\n"		\
+	"	.balign 4\n"						\
+	"	.4byte 992f-991f, 994f-993f, 3\n"			\
+	"991:	.asciz \"stapsdt\"\n"					\
+	"992:	.balign 4\n"						\
+	"993:	.8byte 990b\n"						\
+	"	.8byte _.stapsdt.base\n"				\
+	"	.8byte 0\n"						\
+	"	.asciz \"passt\"\n"					\
+	"	.asciz \"" #name "\"\n"					\
+	"	.asciz \"" args "\"\n"					\
+	"994:	.balign 4\n"						\
+	"	.popsection\n"						\
+	".ifndef _.stapsdt.base\n"					\
+	"	.pushsection .stapsdt.base,\"aG\",\"progbits\","	\
+	".stapsdt.base,comdat\n"					\
+	"	.weak _.stapsdt.base\n"					\
+	"	.hidden _.stapsdt.base\n"				\
+	"_.stapsdt.base:\n"						\
+	"	.space 1\n"						\
+	"	.size _.stapsdt.base, 1\n"				\
+	"	.popsection\n"						\
+	".endif\n"
+
+#define USDT_ARG_(x)		"nor" ((long long)(x))
+
+#define USDT0(name)							\
+	__asm__ __volatile__(USDT_ASM_(name, ""))
+#define USDT1(name, a)							\
+	__asm__ __volatile__(USDT_ASM_(name, "-8@%0")			\
+			     :: USDT_ARG_(a))
+#define USDT2(name, a, b)						\
+	__asm__ __volatile__(USDT_ASM_(name, "-8@%0 -8@%1")		\
+			     :: USDT_ARG_(a), USDT_ARG_(b))
+#define USDT3(name, a, b, c)						\
+	__asm__ __volatile__(USDT_ASM_(name, "-8@%0 -8@%1 -8@%2")	\
+			     :: USDT_ARG_(a), USDT_ARG_(b), USDT_ARG_(c))
+
+#else /* !__x86_64__ || NO_USDT */
+
+#define USDT0(name)			do { } while (0)
+#define USDT1(name, a)			do { (void)(a); } while (0)
+#define USDT2(name, a, b)		do { (void)(a); (void)(b); } while (0)
+#define USDT3(name, a, b, c)						\
+	do { (void)(a); (void)(b); (void)(c); } while (0)
+
+#endif /* __x86_64__ && !NO_USDT */
+
+#endif /* USDT_H */
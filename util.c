@@ -168,6 +168,8 @@ int sock_l4_sa(const struct ctx *c, enum epoll_type type,
 	}
 
 	ev.events = EPOLLIN;
+	if (type == EPOLL_TYPE_UDP_REPLY)
+		ev.events |= EPOLLET;	/* Handler drains it, or queues flow */
 	ev.data.u64 = ref.u64;
 	if (epoll_ctl(c->epollfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
 		ret = -errno;
@@ -0,0 +1,311 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * MSG_ZEROCOPY sends to host sockets, straight out of the tap packet buffer
+ *
+ * With MSG_ZEROCOPY, the kernel keeps references to the pages of pkt_buf we
+ * send from, until it reports completion on the error queue of the socket, so
+ * we can't overwrite those parts of pkt_buf with new frames from the tap
+ * device or guest until then.
+ *
+ * To avoid waiting, pkt_buf is split in two halves, and we read frames into
+ * either one, switching to the other half as long as zero-copy sends from the
+ * current one are pending. If sends from both halves are pending, we replace
+ * the pages of pkt_buf with new ones: the kernel holds references to the old
+ * pages, which are freed once it's done with them, and we stop tracking those
+ * sends.
+ *
+ * Completion notifications carry ranges of IDs, assigned by the kernel to each
+ * send on a given socket, sequentially. For each socket, we keep track of
+ * which IDs were sent from which half, as two adjacent ranges: all the IDs
+ * before the older range were completed or don't need tracking anymore, as we
+ * can only switch back to a half once all the sends from it completed.
+ *
+ * If the kernel reports it had to copy data anyway, for example for loopback
+ * traffic, we stop using zero-copy sends on that socket.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "util.h"
+#include "ip.h"
+#include "passt.h"
+#include "log.h"
+#include "zerocopy.h"
+
+#define ZEROCOPY_SOCKS		64	/* Sockets tracked at the same time */
+#define ZEROCOPY_BANK_BYTES	ROUND_DOWN(TAP_BUF_BYTES / 2, PAGE_SIZE)
+
+/**
+ * struct zerocopy_sock - Pending zero-copy sends on a socket
+ * @s:		Socket, -1 if entry is free
+ * @base:	First ID we still track, sent from the half before @bank
+ * @split:	First ID sent from @bank
+ * @next:	ID the kernel will assign to the next send
+ * @bank:	Half of pkt_buf used for sends from @split to @next
+ * @copied:	Kernel copied data anyway, or zero-copy couldn't be enabled
+ */
+struct zerocopy_sock {
+	int s;
+	uint32_t base;
+	uint32_t split;
+	uint32_t next;
+	uint8_t bank;
+	bool copied;
+};
+
+static struct zerocopy_sock zerocopy_sock[ZEROCOPY_SOCKS];
+
+static unsigned zerocopy_bank;		/* Half we're reading frames into */
+static uint32_t zerocopy_pending[2];	/* Pending sends from each half */
+
+/**
+ * zerocopy_init() - Initialise table of sockets
+ */
+void zerocopy_init(void)
+{
+	unsigned i;
+
+	for (i = 0; i < ZEROCOPY_SOCKS; i++)
+		zerocopy_sock[i].s = -1;
+}
+
+/**
+ * zerocopy_sock_get() - Find tracking entry for socket, optionally add it
+ * @s:		Socket
+ * @add:	Add entry, enabling SO_ZEROCOPY on the socket, if not found
+ *
+ * Return: pointer to entry, NULL if not found and not added
+ */
+static struct zerocopy_sock *zerocopy_sock_get(int s, bool add)
+{
+	struct zerocopy_sock *z, *empty = NULL;
+
+	if (s < 0)
+		return NULL;
+
+	for (z = zerocopy_sock; z < zerocopy_sock + ZEROCOPY_SOCKS; z++) {
+		if (z->s == s)
+			return z;
+
+		if (z->s < 0 && !empty)
+			empty = z;
+	}
+
+	if (!add || !empty)
+		return NULL;
+
+	*empty = (struct zerocopy_sock){ .s = s, .bank = zerocopy_bank };
+
+	if (setsockopt(s, SOL_SOCKET, SO_ZEROCOPY, &((int){ 1 }),
+		       sizeof(int))) {
+		debug_perror("Can't enable zero-copy sends on socket %i", s);
+		empty->copied = true;
+	}
+
+	return empty;
+}
+
+/**
+ * zerocopy_detach() - Replace pages of pkt_buf, stop tracking pending sends
+ *
+ * Only used with --zerocopy, see isolate_postfork() for profile selection
+ *
+ * #syscalls:passt_mmap mmap|mmap2 madvise
+ * #syscalls:pasta_mmap mmap|mmap2 madvise
+ */
+static void zerocopy_detach(void)
+{
+	struct zerocopy_sock *z;
+
+	if (mmap(pkt_buf, TAP_BUF_BYTES, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+		die_perror("Failed to replace pages of packet buffer");
+
+	madvise(pkt_buf, TAP_BUF_BYTES, MADV_HUGEPAGE);
+
+	for (z = zerocopy_sock; z < zerocopy_sock + ZEROCOPY_SOCKS; z++)
+		z->base = z->split = z->next;
+
+	trace("Zero-copy: replaced packet buffer, %u + %u sends pending",
+	      zerocopy_pending[0], zerocopy_pending[1]);
+
+	zerocopy_pending[0] = zerocopy_pending[1] = 0;
+}
+
+/**
+ * zerocopy_buf() - Get part of pkt_buf we can read new frames into
+ * @c:		Execution context
+ * @size:	Size of usable area, set on return
+ *
+ * Return: pointer to start of usable area
+ */
+char *zerocopy_buf(const struct ctx *c, size_t *size)
+{
+	if (!c->zerocopy) {
+		*size = TAP_BUF_BYTES;
+		return pkt_buf;
+	}
+
+	if (zerocopy_pending[zerocopy_bank]) {
+		if (zerocopy_pending[!zerocopy_bank])
+			zerocopy_detach();
+
+		zerocopy_bank = !zerocopy_bank;
+	}
+
+	*size = ZEROCOPY_BANK_BYTES;
+	return pkt_buf + zerocopy_bank * ZEROCOPY_BANK_BYTES;
+}
+
+/**
+ * zerocopy_flags() - Get flags for send from pkt_buf to socket
+ * @c:		Execution context
+ * @s:		Socket we're sending to
+ * @len:	Length of data we're sending, in each message
+ *
+ * Return: MSG_ZEROCOPY if enabled and worth it for this send, 0 otherwise
+ */
+int zerocopy_flags(const struct ctx *c, int s, size_t len)
+{
+	const struct zerocopy_sock *z;
+
+	if (!c->zerocopy || len < ZEROCOPY_MIN)
+		return 0;
+
+	if (!(z = zerocopy_sock_get(s, true)) || z->copied)
+		return 0;
+
+	return MSG_ZEROCOPY;
+}
+
+/**
+ * zerocopy_sent() - Account for zero-copy sends from current half of pkt_buf
+ * @s:		Socket
+ * @n:		Number of successful send operations, that is, IDs used
+ */
+void zerocopy_sent(int s, unsigned n)
+{
+	struct zerocopy_sock *z = zerocopy_sock_get(s, false);
+
+	if (!z || !n)
+		return;
+
+	/* All sends from the half we're switching to completed */
+	if (z->bank != zerocopy_bank) {
+		z->base = z->split;
+		z->split = z->next;
+		z->bank = zerocopy_bank;
+	}
+
+	z->next += n;
+	zerocopy_pending[zerocopy_bank] += n;
+}
+
+/**
+ * zerocopy_complete() - Handle notification from socket error queue
+ * @s:		Socket
+ * @ee:		Extended error from error queue
+ *
+ * Return: true if this was a zero-copy completion, false otherwise
+ */
+bool zerocopy_complete(int s, const struct sock_extended_err *ee)
+{
+	int32_t start, end, split, old;
+	struct zerocopy_sock *z;
+	uint32_t *p;
+
+	if (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+		return false;
+
+	if (!(z = zerocopy_sock_get(s, false)))
+		return true;
+
+	/* Range is inclusive, make it relative to the first ID we track */
+	start = MAX((int32_t)(ee->ee_info - z->base), 0);
+	end = MIN((int32_t)(ee->ee_data + 1 - z->base),
+		  (int32_t)(z->next - z->base));
+	split = z->split - z->base;
+
+	if (end > start) {
+		old = MAX(MIN(end, split) - start, 0);
+
+		p = &zerocopy_pending[!z->bank];
+		*p -= MIN(*p, (uint32_t)old);
+
+		p = &zerocopy_pending[z->bank];
+		*p -= MIN(*p, (uint32_t)(end - start - old));
+	}
+
+	if ((ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && !z->copied) {
+		debug("Zero-copy send on socket %i was copied, disabling", s);
+		z->copied = true;
+	}
+
+	return true;
+}
+
+/**
+ * zerocopy_recverr() - Handle zero-copy completions on a socket
+ * @s:		Socket
+ *
+ * Return: number of completions handled, -1 on other errors or failure
+ *
+ * #syscalls recvmsg
+ */
+int zerocopy_recverr(int s)
+{
+	char buf[CMSG_SPACE(sizeof(struct sock_extended_err))];
+	const struct cmsghdr *hdr;
+	int n = 0;
+
+	while (1) {
+		struct msghdr mh = {
+			.msg_control = buf,
+			.msg_controllen = sizeof(buf),
+		};
+
+		if (recvmsg(s, &mh, MSG_ERRQUEUE) < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return n;
+
+			return -1;
+		}
+
+		hdr = CMSG_FIRSTHDR(&mh);
+		if (!hdr || !((hdr->cmsg_level == IPPROTO_IP &&
+			       hdr->cmsg_type == IP_RECVERR) ||
+			      (hdr->cmsg_level == IPPROTO_IPV6 &&
+			       hdr->cmsg_type == IPV6_RECVERR)))
+			return -1;
+
+		if (!zerocopy_complete(s, (const struct sock_extended_err *)
+					  CMSG_DATA(hdr)))
+			return -1;
+
+		n++;
+	}
+}
+
+/**
+ * zerocopy_close() - Stop tracking socket, before closing it
+ * @s:		Socket
+ *
+ * Sends still pending can't be completed anymore: we'll replace pages of
+ * pkt_buf, if needed, to stop waiting for them.
+ */
+void zerocopy_close(int s)
+{
+	struct zerocopy_sock *z = zerocopy_sock_get(s, false);
+
+	if (z)
+		z->s = -1;
+}
@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later
+ * Copyright Red Hat
+ *
+ * MSG_ZEROCOPY sends to host sockets, straight out of the tap packet buffer
+ */
+
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+#define ZEROCOPY_MIN		(16 * 1024)	/* Copy smaller sends */
+
+struct sock_extended_err;
+
+void zerocopy_init(void);
+char *zerocopy_buf(const struct ctx *c, size_t *size);
+int zerocopy_flags(const struct ctx *c, int s, size_t len);
+void zerocopy_sent(int s, unsigned n);
+bool zerocopy_complete(int s, const struct sock_extended_err *ee);
+int zerocopy_recverr(int s);
+void zerocopy_close(int s);
+
+#endif /* ZEROCOPY_H */